@@ -0,0 +1 @@
+#include "../src/trace.h"
@@ -0,0 +1 @@
+#include "../src/workqueue.h"
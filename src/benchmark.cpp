@@ -0,0 +1,669 @@
+//
+// Datum Studio Build Benchmark
+//
+
+//
+// Copyright (c) 2016 Peter Niekamp
+//
+
+#include <QCoreApplication>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QElapsedTimer>
+#include <QProcess>
+#include <QRegularExpression>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QJsonArray>
+#include <QImage>
+#include <QMap>
+#include "assetfile.h"
+#include "datum/math.h"
+#include <random>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+#include <QtDebug>
+
+using namespace std;
+using namespace lml;
+
+namespace
+{
+  //|---------------------- Parameters --------------------------------------
+  //|------------------------------------------------------------------------
+
+  struct Parameters
+  {
+    int count = 8;
+    int size = 1024;
+    int layers = 4;
+    int grid = 512;
+  };
+
+  //|---------------------- Scenario ----------------------------------------
+  //|------------------------------------------------------------------------
+
+  struct Scenario
+  {
+    QString name;
+    QStringList assets;
+
+    qint64 bytes = 0;
+    qint64 pixels = 0;
+    qint64 vertices = 0;
+  };
+
+  //|---------------------- Generator ---------------------------------------
+  //|------------------------------------------------------------------------
+
+  // synthetic content is written straight to the asset file format, the
+  // header comes from write_asset_header so it tracks the studio layout
+
+  class Generator
+  {
+    public:
+      Generator(QDir const &base, Parameters const &params);
+
+      void images(Scenario &scenario);
+      void materials(Scenario &scenario);
+      void terrain(Scenario &scenario);
+      void skyboxes(Scenario &scenario);
+      void fonts(Scenario &scenario);
+      void meshes(Scenario &scenario);
+
+    private:
+
+      QString image(Scenario &scenario, QString const &path, int size, QRgb base);
+      QString material(Scenario &scenario, QString const &path);
+
+      void write(Scenario &scenario, QString const &path, QJsonObject const &metadata, function<void(ostream &)> const &payload);
+
+      QDir m_base;
+      Parameters m_params;
+
+      mt19937 m_rng;
+  };
+
+  ///////////////////////// Generator::Constructor ///////////////////////////
+  Generator::Generator(QDir const &base, Parameters const &params)
+    : m_base(base), m_params(params)
+  {
+  }
+
+  ///////////////////////// Generator::write /////////////////////////////////
+  void Generator::write(Scenario &scenario, QString const &path, QJsonObject const &metadata, function<void(ostream &)> const &payload)
+  {
+    m_base.mkpath(QFileInfo(path).path());
+
+    ofstream fout(m_base.filePath(path).toUtf8(), ios::binary | ios::trunc);
+
+    write_asset_header(fout, metadata);
+
+    payload(fout);
+
+    write_asset_footer(fout);
+
+    scenario.bytes += fout.tellp();
+
+    fout.close();
+
+    if (!fout)
+      throw runtime_error("Unable to write " + path.toStdString());
+  }
+
+  ///////////////////////// Generator::image /////////////////////////////////
+  QString Generator::image(Scenario &scenario, QString const &path, int size, QRgb base)
+  {
+    QImage image(size, size, QImage::Format_ARGB32);
+
+    uniform_int_distribution<int> noise(-24, 24);
+
+    for(int y = 0; y < size; ++y)
+    {
+      auto line = reinterpret_cast<QRgb*>(image.scanLine(y));
+
+      for(int x = 0; x < size; ++x)
+      {
+        int r = qBound(0, qRed(base) + ((x ^ y) & 0x1F) + noise(m_rng), 255);
+        int g = qBound(0, qGreen(base) + ((x * y) & 0x1F) + noise(m_rng), 255);
+        int b = qBound(0, qBlue(base) + noise(m_rng), 255);
+
+        line[x] = qRgba(r, g, b, 255);
+      }
+    }
+
+    QJsonObject metadata;
+    metadata["type"] = "Image";
+    metadata["build"] = 0.0;
+
+    write(scenario, path, metadata, [&](ostream &fout) {
+      write_imag_asset(fout, 1, size, size, 1, 1, PackImageHeader::rgba, image.bits());
+    });
+
+    scenario.pixels += size * size;
+
+    return path;
+  }
+
+  ///////////////////////// Generator::material //////////////////////////////
+  QString Generator::material(Scenario &scenario, QString const &path)
+  {
+    auto dir = QFileInfo(path).path();
+    auto name = QFileInfo(path).completeBaseName();
+
+    QJsonObject definition;
+    definition["color.r"] = 1.0;
+    definition["color.g"] = 1.0;
+    definition["color.b"] = 1.0;
+    definition["color.a"] = 1.0;
+    definition["metalness"] = 0.0;
+    definition["roughness"] = 1.0;
+
+    static const struct { const char *name; QRgb base; } maps[] = {
+      { "albedomap", qRgb(160, 120, 80) },
+      { "metalnessmap", qRgb(32, 32, 32) },
+      { "roughnessmap", qRgb(180, 180, 180) },
+      { "reflectivitymap", qRgb(128, 128, 128) },
+      { "normalmap", qRgb(112, 112, 231) }
+    };
+
+    for(auto &map : maps)
+    {
+      auto mappath = image(scenario, dir + "/" + name + "_" + map.name + ".asset", m_params.size, map.base);
+
+      definition[map.name] = QFileInfo(mappath).fileName();
+    }
+
+    QJsonObject metadata;
+    metadata["type"] = "Material";
+    metadata["build"] = 0.0;
+
+    write(scenario, path, metadata, [&](ostream &fout) {
+      auto data = QJsonDocument(definition).toBinaryData();
+      write_text_asset(fout, 1, data.size(), data.data());
+    });
+
+    return path;
+  }
+
+  ///////////////////////// Generator::images ////////////////////////////////
+  void Generator::images(Scenario &scenario)
+  {
+    for(int i = 0; i < m_params.count; ++i)
+    {
+      scenario.assets.push_back(image(scenario, QString("Content/Images/image%1.asset").arg(i), m_params.size, qRgb(96, 96, 96)));
+    }
+  }
+
+  ///////////////////////// Generator::materials /////////////////////////////
+  void Generator::materials(Scenario &scenario)
+  {
+    for(int i = 0; i < m_params.count; ++i)
+    {
+      scenario.assets.push_back(material(scenario, QString("Content/Materials/material%1.asset").arg(i)));
+    }
+  }
+
+  ///////////////////////// Generator::terrain ///////////////////////////////
+  void Generator::terrain(Scenario &scenario)
+  {
+    QJsonArray layers;
+
+    for(int i = 0; i < m_params.layers; ++i)
+    {
+      auto path = material(scenario, QString("Content/Terrain/layer%1.asset").arg(i));
+
+      QJsonObject layer;
+      layer["path"] = QFileInfo(path).fileName();
+
+      layers.append(layer);
+    }
+
+    QJsonObject definition;
+    definition["color.r"] = 1.0;
+    definition["color.g"] = 1.0;
+    definition["color.b"] = 1.0;
+    definition["color.a"] = 1.0;
+    definition["layers"] = layers;
+
+    QJsonObject metadata;
+    metadata["type"] = "Material\\Terrain";
+    metadata["build"] = 0.0;
+
+    QString path = "Content/Terrain/terrain.asset";
+
+    write(scenario, path, metadata, [&](ostream &fout) {
+      auto data = QJsonDocument(definition).toBinaryData();
+      write_text_asset(fout, 1, data.size(), data.data());
+    });
+
+    scenario.assets.push_back(path);
+  }
+
+  ///////////////////////// Generator::skyboxes //////////////////////////////
+  void Generator::skyboxes(Scenario &scenario)
+  {
+    int size = qBound(128, m_params.size, 512);
+
+    for(int i = 0; i < max(1, m_params.count / 4); ++i)
+    {
+      QJsonObject definition;
+      definition["type"] = 0;
+      definition["width"] = size;
+      definition["height"] = size;
+
+      for(auto &face : { "front", "left", "right", "back", "top", "bottom" })
+      {
+        auto path = image(scenario, QString("Content/SkyBoxes/skybox%1_%2.asset").arg(i).arg(face), size, qRgb(64, 96, 160));
+
+        definition[face] = QFileInfo(path).fileName();
+      }
+
+      QJsonObject metadata;
+      metadata["type"] = "SkyBox";
+      metadata["build"] = 0.0;
+
+      auto path = QString("Content/SkyBoxes/skybox%1.asset").arg(i);
+
+      write(scenario, path, metadata, [&](ostream &fout) {
+        auto data = QJsonDocument(definition).toBinaryData();
+        write_text_asset(fout, 1, data.size(), data.data());
+      });
+
+      scenario.assets.push_back(path);
+    }
+  }
+
+  ///////////////////////// Generator::fonts /////////////////////////////////
+  void Generator::fonts(Scenario &scenario)
+  {
+    for(int i = 0; i < max(1, m_params.count / 2); ++i)
+    {
+      QJsonObject definition;
+      definition["name"] = "Sans";
+      definition["size"] = 12 + 4 * i;
+      definition["weight"] = 50;
+      definition["atlaswidth"] = 1024;
+      definition["atlasheight"] = 1024;
+
+      QJsonObject metadata;
+      metadata["type"] = "Font";
+      metadata["build"] = 0.0;
+
+      auto path = QString("Content/Fonts/font%1.asset").arg(i);
+
+      write(scenario, path, metadata, [&](ostream &fout) {
+        auto data = QJsonDocument(definition).toBinaryData();
+        write_text_asset(fout, 1, data.size(), data.data());
+      });
+
+      scenario.pixels += 1024 * 1024;
+
+      scenario.assets.push_back(path);
+    }
+  }
+
+  ///////////////////////// Generator::meshes ////////////////////////////////
+  void Generator::meshes(Scenario &scenario)
+  {
+    int n = max(2, m_params.grid);
+
+    uniform_real_distribution<float> height(-0.05f, 0.05f);
+
+    for(int i = 0; i < max(1, m_params.count / 4); ++i)
+    {
+      vector<PackVertex> vertices;
+      vector<uint32_t> indices;
+
+      vertices.reserve(n * n);
+      indices.reserve((n - 1) * (n - 1) * 6);
+
+      for(int y = 0; y < n; ++y)
+      {
+        for(int x = 0; x < n; ++x)
+        {
+          PackVertex vertex;
+          vertex.position[0] = x / float(n - 1) - 0.5f;
+          vertex.position[1] = height(m_rng);
+          vertex.position[2] = y / float(n - 1) - 0.5f;
+          vertex.texcoord[0] = x / float(n - 1);
+          vertex.texcoord[1] = y / float(n - 1);
+          vertex.normal[0] = 0.0f;
+          vertex.normal[1] = 1.0f;
+          vertex.normal[2] = 0.0f;
+          vertex.tangent[0] = 1.0f;
+          vertex.tangent[1] = 0.0f;
+          vertex.tangent[2] = 0.0f;
+          vertex.tangent[3] = 1.0f;
+
+          vertices.push_back(vertex);
+        }
+      }
+
+      for(int y = 0; y < n - 1; ++y)
+      {
+        for(int x = 0; x < n - 1; ++x)
+        {
+          uint32_t k = y * n + x;
+
+          indices.insert(indices.end(), { k, k + n, k + 1, k + 1, k + n, k + n + 1 });
+        }
+      }
+
+      vector<PackModelPayload::Texture> texturetable(1);
+      texturetable[0].type = PackModelPayload::Texture::nullmap;
+
+      vector<PackModelPayload::Material> materialtable(1);
+      materialtable[0].color[0] = 0.75f;
+      materialtable[0].color[1] = 0.75f;
+      materialtable[0].color[2] = 0.75f;
+      materialtable[0].color[3] = 1.0f;
+      materialtable[0].metalness = 0.0f;
+      materialtable[0].roughness = 1.0f;
+      materialtable[0].reflectivity = 0.5f;
+      materialtable[0].emissive = 0.0f;
+      materialtable[0].albedomap = 0;
+      materialtable[0].surfacemap = 0;
+      materialtable[0].normalmap = 0;
+
+      vector<PackModelPayload::Mesh> meshtable(1);
+      meshtable[0].mesh = 1;
+
+      Transform transform = Transform::identity();
+
+      vector<PackModelPayload::Instance> instancetable(1);
+      instancetable[0].mesh = 0;
+      instancetable[0].material = 0;
+      memcpy(&instancetable[0].transform, &transform, sizeof(Transform));
+      instancetable[0].childcount = 0;
+
+      QJsonObject metadata;
+      metadata["type"] = "Mesh";
+      metadata["build"] = 0.0;
+
+      auto path = QString("Content/Meshes/mesh%1.asset").arg(i);
+
+      write(scenario, path, metadata, [&](ostream &fout) {
+        write_modl_asset(fout, 1, texturetable, materialtable, meshtable, instancetable);
+        write_mesh_asset(fout, 2, vertices, indices);
+      });
+
+      scenario.vertices += vertices.size();
+
+      scenario.assets.push_back(path);
+    }
+  }
+
+
+  //|---------------------- write_project -----------------------------------
+  //|------------------------------------------------------------------------
+
+  void write_project(QString const &projectfile, vector<Scenario> const &scenarios)
+  {
+    ofstream fout(projectfile.toUtf8());
+
+    fout << "[Datum Studio]" << '\n';
+    fout << "version = 1.0" << '\n';
+    fout << '\n';
+
+    fout << "[Pack]" << '\n';
+
+    for(auto &scenario : scenarios)
+    {
+      fout << "<Group name='" << scenario.name.toStdString() << "'>" << '\n';
+
+      for(auto &asset : scenario.assets)
+        fout << asset.toStdString() << '\n';
+
+      fout << "</Group>" << '\n';
+    }
+
+    fout << '\n';
+  }
+
+
+  //|---------------------- stage_totals ------------------------------------
+  //|------------------------------------------------------------------------
+
+  // per-stage totals in milliseconds from a chrome trace written by the pack build
+
+  QJsonObject stage_totals(QString const &path)
+  {
+    QFile fin(path);
+
+    if (!fin.open(QIODevice::ReadOnly))
+      return QJsonObject();
+
+    QMap<QString, qint64> totals;
+
+    for(auto event : QJsonDocument::fromJson(fin.readAll()).object()["traceEvents"].toArray())
+    {
+      totals[event.toObject()["name"].toString()] += event.toObject()["dur"].toVariant().toLongLong();
+    }
+
+    QJsonObject stages;
+
+    for(auto i = totals.begin(); i != totals.end(); ++i)
+    {
+      stages[i.key()] = i.value() / 1000.0;
+    }
+
+    return stages;
+  }
+
+
+  //|---------------------- run_build ---------------------------------------
+  //|------------------------------------------------------------------------
+
+  QJsonObject run_build(QString const &builder, QString const &projectfile, Scenario const &scenario, QString const &pass)
+  {
+    QDir base = QFileInfo(projectfile).dir();
+
+    QString output = base.filePath("Packs/" + scenario.name + ".pack");
+
+    QProcess process;
+    process.setProcessChannelMode(QProcess::MergedChannels);
+
+    QElapsedTimer timer;
+
+    timer.start();
+
+    process.start(builder, QStringList() << "-o=" + output << "--trace" << projectfile << scenario.name);
+
+    if (!process.waitForFinished(-1))
+      throw runtime_error("Unable to run " + builder.toStdString());
+
+    double seconds = timer.nsecsElapsed() / 1e9;
+
+    auto log = QString::fromUtf8(process.readAll());
+
+    QJsonObject result;
+    result["scenario"] = scenario.name;
+    result["pass"] = pass;
+    result["success"] = (process.exitStatus() == QProcess::NormalExit && process.exitCode() == 0);
+    result["assets"] = scenario.assets.size();
+    result["wall_ms"] = seconds * 1000.0;
+
+    auto peak = QRegularExpression("Peak Memory (\\d+)KB").match(log);
+
+    if (peak.hasMatch())
+      result["peak_rss_kb"] = peak.captured(1).toLongLong();
+
+    result["input_bytes"] = scenario.bytes;
+    result["output_bytes"] = QFileInfo(output).size();
+    result["mb_per_s"] = scenario.bytes / (1024.0 * 1024.0) / seconds;
+
+    if (scenario.pixels != 0)
+      result["pixels_per_s"] = scenario.pixels / seconds;
+
+    if (scenario.vertices != 0)
+      result["vertices_per_s"] = scenario.vertices / seconds;
+
+    result["stages_ms"] = stage_totals(QFileInfo(output).dir().filePath("trace.json"));
+
+    if (!result["success"].toBool())
+      qWarning().noquote() << log;
+
+    return result;
+  }
+}
+
+
+void usage()
+{
+  cout << "Usage: datumstudio-bench [options] [scenario...]\n\n";
+  cout << "    -o=file\t\tResults file (default bench.json)\n";
+  cout << "    -d=dir\t\tWorking directory for the synthetic project (default temp)\n";
+  cout << "    -n=count\t\tAssets per scenario (default 8)\n";
+  cout << "    -s=size\t\tImage size (default 1024)\n";
+  cout << "    -k=layers\t\tTerrain material layers (default 4)\n";
+  cout << "    -g=grid\t\tMesh grid dimension (default 512)\n";
+  cout << "    -h\t\t\tShow this help\n\n";
+  cout << "Scenarios: images materials terrain skyboxes fonts meshes\n";
+}
+
+
+//|---------------------- main ----------------------------------------------
+//|--------------------------------------------------------------------------
+
+int main(int argc, char **argv)
+{
+  QCoreApplication app(argc, argv);
+
+  Parameters params;
+
+  QString output = "bench.json";
+  QString workdir = QDir::temp().filePath("datumstudio-bench");
+  QStringList selected;
+
+  QStringList args = app.arguments();
+
+  for(int i = 1; i < args.size(); ++i)
+  {
+    if (args[i] == "-h" || args[i] == "--help")
+    {
+      usage();
+      return 1;
+    }
+
+    if (args[i].startsWith("-o="))
+      output = args[i].mid(3);
+
+    if (args[i].startsWith("-d="))
+      workdir = args[i].mid(3);
+
+    if (args[i].startsWith("-n="))
+      params.count = max(1, args[i].mid(3).toInt());
+
+    if (args[i].startsWith("-s="))
+      params.size = max(4, args[i].mid(3).toInt());
+
+    if (args[i].startsWith("-k="))
+      params.layers = max(1, args[i].mid(3).toInt());
+
+    if (args[i].startsWith("-g="))
+      params.grid = max(2, args[i].mid(3).toInt());
+
+    if (args[i].startsWith("-"))
+      continue;
+
+    selected.push_back(args[i]);
+  }
+
+  QString builder = QDir(app.applicationDirPath()).filePath("datumstudio-build");
+
+  try
+  {
+    QDir base(workdir);
+
+    if (base.exists() && !base.removeRecursively())
+      throw runtime_error("Unable to clear " + workdir.toStdString());
+
+    if (!base.mkpath("."))
+      throw runtime_error("Unable to create " + workdir.toStdString());
+
+    Generator generator(base, params);
+
+    using Generate = void (Generator::*)(Scenario &);
+
+    static const struct { const char *name; Generate generate; } generators[] = {
+      { "images", &Generator::images },
+      { "materials", &Generator::materials },
+      { "terrain", &Generator::terrain },
+      { "skyboxes", &Generator::skyboxes },
+      { "fonts", &Generator::fonts },
+      { "meshes", &Generator::meshes }
+    };
+
+    vector<Scenario> scenarios;
+
+    for(auto &entry : generators)
+    {
+      if (!selected.isEmpty() && !selected.contains(entry.name))
+        continue;
+
+      Scenario scenario;
+      scenario.name = entry.name;
+
+      QElapsedTimer timer;
+
+      timer.start();
+
+      (generator.*entry.generate)(scenario);
+
+      qInfo().noquote() << QString("Generated %1 (%2 assets, %3MB) in %4ms").arg(scenario.name).arg(scenario.assets.size()).arg(scenario.bytes / (1024.0 * 1024.0), 0, 'f', 1).arg(timer.elapsed());
+
+      scenarios.push_back(scenario);
+    }
+
+    QString projectfile = base.filePath("bench.project");
+
+    write_project(projectfile, scenarios);
+
+    QJsonArray results;
+
+    bool success = true;
+
+    for(auto &scenario : scenarios)
+    {
+      for(auto &pass : { "cold", "warm" })
+      {
+        auto result = run_build(builder, projectfile, scenario, pass);
+
+        qInfo().noquote() << QString("%1 (%2) : %3ms, %4KB peak, %5MB/s").arg(scenario.name, pass).arg(result["wall_ms"].toDouble(), 0, 'f', 0).arg(result["peak_rss_kb"].toInt()).arg(result["mb_per_s"].toDouble(), 0, 'f', 1);
+
+        success &= result["success"].toBool();
+
+        results.append(result);
+      }
+    }
+
+    QJsonObject parameters;
+    parameters["count"] = params.count;
+    parameters["size"] = params.size;
+    parameters["layers"] = params.layers;
+    parameters["grid"] = params.grid;
+
+    QJsonObject report;
+    report["parameters"] = parameters;
+    report["results"] = results;
+
+    QFile fout(output);
+
+    if (!fout.open(QIODevice::WriteOnly | QIODevice::Truncate))
+      throw runtime_error("Unable to write " + output.toStdString());
+
+    fout.write(QJsonDocument(report).toJson());
+
+    return success ? 0 : 1;
+  }
+  catch(exception &e)
+  {
+    qCritical() << "Critical Error:" << e.what();
+  }
+
+  return 1;
+}
@@ -10,6 +10,7 @@
 #include "assetfile.h"
 #include <QJsonDocument>
 #include <QDir>
+#include <sstream>
 #include <chrono>
 #include <cassert>
 
@@ -17,7 +18,225 @@
 
 using namespace std;
 
-static constexpr int MetaDataBlockSize = 16384;
+namespace
+{
+  // metadata asset (id 0) is a compact DATA block of fixed fields followed
+  // by the remaining fields as binary json, padded to leave room to grow in
+  // place. the icon follows in its own ICON chunk so it is only read when
+  // asked for. files from before carry a single 16k binary json block
+
+  constexpr uint32_t MetaDataSignature = 0x54444D41; // AMDT
+  constexpr uint32_t MetaDataVersion = 1;
+  constexpr uint32_t MetaDataGranularity = 1024;
+
+  enum MetaDataFlags
+  {
+    HasBuild = 0x01,
+  };
+
+  struct MetaDataHeader
+  {
+    uint32_t signature;
+    uint32_t version;
+    uint32_t flags;
+    uint32_t typelength;
+    uint32_t srclength;
+    uint32_t jsonlength;
+    double build;
+  };
+
+  struct MetaDataLayout
+  {
+    PackTextHeader text;
+
+    uint64_t iconoffset;
+    uint32_t iconlength;
+
+    uint64_t end;
+  };
+
+  constexpr size_t ChunkFraming = sizeof(PackChunk) + sizeof(uint32_t);
+
+  MetaDataLayout read_metadata_layout(istream &fin)
+  {
+    MetaDataLayout layout = {};
+
+    fin.clear();
+    fin.seekg(0);
+
+    PackHeader header;
+    fin.read((char*)&header, sizeof(header));
+
+    if (header.signature[0] != 0xD9 || header.signature[1] != 'S' || header.signature[2] != 'V' || header.signature[3] != 'A')
+      throw runtime_error("Invalid pack file");
+
+    uint64_t position = sizeof(PackHeader);
+
+    while (fin)
+    {
+      PackChunk chunk;
+
+      fin.seekg(position);
+      fin.read((char*)&chunk, sizeof(chunk));
+
+      if (!fin || chunk.type == "HEND"_packchunktype)
+        break;
+
+      if (chunk.type == "TEXT"_packchunktype)
+        fin.read((char*)&layout.text, sizeof(layout.text));
+
+      if (chunk.type == "ICON"_packchunktype)
+      {
+        layout.iconoffset = position + sizeof(chunk);
+        layout.iconlength = chunk.length;
+      }
+
+      position += chunk.length + ChunkFraming;
+
+      if (chunk.type == "AEND"_packchunktype)
+      {
+        layout.end = position;
+
+        return layout;
+      }
+    }
+
+    throw runtime_error("Invalid metadata block");
+  }
+
+  QByteArray encode_metadata(QJsonObject metadata)
+  {
+    MetaDataHeader header = { MetaDataSignature, MetaDataVersion, 0, 0, 0, 0, 0.0 };
+
+    QByteArray type, src;
+
+    if (metadata.value("type").isString())
+    {
+      type = metadata.take("type").toString().toUtf8();
+    }
+
+    if (metadata.value("src").isString())
+    {
+      src = metadata.take("src").toString().toUtf8();
+    }
+
+    if (metadata.value("build").isDouble())
+    {
+      header.flags |= HasBuild;
+      header.build = metadata.take("build").toDouble();
+    }
+
+    metadata.remove("icon");
+
+    QByteArray json;
+
+    if (!metadata.isEmpty())
+    {
+      json = QJsonDocument(metadata).toBinaryData();
+    }
+
+    header.typelength = type.size();
+    header.srclength = src.size();
+    header.jsonlength = json.size();
+
+    QByteArray data((char const *)&header, sizeof(header));
+
+    data += type;
+    data += src;
+    data += json;
+
+    return data;
+  }
+
+  QJsonObject decode_metadata(QByteArray const &data)
+  {
+    MetaDataHeader header = {};
+
+    if (data.size() >= (int)sizeof(header))
+      memcpy(&header, data.data(), sizeof(header));
+
+    if (header.signature != MetaDataSignature)
+      return QJsonDocument::fromBinaryData(data).object();
+
+    if (header.version != MetaDataVersion || sizeof(header) + header.typelength + header.srclength + header.jsonlength > (size_t)data.size())
+      throw runtime_error("Invalid metadata block");
+
+    QJsonObject metadata;
+
+    auto position = sizeof(header);
+
+    if (header.jsonlength != 0)
+    {
+      metadata = QJsonDocument::fromBinaryData(data.mid(position + header.typelength + header.srclength, header.jsonlength)).object();
+    }
+
+    if (header.typelength != 0)
+    {
+      metadata["type"] = QString::fromUtf8(data.data() + position, header.typelength);
+    }
+
+    position += header.typelength;
+
+    if (header.srclength != 0)
+    {
+      metadata["src"] = QString::fromUtf8(data.data() + position, header.srclength);
+    }
+
+    if (header.flags & HasBuild)
+    {
+      metadata["build"] = header.build;
+    }
+
+    return metadata;
+  }
+
+  size_t metadata_overhead(QByteArray const &icon)
+  {
+    size_t overhead = sizeof(PackHeader) + sizeof(PackAssetHeader) + sizeof(PackTextHeader) + 4*ChunkFraming;
+
+    if (icon.size() != 0)
+      overhead += icon.size() + ChunkFraming;
+
+    return overhead;
+  }
+
+  bool relocate_offset(uint32_t type, void *header, uint64_t delta)
+  {
+    switch(type)
+    {
+      case "TEXT"_packchunktype:
+        static_cast<PackTextHeader*>(header)->dataoffset += delta;
+        return true;
+
+      case "FONT"_packchunktype:
+        static_cast<PackFontHeader*>(header)->dataoffset += delta;
+        return true;
+
+      case "IMAG"_packchunktype:
+        static_cast<PackImageHeader*>(header)->dataoffset += delta;
+        return true;
+
+      case "MESH"_packchunktype:
+        static_cast<PackMeshHeader*>(header)->dataoffset += delta;
+        return true;
+
+      case "MATL"_packchunktype:
+        static_cast<PackMaterialHeader*>(header)->dataoffset += delta;
+        return true;
+
+      case "ANIM"_packchunktype:
+        static_cast<PackAnimationHeader*>(header)->dataoffset += delta;
+        return true;
+
+      case "MODL"_packchunktype:
+        static_cast<PackModelHeader*>(header)->dataoffset += delta;
+        return true;
+
+      default:
+        return false;
+    }
+  }
+}
 
 
 ///////////////////////// encode_icon ///////////////////////////////////////
@@ -48,6 +267,45 @@ QIcon decode_icon(QString const &str)
 }
 
 
+///////////////////////// decode_icon_image /////////////////////////////////
+QImage decode_icon_image(QString const &str)
+{
+  // largest image of an encoded icon, mirrors the pixmap icon engine stream
+  // with QImage in place of QPixmap so it is safe off the gui thread
+
+  QImage result;
+
+  QByteArray data = QByteArray::fromBase64(str.toUtf8());
+
+  QDataStream datastream(data);
+
+  QString key;
+
+  datastream >> key;
+
+  if (key != "QPixmapIconEngine")
+    return result;
+
+  int count = 0;
+
+  datastream >> count;
+
+  for(int i = 0; i < count && datastream.status() == QDataStream::Ok; ++i)
+  {
+    QImage image;
+    QSize size;
+    uint mode, state;
+
+    datastream >> image >> size >> mode >> state;
+
+    if (image.width() * image.height() > result.width() * result.height())
+      result = image;
+  }
+
+  return result;
+}
+
+
 ///////////////////////// read_asset_header ////////////////////////////////
 uint64_t read_asset_header(istream &fin, uint32_t id, uint32_t type, void *data, size_t size)
 {
@@ -164,6 +422,48 @@ uint64_t read_asset_payload(istream &fin, uint64_t offset, void *data, uint32_t
 }
 
 
+///////////////////////// read_asset_type ///////////////////////////////////
+uint32_t read_asset_type(istream &fin, uint32_t id)
+{
+  fin.clear();
+  fin.seekg(sizeof(PackHeader));
+
+  uint64_t position = sizeof(PackHeader);
+
+  while (fin)
+  {
+    PackChunk chunk;
+
+    fin.seekg(position);
+    fin.read((char*)&chunk, sizeof(chunk));
+
+    if (!fin || chunk.type == "HEND"_packchunktype)
+      break;
+
+    if (chunk.type == "ASET"_packchunktype)
+    {
+      PackAssetHeader aset;
+
+      fin.read((char*)&aset, sizeof(aset));
+
+      if (aset.id == id)
+      {
+        fin.seekg(position + chunk.length + sizeof(chunk) + sizeof(uint32_t));
+
+        PackChunk header;
+        fin.read((char*)&header, sizeof(header));
+
+        return (fin) ? header.type : 0;
+      }
+    }
+
+    position += chunk.length + sizeof(chunk) + sizeof(uint32_t);
+  }
+
+  return 0;
+}
+
+
 ///////////////////////// read_asset_image //////////////////////////////////
 QImage read_asset_image(istream &fin, uint32_t id, int layer)
 {
@@ -204,6 +504,18 @@ QByteArray read_asset_text(istream &fin, uint32_t id)
 ///////////////////////// read_asset_json ///////////////////////////////////
 QJsonObject read_asset_json(istream &fin, uint32_t id)
 {
+  if (id == 0)
+  {
+    auto metadata = read_asset_metadata(fin);
+
+    auto icon = read_asset_icon(fin);
+
+    if (icon != "")
+      metadata["icon"] = icon;
+
+    return metadata;
+  }
+
   PackTextHeader text;
 
   if (read_asset_header(fin, id, &text))
@@ -219,15 +531,88 @@ QJsonObject read_asset_json(istream &fin, uint32_t id)
 }
 
 
+///////////////////////// read_asset_metadata ///////////////////////////////
+QJsonObject read_asset_metadata(istream &fin)
+{
+  auto layout = read_metadata_layout(fin);
+
+  QByteArray payload(pack_payload_size(layout.text), 0);
+
+  read_asset_payload(fin, layout.text.dataoffset, payload.data(), payload.size());
+
+  auto metadata = decode_metadata(payload);
+
+  metadata.remove("icon");
+
+  return metadata;
+}
+
+
+///////////////////////// read_asset_icon ///////////////////////////////////
+QString read_asset_icon(istream &fin)
+{
+  auto layout = read_metadata_layout(fin);
+
+  if (layout.iconlength != 0)
+  {
+    QByteArray icon(layout.iconlength, 0);
+
+    fin.seekg(layout.iconoffset);
+    fin.read(icon.data(), icon.size());
+
+    return icon.toBase64();
+  }
+
+  // earlier files keep the icon inline with the metadata
+
+  QByteArray payload(pack_payload_size(layout.text), 0);
+
+  read_asset_payload(fin, layout.text.dataoffset, payload.data(), payload.size());
+
+  return decode_metadata(payload)["icon"].toString();
+}
+
+
+///////////////////////// asset_header_size /////////////////////////////////
+uint64_t asset_header_size(istream &fin)
+{
+  return read_metadata_layout(fin).end;
+}
+
+
+///////////////////////// asset_header_size /////////////////////////////////
+uint64_t asset_header_size(QJsonObject const &metadata)
+{
+  QByteArray icon = QByteArray::fromBase64(metadata["icon"].toString().toUtf8());
+
+  return metadata_overhead(icon) + encode_metadata(metadata).size();
+}
+
+
 ///////////////////////// write_asset_header ////////////////////////////////
-void write_asset_header(ostream &fout, QJsonObject const &metadata)
+void write_asset_header(ostream &fout, QJsonObject const &metadata, uint64_t headersize)
 {
-  write_header(fout);
+  QByteArray data = encode_metadata(metadata);
 
-  QByteArray data = QJsonDocument(metadata).toBinaryData();
+  QByteArray icon = QByteArray::fromBase64(metadata["icon"].toString().toUtf8());
 
-  if (data.size() > MetaDataBlockSize)
-    throw runtime_error("Metadata block size exceeded");
+  size_t overhead = metadata_overhead(icon);
+
+  size_t capacity = (data.size() + MetaDataGranularity + MetaDataGranularity - 1) / MetaDataGranularity * MetaDataGranularity;
+
+  // rewriting an existing header must keep its size, the fields take up
+  // whatever the icon leaves. Document::save relocates the assets first
+  // when they no longer fit (see relocate_assets)
+
+  if (headersize != 0)
+  {
+    if (headersize < overhead + data.size())
+      throw runtime_error("Metadata block size exceeded");
+
+    capacity = headersize - overhead;
+  }
+
+  write_header(fout);
 
   PackAssetHeader aset = { 0 };
 
@@ -237,10 +622,15 @@ void write_asset_header(ostream &fout, QJsonObject const &metadata)
 
   write_chunk(fout, "TEXT", sizeof(shdr), &shdr);
 
-  data.resize(MetaDataBlockSize);
+  data.resize(capacity);
 
   write_chunk(fout, "DATA", data.size(), data.data());
 
+  if (icon.size() != 0)
+  {
+    write_chunk(fout, "ICON", icon.size(), icon.data());
+  }
+
   write_chunk(fout, "AEND", 0, nullptr);
 }
 
@@ -446,6 +836,101 @@ uint64_t write_footer(Studio::Document *document, uint64_t position)
 }
 
 
+///////////////////////// asset_header_size /////////////////////////////////
+uint64_t asset_header_size(Studio::Document *document)
+{
+  uint64_t position = sizeof(PackHeader);
+
+  while (true)
+  {
+    PackChunk chunk;
+
+    if (document->read(position, &chunk, sizeof(chunk)) != sizeof(chunk) || chunk.type == "HEND"_packchunktype)
+      throw runtime_error("Invalid metadata block");
+
+    position += chunk.length + ChunkFraming;
+
+    if (chunk.type == "AEND"_packchunktype)
+      return position;
+  }
+}
+
+
+///////////////////////// relocate_assets ///////////////////////////////////
+uint64_t relocate_assets(Studio::Document *document, QJsonObject const &metadata)
+{
+  constexpr size_t maxrunbytes = 1024*1024;
+
+  auto headersize = asset_header_size(document);
+
+  ostringstream header;
+
+  write_asset_header(header, metadata);
+
+  auto headerbytes = header.str();
+
+  if (headerbytes.size() <= headersize)
+    return headersize;
+
+  uint64_t delta = headerbytes.size() - headersize;
+
+  vector<pair<uint64_t, PackChunk>> chunks;
+
+  uint64_t position = headersize;
+
+  while (true)
+  {
+    PackChunk chunk;
+
+    if (document->read(position, &chunk, sizeof(chunk)) != sizeof(chunk))
+      throw runtime_error("Invalid asset file");
+
+    chunks.emplace_back(position, chunk);
+
+    position += chunk.length + ChunkFraming;
+
+    if (chunk.type == "HEND"_packchunktype)
+      break;
+  }
+
+  // shift the assets back to front so nothing is overwritten before it is
+  // read, then fix up the absolute payload offsets in their headers
+
+  vector<char> run(maxrunbytes);
+
+  for(uint64_t end = position; end > headersize; )
+  {
+    auto bytes = min<uint64_t>(end - headersize, run.size());
+
+    document->read(end - bytes, run.data(), bytes);
+    document->write(end - bytes + delta, run.data(), bytes);
+
+    end -= bytes;
+  }
+
+  for(auto &entry : chunks)
+  {
+    auto &chunk = entry.second;
+
+    if (chunk.type == "DATA"_packchunktype || chunk.type == "CDAT"_packchunktype)
+      continue;
+
+    vector<char> buffer(chunk.length);
+
+    document->read(entry.first + delta + sizeof(chunk), buffer.data(), buffer.size());
+
+    if (relocate_offset(chunk.type, buffer.data(), delta))
+    {
+      write_chunk(document, entry.first + delta, (char const *)&chunk.type, buffer.size(), buffer.data());
+    }
+  }
+
+  document->write(0, headerbytes.data(), headerbytes.size());
+
+  return headerbytes.size();
+}
+
+
 ///////////////////////// buildtime /////////////////////////////////////////
 double buildtime()
 {
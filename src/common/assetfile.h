@@ -20,6 +20,7 @@
 
 QString encode_icon(QIcon const &icon);
 QIcon decode_icon(QString const &str);
+QImage decode_icon_image(QString const &str);
 
 uint64_t read_asset_header(std::istream &fin, uint32_t id, PackTextHeader *text);
 uint64_t read_asset_header(std::istream &fin, uint32_t id, PackFontHeader *font);
@@ -29,12 +30,18 @@ uint64_t read_asset_header(std::istream &fin, uint32_t id, PackMaterialHeader *m
 uint64_t read_asset_header(std::istream &fin, uint32_t id, PackAnimationHeader *anim);
 uint64_t read_asset_header(std::istream &fin, uint32_t id, PackModelHeader *modl);
 uint64_t read_asset_payload(std::istream &fin, uint64_t offset, void *data, uint32_t size);
+uint32_t read_asset_type(std::istream &fin, uint32_t id);
 
 QImage read_asset_image(std::istream &fin, uint32_t id, int layer);
 QByteArray read_asset_text(std::istream &fin, uint32_t id);
 QJsonObject read_asset_json(std::istream &fin, uint32_t id);
 
-void write_asset_header(std::ostream &fout, QJsonObject const &metadata);
+QJsonObject read_asset_metadata(std::istream &fin);
+QString read_asset_icon(std::istream &fin);
+uint64_t asset_header_size(std::istream &fin);
+uint64_t asset_header_size(QJsonObject const &metadata);
+
+void write_asset_header(std::ostream &fout, QJsonObject const &metadata, uint64_t headersize = 0);
 void write_asset_text(std::ostream &fout, uint32_t id, uint32_t length, void const *data);
 void write_asset_image(std::ostream &fout, uint32_t id, std::vector<QImage> const &images, uint32_t format);
 void write_asset_json(std::ostream &fout, uint32_t id, QJsonObject const &json);
@@ -55,6 +62,9 @@ uint64_t read_asset_payload(Studio::Document *document, uint64_t offset, void *d
 uint64_t write_text_asset(Studio::Document *document, uint64_t position, uint32_t id, uint32_t length, void const *data);
 uint64_t write_footer(Studio::Document *document, uint64_t position);
 
+uint64_t asset_header_size(Studio::Document *document);
+uint64_t relocate_assets(Studio::Document *document, QJsonObject const &metadata);
+
 //
 // Misc Functions
 //
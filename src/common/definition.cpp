@@ -0,0 +1,363 @@
+//
+// Definition Cache
+//
+
+//
+// Copyright (C) 2016 Peter Niekamp
+//
+
+#include "definition.h"
+#include "assetfile.h"
+#include <QCoreApplication>
+#include <QJsonDocument>
+#include <QThread>
+#include <vector>
+
+#include <QDebug>
+
+using namespace std;
+
+//|---------------------- DefinitionCache -----------------------------------
+//|--------------------------------------------------------------------------
+
+///////////////////////// DefinitionCache::instance /////////////////////////
+DefinitionCache *DefinitionCache::instance()
+{
+  static DefinitionCache instance;
+
+  return &instance;
+}
+
+
+///////////////////////// DefinitionCache::Constructor //////////////////////
+DefinitionCache::DefinitionCache()
+  : m_timer(this)
+{
+  m_generation = 0;
+
+  moveToThread(QCoreApplication::instance()->thread());
+
+  m_timer.setSingleShot(true);
+  m_timer.setInterval(WriteInterval);
+
+  connect(&m_timer, &QTimer::timeout, this, &DefinitionCache::flush);
+
+  connect(QCoreApplication::instance(), &QCoreApplication::aboutToQuit, this, &DefinitionCache::flush);
+
+  auto documentmanager = Studio::Core::instance()->find_object<Studio::DocumentManager>();
+
+  connect(documentmanager, &Studio::DocumentManager::document_changed, this, [=](Studio::Document *document) { invalidate(document); }, Qt::DirectConnection);
+  connect(documentmanager, &Studio::DocumentManager::documents_changed, this, [=](QVector<Studio::DocumentManager::Change> const &changes) { for(auto &change : changes) { if (change.document) invalidate(change.document); } }, Qt::DirectConnection);
+}
+
+
+///////////////////////// DefinitionCache::entry ////////////////////////////
+DefinitionCache::Entry &DefinitionCache::entry(Studio::Document *document)
+{
+  auto entry = m_entries.find(document);
+
+  if (entry == m_entries.end())
+  {
+    connect(document, &QObject::destroyed, this, [=]() { erase(document); }, Qt::DirectConnection);
+    connect(document, &Studio::Document::about_to_save, this, [=]() { land(document); }, Qt::DirectConnection);
+    connect(document, &Studio::Document::about_to_discard, this, [=]() { drop(document); }, Qt::DirectConnection);
+
+    entry = m_entries.insert(document, Entry());
+  }
+
+  return *entry;
+}
+
+
+///////////////////////// DefinitionCache::read /////////////////////////////
+QJsonObject DefinitionCache::read(Studio::Document *document)
+{
+  uint64_t generation = 0;
+
+  {
+    lock_guard<mutex> lock(m_mutex);
+
+    auto entry = m_entries.find(document);
+
+    if (entry != m_entries.end() && entry->loaded)
+      return entry->definition;
+
+    generation = m_generation;
+  }
+
+  QJsonObject definition;
+
+  document->lock();
+
+  PackTextHeader text;
+
+  if (read_asset_header(document, 1, &text))
+  {
+    QByteArray payload(pack_payload_size(text), 0);
+
+    read_asset_payload(document, text.dataoffset, payload.data(), payload.size());
+
+    definition = QJsonDocument::fromBinaryData(payload).object();
+  }
+
+  document->unlock();
+
+  lock_guard<mutex> lock(m_mutex);
+
+  auto entry = m_entries.find(document);
+
+  if (entry != m_entries.end() && entry->loaded)
+    return entry->definition;
+
+  // a change during the parse may have been missed, leave it uncached
+
+  if (generation != m_generation)
+    return definition;
+
+  auto &loaded = this->entry(document);
+
+  loaded.definition = definition;
+  loaded.loaded = true;
+
+  return loaded.definition;
+}
+
+
+///////////////////////// DefinitionCache::write ////////////////////////////
+void DefinitionCache::write(Studio::Document *document, QJsonObject const &definition)
+{
+  bool deferred = (QThread::currentThread() == thread());
+
+  {
+    lock_guard<mutex> lock(m_mutex);
+
+    auto &entry = this->entry(document);
+
+    if (entry.batch != 0 || deferred)
+    {
+      bool hold = !entry.dirty;
+
+      entry.definition = definition;
+      entry.loaded = true;
+      entry.dirty = true;
+
+      if (entry.batch == 0 && !m_timer.isActive())
+        m_timer.start();
+
+      // keep the document open until the held write lands
+
+      if (hold)
+        Studio::Core::instance()->find_object<Studio::DocumentManager>()->dup(document);
+
+      if (!hold || !deferred)
+        return;
+    }
+  }
+
+  if (deferred)
+  {
+    // the document reads as modified while the write is held, so a close
+    // still prompts and a save lands it first (see land)
+
+    document->lock_exclusive();
+
+    document->set_metadata("build", buildtime());
+
+    document->unlock_exclusive(false);
+
+    return;
+  }
+
+  write_definition(document, definition);
+}
+
+
+///////////////////////// DefinitionCache::begin ////////////////////////////
+void DefinitionCache::begin(Studio::Document *document)
+{
+  lock_guard<mutex> lock(m_mutex);
+
+  entry(document).batch += 1;
+}
+
+
+///////////////////////// DefinitionCache::commit ///////////////////////////
+void DefinitionCache::commit(Studio::Document *document)
+{
+  QJsonObject definition;
+
+  {
+    lock_guard<mutex> lock(m_mutex);
+
+    auto &entry = this->entry(document);
+
+    if (--entry.batch != 0 || !entry.dirty)
+      return;
+
+    definition = entry.definition;
+
+    entry.dirty = false;
+  }
+
+  write_definition(document, definition);
+
+  Studio::Core::instance()->find_object<Studio::DocumentManager>()->close(document);
+}
+
+
+///////////////////////// DefinitionCache::flush ////////////////////////////
+void DefinitionCache::flush()
+{
+  vector<pair<Studio::Document*, QJsonObject>> pending;
+
+  {
+    lock_guard<mutex> lock(m_mutex);
+
+    for(auto entry = m_entries.begin(); entry != m_entries.end(); ++entry)
+    {
+      if (entry->dirty && entry->batch == 0)
+      {
+        pending.emplace_back(entry.key(), entry->definition);
+
+        entry->dirty = false;
+      }
+    }
+  }
+
+  auto documentmanager = Studio::Core::instance()->find_object<Studio::DocumentManager>();
+
+  for(auto &write : pending)
+  {
+    write_definition(write.first, write.second);
+
+    documentmanager->close(write.first);
+  }
+}
+
+
+///////////////////////// DefinitionCache::write_definition /////////////////
+void DefinitionCache::write_definition(Studio::Document *document, QJsonObject const &definition, bool locked)
+{
+  QByteArray data = QJsonDocument(definition).toBinaryData();
+
+  if (!locked)
+    document->lock_exclusive();
+
+  PackTextHeader text;
+
+  if (auto position = read_asset_header(document, 1, &text))
+  {
+    position += write_text_asset(document, position, 1, data.size(), data.data());
+
+    position += write_footer(document, position);
+
+    document->set_metadata("build", buildtime());
+  }
+
+  {
+    lock_guard<mutex> lock(m_mutex);
+
+    auto &entry = this->entry(document);
+
+    entry.definition = definition;
+    entry.loaded = true;
+    entry.written = !locked;
+  }
+
+  if (!locked)
+    document->unlock_exclusive();
+}
+
+
+///////////////////////// DefinitionCache::land /////////////////////////////
+void DefinitionCache::land(Studio::Document *document)
+{
+  // the saving thread already holds the document exclusively
+
+  QJsonObject definition;
+
+  {
+    lock_guard<mutex> lock(m_mutex);
+
+    auto entry = m_entries.find(document);
+
+    if (entry == m_entries.end() || !entry->dirty || entry->batch != 0)
+      return;
+
+    definition = entry->definition;
+
+    entry->dirty = false;
+  }
+
+  write_definition(document, definition, true);
+
+  Studio::Core::instance()->find_object<Studio::DocumentManager>()->close(document);
+}
+
+
+///////////////////////// DefinitionCache::drop /////////////////////////////
+void DefinitionCache::drop(Studio::Document *document)
+{
+  // a discard or rewrite reverts the held write along with everything else
+
+  bool held = false;
+
+  {
+    lock_guard<mutex> lock(m_mutex);
+
+    auto entry = m_entries.find(document);
+
+    if (entry == m_entries.end())
+      return;
+
+    held = entry->dirty && entry->batch == 0;
+
+    if (held)
+      entry->dirty = false;
+
+    entry->loaded = false;
+    entry->written = false;
+  }
+
+  if (held)
+    Studio::Core::instance()->find_object<Studio::DocumentManager>()->close(document);
+}
+
+
+///////////////////////// DefinitionCache::invalidate ///////////////////////
+void DefinitionCache::invalidate(Studio::Document *document)
+{
+  lock_guard<mutex> lock(m_mutex);
+
+  m_generation += 1;
+
+  auto entry = m_entries.find(document);
+
+  if (entry != m_entries.end())
+  {
+    // our own write already holds the new definition
+
+    if (entry->written)
+    {
+      entry->written = false;
+
+      return;
+    }
+
+    // held writes win over the change, otherwise reparse on next read
+
+    if (!entry->dirty)
+      entry->loaded = false;
+  }
+}
+
+
+///////////////////////// DefinitionCache::erase ////////////////////////////
+void DefinitionCache::erase(Studio::Document *document)
+{
+  lock_guard<mutex> lock(m_mutex);
+
+  m_generation += 1;
+
+  m_entries.remove(document);
+}
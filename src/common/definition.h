@@ -0,0 +1,103 @@
+//
+// Definition Cache
+//
+
+//
+// Copyright (C) 2016 Peter Niekamp
+//
+
+#pragma once
+
+#include "documentapi.h"
+#include <QHash>
+#include <QTimer>
+#include <QJsonObject>
+#include <mutex>
+
+//-------------------------- DefinitionCache --------------------------------
+//---------------------------------------------------------------------------
+
+// parsed json definitions (text asset 1) shared by every reader of a
+// document. writes made while a batch is open are held and rewritten once
+// when the outermost batch commits. other writes from the ui thread are
+// debounced, rapid edits coalesce into a single rewrite (and change
+// notification) per write interval
+
+class DOCUMENTPLUGIN_EXPORT DefinitionCache : public QObject
+{
+  Q_OBJECT
+
+  public:
+
+    static constexpr int WriteInterval = 30;
+
+    static DefinitionCache *instance();
+
+  public:
+
+    QJsonObject read(Studio::Document *document);
+
+    void write(Studio::Document *document, QJsonObject const &definition);
+
+    void begin(Studio::Document *document);
+    void commit(Studio::Document *document);
+
+    void flush();
+
+  private:
+    DefinitionCache();
+
+    struct Entry
+    {
+      QJsonObject definition;
+
+      int batch = 0;
+      bool loaded = false;
+      bool dirty = false;
+      bool written = false;
+    };
+
+    Entry &entry(Studio::Document *document);
+
+    void write_definition(Studio::Document *document, QJsonObject const &definition, bool locked = false);
+
+    void land(Studio::Document *document);
+    void drop(Studio::Document *document);
+
+    void invalidate(Studio::Document *document);
+
+    void erase(Studio::Document *document);
+
+    QTimer m_timer;
+
+    QHash<Studio::Document*, Entry> m_entries;
+
+    uint64_t m_generation;
+
+    mutable std::mutex m_mutex;
+};
+
+
+//-------------------------- DefinitionBatch --------------------------------
+//---------------------------------------------------------------------------
+
+class DefinitionBatch
+{
+  public:
+    DefinitionBatch(Studio::Document *document)
+      : m_document(document)
+    {
+      DefinitionCache::instance()->begin(m_document);
+    }
+
+    DefinitionBatch(DefinitionBatch const &) = delete;
+
+    ~DefinitionBatch()
+    {
+      DefinitionCache::instance()->commit(m_document);
+    }
+
+  private:
+
+    Studio::Document *m_document;
+};
@@ -0,0 +1,140 @@
+//
+// Hash Cache
+//
+
+//
+// Copyright (C) 2016 Peter Niekamp
+//
+
+#include "hashcache.h"
+#include <cstring>
+
+#include <QDebug>
+
+using namespace std;
+
+//|---------------------- HashCache -----------------------------------------
+//|--------------------------------------------------------------------------
+
+///////////////////////// HashCache::instance ///////////////////////////////
+HashCache *HashCache::instance()
+{
+  static HashCache instance;
+
+  return &instance;
+}
+
+
+///////////////////////// HashCache::Constructor ////////////////////////////
+HashCache::HashCache()
+{
+  m_generation = 0;
+
+  auto documentmanager = Studio::Core::instance()->find_object<Studio::DocumentManager>();
+
+  connect(documentmanager, &Studio::DocumentManager::document_changed, this, [=](Studio::Document *document, QString const &path) { invalidate(document, path); }, Qt::DirectConnection);
+  connect(documentmanager, &Studio::DocumentManager::document_renamed, this, [=](Studio::Document *document, QString const &src, QString const &dst) { invalidate(document, src); invalidate(document, dst); }, Qt::DirectConnection);
+  connect(documentmanager, &Studio::DocumentManager::documents_changed, this, [=](QVector<Studio::DocumentManager::Change> const &changes) { for(auto &change : changes) { invalidate(change.document, change.src); invalidate(change.document, change.dst); } }, Qt::DirectConnection);
+}
+
+
+///////////////////////// HashCache::hash ///////////////////////////////////
+size_t HashCache::hash(Studio::Document *document, const char *kind, Compute const &compute)
+{
+  uint64_t generation;
+
+  {
+    lock_guard<mutex> lock(m_mutex);
+
+    auto entry = m_entries.find(document);
+
+    if (entry != m_entries.end())
+    {
+      for(auto &key : entry->keys)
+      {
+        if (strcmp(key.first, kind) == 0)
+          return key.second;
+      }
+    }
+
+    generation = m_generation;
+  }
+
+  QStringList dependencies;
+
+  size_t key = compute(dependencies);
+
+  auto path = Studio::Core::instance()->find_object<Studio::DocumentManager>()->path(document);
+
+  lock_guard<mutex> lock(m_mutex);
+
+  // a change during the computation may have been missed, leave it uncached
+
+  if (generation != m_generation)
+    return key;
+
+  auto &entry = m_entries[document];
+
+  entry.path = path;
+  entry.keys.emplace_back(kind, key);
+
+  for(auto &dependency : dependencies)
+  {
+    if (dependency != "" && !m_dependants.contains(dependency, document))
+      m_dependants.insert(dependency, document);
+  }
+
+  if (!m_watched.contains(document))
+  {
+    connect(document, &QObject::destroyed, this, [=]() { erase(document); }, Qt::DirectConnection);
+
+    m_watched.insert(document);
+  }
+
+  return key;
+}
+
+
+///////////////////////// HashCache::invalidate /////////////////////////////
+void HashCache::invalidate(Studio::Document *document, QString const &path)
+{
+  lock_guard<mutex> lock(m_mutex);
+
+  m_generation += 1;
+
+  m_entries.remove(document);
+
+  QStringList pending = { path };
+
+  while (!pending.isEmpty())
+  {
+    auto dependency = pending.takeLast();
+
+    for(auto &dependant : m_dependants.values(dependency))
+    {
+      auto entry = m_entries.find(dependant);
+
+      if (entry != m_entries.end())
+      {
+        pending.push_back(entry->path);
+
+        m_entries.erase(entry);
+      }
+    }
+
+    m_dependants.remove(dependency);
+  }
+}
+
+
+///////////////////////// HashCache::erase //////////////////////////////////
+void HashCache::erase(Studio::Document *document)
+{
+  lock_guard<mutex> lock(m_mutex);
+
+  m_generation += 1;
+
+  m_entries.remove(document);
+
+  m_watched.remove(document);
+}
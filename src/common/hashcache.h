@@ -0,0 +1,63 @@
+//
+// Hash Cache
+//
+
+//
+// Copyright (C) 2016 Peter Niekamp
+//
+
+#pragma once
+
+#include "documentapi.h"
+#include <QHash>
+#include <QMultiHash>
+#include <QSet>
+#include <functional>
+#include <vector>
+#include <mutex>
+
+//-------------------------- HashCache --------------------------------------
+//---------------------------------------------------------------------------
+
+// memoised document hashes, an entry is dropped when its document changes
+// and the invalidation follows the recorded dependencies so any hash built
+// from a changed document is recomputed on next use
+
+class DOCUMENTPLUGIN_EXPORT HashCache : public QObject
+{
+  Q_OBJECT
+
+  public:
+
+    static HashCache *instance();
+
+  public:
+
+    using Compute = std::function<size_t (QStringList &dependencies)>;
+
+    size_t hash(Studio::Document *document, const char *kind, Compute const &compute);
+
+    void invalidate(Studio::Document *document, QString const &path);
+
+  private:
+    HashCache();
+
+    struct Entry
+    {
+      QString path;
+
+      std::vector<std::pair<const char*, size_t>> keys;
+    };
+
+    void erase(Studio::Document *document);
+
+    QHash<Studio::Document*, Entry> m_entries;
+
+    QMultiHash<QString, Studio::Document*> m_dependants;
+
+    QSet<Studio::Document*> m_watched;
+
+    uint64_t m_generation;
+
+    mutable std::mutex m_mutex;
+};
@@ -0,0 +1,251 @@
+//
+// Tangent Space
+//
+
+//
+// Copyright (C) 2016 Peter Niekamp
+//
+
+#include "tangentspace.h"
+#include "datum/math.h"
+#include <thread>
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+using namespace lml;
+
+namespace
+{
+  constexpr size_t MinTrianglesPerThread = 16384;
+  constexpr size_t MaxAccumulatorBytes = 256*1024*1024;
+
+  struct Accumulator
+  {
+    Vec3 tangent[2];
+
+    uint32_t used;
+  };
+
+  Vec3 position(PackVertex const &vertex)
+  {
+    return Vec3(vertex.position[0], vertex.position[1], vertex.position[2]);
+  }
+
+  Vec3 normal(PackVertex const &vertex)
+  {
+    return Vec3(vertex.normal[0], vertex.normal[1], vertex.normal[2]);
+  }
+
+  Vec3 project(Vec3 const &v, Vec3 const &n)
+  {
+    return v - n * dot(n, v);
+  }
+
+  Vec3 safe_normalise(Vec3 const &v)
+  {
+    auto len = norm(v);
+
+    return (len > 1e-12f) ? v / len : Vec3(0);
+  }
+
+  Vec3 perpendicular(Vec3 const &n)
+  {
+    return safe_normalise((abs(n.x) < 0.9f) ? cross(n, Vec3(1, 0, 0)) : cross(n, Vec3(0, 1, 0)));
+  }
+
+  void accumulate(vector<PackVertex> const &vertices, vector<uint32_t> const &indices, size_t beg, size_t end, Accumulator *accumulators, uint8_t *signs)
+  {
+    for(size_t i = beg; i < end; ++i)
+    {
+      uint32_t const *tri = &indices[3*i];
+
+      auto &v1 = vertices[tri[0]];
+      auto &v2 = vertices[tri[1]];
+      auto &v3 = vertices[tri[2]];
+
+      auto x1 = v2.position[0] - v1.position[0];
+      auto x2 = v3.position[0] - v1.position[0];
+      auto y1 = v2.position[1] - v1.position[1];
+      auto y2 = v3.position[1] - v1.position[1];
+      auto z1 = v2.position[2] - v1.position[2];
+      auto z2 = v3.position[2] - v1.position[2];
+
+      auto s1 = v2.texcoord[0] - v1.texcoord[0];
+      auto s2 = v3.texcoord[0] - v1.texcoord[0];
+      auto t1 = v1.texcoord[1] - v2.texcoord[1];
+      auto t2 = v1.texcoord[1] - v3.texcoord[1];
+
+      auto r = s1 * t2 - s2 * t1;
+
+      if (r == 0)
+      {
+        signs[3*i+0] = signs[3*i+1] = signs[3*i+2] = 0;
+
+        for(int k = 0; k < 3; ++k)
+          accumulators[tri[k]].used |= 1;
+
+        continue;
+      }
+
+      auto sdir = Vec3(t2 * x1 - t1 * x2, t2 * y1 - t1 * y2, t2 * z1 - t1 * z2) / r;
+      auto tdir = Vec3(s1 * x2 - s2 * x1, s1 * y2 - s2 * y1, s1 * z2 - s2 * z1) / r;
+
+      for(int k = 0; k < 3; ++k)
+      {
+        auto &vertex = vertices[tri[k]];
+
+        auto n = normal(vertex);
+
+        auto sign = (dot(cross(n, sdir), tdir) < 0.0f) ? 0 : 1;
+
+        auto e1 = safe_normalise(project(position(vertices[tri[(k+1)%3]]) - position(vertex), n));
+        auto e2 = safe_normalise(project(position(vertices[tri[(k+2)%3]]) - position(vertex), n));
+
+        auto angle = acos(min(max(dot(e1, e2), -1.0f), 1.0f));
+
+        accumulators[tri[k]].tangent[sign] += safe_normalise(project(sdir, n)) * angle;
+        accumulators[tri[k]].used |= 1 << sign;
+
+        signs[3*i+k] = sign;
+      }
+    }
+  }
+
+  template<typename Split>
+  void calculate_tangents(vector<PackVertex> &vertices, vector<uint32_t> &indices, Split &&split)
+  {
+    size_t vertexcount = vertices.size();
+    size_t trianglecount = indices.size() / 3;
+
+    if (vertexcount == 0 || trianglecount == 0)
+      return;
+
+    size_t threads = max(thread::hardware_concurrency(), 1u);
+
+    threads = min(threads, max<size_t>(trianglecount / MinTrianglesPerThread, 1));
+    threads = min(threads, max<size_t>(MaxAccumulatorBytes / (vertexcount * sizeof(Accumulator)), 1));
+
+    vector<Accumulator> accumulators(threads * vertexcount, Accumulator{ { Vec3(0), Vec3(0) }, 0 });
+
+    vector<uint8_t> signs(3 * trianglecount);
+
+    //
+    // per thread accumulation over triangle ranges
+    //
+
+    vector<thread> workers;
+
+    for(size_t i = 0; i < threads; ++i)
+    {
+      auto beg = i * trianglecount / threads;
+      auto end = (i + 1) * trianglecount / threads;
+
+      auto worker = [&,beg,end,i]() { accumulate(vertices, indices, beg, end, accumulators.data() + i * vertexcount, signs.data()); };
+
+      if (i + 1 < threads)
+        workers.emplace_back(worker);
+      else
+        worker();
+    }
+
+    for(auto &worker : workers)
+      worker.join();
+
+    for(size_t i = 1; i < threads; ++i)
+    {
+      auto src = accumulators.data() + i * vertexcount;
+
+      for(size_t k = 0; k < vertexcount; ++k)
+      {
+        accumulators[k].tangent[0] += src[k].tangent[0];
+        accumulators[k].tangent[1] += src[k].tangent[1];
+        accumulators[k].used |= src[k].used;
+      }
+    }
+
+    //
+    // split vertices referenced with both handedness
+    //
+
+    vector<uint32_t> mirror(vertexcount, ~0u);
+
+    for(size_t k = 0; k < vertexcount; ++k)
+    {
+      if (accumulators[k].used == 3)
+      {
+        mirror[k] = vertices.size();
+
+        vertices.push_back(vertices[k]);
+
+        split(k);
+      }
+    }
+
+    for(size_t i = 0; i < indices.size(); ++i)
+    {
+      if (signs[i] == 1 && mirror[indices[i]] != ~0u)
+        indices[i] = mirror[indices[i]];
+    }
+
+    //
+    // orthonormalise
+    //
+
+    auto finalise = [&](PackVertex &vertex, Vec3 const &accumulated, float handedness) {
+
+      auto n = normal(vertex);
+
+      auto tangent = project(accumulated, n);
+
+      if (norm(tangent) > 1e-12f)
+        tangent = normalise(tangent);
+      else
+        tangent = perpendicular(n);
+
+      vertex.tangent[0] = tangent.x;
+      vertex.tangent[1] = tangent.y;
+      vertex.tangent[2] = tangent.z;
+      vertex.tangent[3] = handedness;
+    };
+
+    for(size_t k = 0; k < vertexcount; ++k)
+    {
+      auto &accumulator = accumulators[k];
+
+      if (mirror[k] != ~0u)
+      {
+        finalise(vertices[k], accumulator.tangent[0], 1.0f);
+        finalise(vertices[mirror[k]], accumulator.tangent[1], -1.0f);
+      }
+      else if (accumulator.used == 2)
+      {
+        finalise(vertices[k], accumulator.tangent[1], -1.0f);
+      }
+      else
+      {
+        finalise(vertices[k], accumulator.tangent[0], 1.0f);
+      }
+    }
+  }
+}
+
+
+///////////////////////// calculate_tangents ////////////////////////////////
+void calculate_tangents(vector<PackVertex> &vertices, vector<uint32_t> &indices)
+{
+  calculate_tangents(vertices, indices, [](size_t) { });
+}
+
+
+///////////////////////// calculate_tangents ////////////////////////////////
+void calculate_tangents(vector<PackVertex> &vertices, vector<uint32_t> &indices, vector<PackMeshPayload::Rig> &rig)
+{
+  if (rig.empty())
+  {
+    calculate_tangents(vertices, indices);
+    return;
+  }
+
+  calculate_tangents(vertices, indices, [&](size_t k) { rig.push_back(rig[k]); });
+}
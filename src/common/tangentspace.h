@@ -0,0 +1,24 @@
+//
+// Tangent Space
+//
+
+//
+// Copyright (C) 2016 Peter Niekamp
+//
+
+#pragma once
+
+#include "assetpacker.h"
+#include <vector>
+
+//
+// Tangent Space Functions
+//
+// Generates MikkTSpace style tangents : per corner tangents are projected
+// onto the vertex normal plane, angle weighted and accumulated per vertex.
+// Vertices shared by corners of opposing handedness are split. Indices (and
+// rig, when supplied) are updated to match.
+//
+
+void calculate_tangents(std::vector<PackVertex> &vertices, std::vector<uint32_t> &indices);
+void calculate_tangents(std::vector<PackVertex> &vertices, std::vector<uint32_t> &indices, std::vector<PackMeshPayload::Rig> &rig);
@@ -214,6 +214,15 @@ Studio::ActionContainer *ActionManager::register_container(QString const &id, QT
 }
 
 
+///////////////////////// ActionManager::register_container /////////////////
+Studio::ActionContainer *ActionManager::register_container(QString const &id, Studio::ActionContainer *container)
+{
+  m_containers[id] = container;
+
+  return container;
+}
+
+
 
 //|---------------------- MainWindow ----------------------------------------
 //|--------------------------------------------------------------------------
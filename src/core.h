@@ -104,6 +104,7 @@ class ActionManager : public Studio::ActionManager
     Studio::ActionContainer *register_container(QString const &id, QMenu *menu);
     Studio::ActionContainer *register_container(QString const &id, QMenuBar *menubar);
     Studio::ActionContainer *register_container(QString const &id, QToolBar *toolbar);
+    Studio::ActionContainer *register_container(QString const &id, Studio::ActionContainer *container);
 
   private:
 
@@ -0,0 +1,261 @@
+//
+// Datum Studio Headless Build
+//
+
+//
+// Copyright (c) 2016 Peter Niekamp
+//
+
+#include <QGuiApplication>
+#include <QDir>
+#include <QFileInfo>
+#include <QElapsedTimer>
+#include <QPluginLoader>
+#include <leap/pathstring.h>
+#include "platform.h"
+#include "core.h"
+#include "projectapi.h"
+#include "packapi.h"
+#include <iostream>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+#include <QtDebug>
+
+using namespace std;
+
+namespace
+{
+  //|---------------------- NullContainer -----------------------------------
+  //|------------------------------------------------------------------------
+
+  class NullContainer : public Studio::ActionContainer
+  {
+    public:
+
+      void add_back(QAction *action) { }
+      void add_front(QAction *action) { }
+
+      void add_back(ActionContainer *menu) { }
+  };
+
+  //|---------------------- find_object -------------------------------------
+  //|------------------------------------------------------------------------
+
+  // plugin interfaces are resolved by class name so this tool need not link
+  // against the plugin libraries themselves
+
+  template<typename T>
+  T *find_object(const char *classname)
+  {
+    for(auto &object : Studio::Core::instance()->objects())
+    {
+      if (object->inherits(classname))
+        return static_cast<T*>(object);
+    }
+
+    return nullptr;
+  }
+
+  //|---------------------- peak_memory -------------------------------------
+  //|------------------------------------------------------------------------
+
+  // peak resident set size of this process in bytes
+
+  size_t peak_memory()
+  {
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+      return 0;
+
+    return counters.PeakWorkingSetSize;
+#else
+    struct rusage usage;
+
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+      return 0;
+
+#ifdef __APPLE__
+    return usage.ru_maxrss;
+#else
+    return usage.ru_maxrss * 1024;
+#endif
+#endif
+  }
+}
+
+
+///////////////////////// Platform::instance ////////////////////////////////
+DatumPlatform::PlatformInterface *Studio::Platform::instance()
+{
+  return nullptr;
+}
+
+
+void usage()
+{
+  cout << "Usage: datumstudio-build [options] project [group...]\n\n";
+  cout << "    -o=file\t\tOutput pack (default Build/asset.pack)\n";
+  cout << "    --trace\t\tWrite trace.json beside the pack\n";
+  cout << "    -h\t\t\tShow this help\n";
+}
+
+QStringList select_plugins(QDir pluginpath)
+{
+  QStringList plugins;
+  QVector<int> ordering;
+
+  for(auto &plugin : pluginpath.entryList(QDir::Files))
+  {
+    QPluginLoader loader(pluginpath.absoluteFilePath(plugin));
+
+    if (!loader.metaData().value("MetaData").toObject().value("Headless").toBool(false))
+      continue;
+
+    auto order = loader.metaData().value("MetaData").toObject().value("LoadOrder").toInt(99);
+
+    int i = 0;
+    while (i < plugins.size() && ordering[i] < order)
+      ++i;
+
+    plugins.insert(i, plugin);
+    ordering.insert(i, order);
+  }
+
+  return plugins;
+}
+
+
+//|---------------------- main ----------------------------------------------
+//|--------------------------------------------------------------------------
+
+int main(int argc, char **argv)
+{
+  if (qgetenv("QT_QPA_PLATFORM").isEmpty())
+    qputenv("QT_QPA_PLATFORM", "offscreen");
+
+  QGuiApplication app(argc, argv);
+
+  app.setOrganizationName("pniekamp");
+  app.setOrganizationDomain("au");
+  app.setApplicationName("datumstudio");
+
+  QString project;
+  QString output;
+  QStringList groups;
+
+  QStringList args = app.arguments();
+
+  for(int i = 1; i < args.size(); ++i)
+  {
+    if (args[i] == "-h" || args[i] == "--help")
+    {
+      usage();
+      return 1;
+    }
+
+    if (args[i].startsWith("-o="))
+      output = args[i].mid(3);
+
+    if (args[i].startsWith("-"))
+      continue;
+
+    if (project == "")
+      project = QFileInfo(args[i]).absoluteFilePath();
+    else
+      groups.push_back(args[i]);
+  }
+
+  if (project == "" || !QFileInfo(project).exists())
+  {
+    usage();
+    return 1;
+  }
+
+  auto actionmanager = new ActionManager;
+
+  for(auto &id : { "Studio.Menu", "Studio.Menu.File", "Studio.Meta.Box", "Studio.Main.StatusReport", "Content.Menu.Create" })
+  {
+    actionmanager->register_container(id, new NullContainer);
+  }
+
+  Studio::Core::instance()->add_object(actionmanager);
+  Studio::Core::instance()->add_object(new ViewFactory);
+
+  bool result = false;
+
+  try
+  {
+    QDir plugins(leap::pathstring("plugins/datumstudio").c_str());
+
+    for(auto &plugin : select_plugins(plugins))
+    {
+      QPluginLoader loader(plugins.absoluteFilePath(plugin));
+
+      Studio::Plugin *instance = qobject_cast<Studio::Plugin*>(loader.instance());
+
+      if (instance && strcmp(instance->build(), Studio::ApiBuild) == 0)
+      {
+        QString errormsg;
+
+        if (instance->initialise(args + QStringList("--headless"), &errormsg))
+        {
+          qInfo().noquote() << "Loaded Plugin (" + plugin + ")";
+
+          Studio::Core::instance()->add_object(instance);
+        }
+        else
+          qWarning().noquote() << "Error Initialising Plugin (" + plugin + ") : " + errormsg;
+      }
+      else
+        qWarning().noquote() << "Invalid Plugin (" + plugin + ") : " + loader.errorString();
+    }
+
+    auto projectmanager = find_object<Studio::ProjectManager>("Studio::ProjectManager");
+    auto packmanager = find_object<Studio::PackManager>("Studio::PackManager");
+
+    if (!projectmanager || !packmanager)
+      throw runtime_error("Project and Pack plugins required");
+
+    QElapsedTimer timer;
+
+    timer.start();
+
+    projectmanager->open_project(project, nullptr);
+
+    if (output == "")
+      output = QDir(projectmanager->basepath()).filePath("Build/asset.pack");
+
+    qInfo().noquote() << "Building" << output;
+
+    result = packmanager->build(project, output, groups);
+
+    projectmanager->close_project();
+
+    qInfo().noquote() << QString("Build %1 in %2ms").arg(result ? "Succeeded" : "Failed").arg(timer.elapsed());
+
+    qInfo().noquote() << QString("Peak Memory %1KB").arg(peak_memory() / 1024);
+
+    for(auto &plugin : Studio::Core::instance()->find_objects<Studio::Plugin>())
+    {
+      plugin->shutdown();
+
+      delete plugin;
+    }
+  }
+  catch(exception &e)
+  {
+    qCritical() << "Critical Error:" << e.what();
+
+    result = false;
+  }
+
+  return result ? 0 : 1;
+}
@@ -8,18 +8,18 @@
 
 
 #include "platform.h"
+#include "workqueue.h"
 #include <leap.h>
 #include <leap/pathstring.h>
 #include <iostream>
 #include <fstream>
-#include <deque>
-#include <thread>
-#include <mutex>
-#include <condition_variable>
+#include <cerrno>
 #include <QWindow>
 
 #ifndef _WIN32
 #include <QX11Info>
+#include <fcntl.h>
+#include <unistd.h>
 #endif
 
 #include <QtDebug>
@@ -46,123 +46,95 @@ void gamememory_initialise(GameMemory &pool, void *data, size_t capacity)
 //|---------------------- FileHandle ----------------------------------------
 //|--------------------------------------------------------------------------
 
+// positional reads, there is no shared file cursor so concurrent readers
+// of one handle never serialise
+
 class FileHandle
 {
   public:
     FileHandle(const char *path);
+    ~FileHandle();
 
     size_t read(uint64_t position, void *buffer, std::size_t bytes);
 
   private:
 
-    std::mutex m_lock;
-
-    std::fstream m_fio;
+#ifdef _WIN32
+    HANDLE m_fd;
+#else
+    int m_fd;
+#endif
 };
 
 
 ///////////////////////// FileHandle::Constructor /////////////////////////
 FileHandle::FileHandle(const char *path)
 {
-  m_fio.open(path, ios::in | ios::binary);
+#ifdef _WIN32
+  m_fd = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, FILE_FLAG_RANDOM_ACCESS, nullptr);
 
-  if (!m_fio)
+  if (m_fd == INVALID_HANDLE_VALUE)
     throw runtime_error(string("FileHandle Open Error: ") + path);
-}
-
-
-///////////////////////// FileHandle::Read ////////////////////////////////
-size_t FileHandle::read(uint64_t position, void *buffer, size_t bytes)
-{
-  lock_guard<mutex> lock(m_lock);
-
-  m_fio.seekg(position);
-
-  m_fio.read((char*)buffer, bytes);
-
-  if (m_fio.bad())
-    throw runtime_error("FileHandle Read Error");
+#else
+  m_fd = ::open(path, O_RDONLY | O_CLOEXEC);
 
-  return m_fio.gcount();
+  if (m_fd < 0)
+    throw runtime_error(string("FileHandle Open Error: ") + path);
+#endif
 }
 
 
-
-//|---------------------- WorkQueue -----------------------------------------
-//|--------------------------------------------------------------------------
-
-class WorkQueue
+///////////////////////// FileHandle::Destructor //////////////////////////
+FileHandle::~FileHandle()
 {
-  public:
-    WorkQueue(int threads = 4);
-    ~WorkQueue();
-
-    template<typename Func>
-    void push(Func &&func)
-    {
-      std::unique_lock<std::mutex> lock(m_mutex);
-
-      m_queue.push_back(std::forward<Func>(func));
-
-      m_signal.notify_one();
-    }
-
-  private:
-
-    std::atomic<bool> m_done;
-
-    std::mutex m_mutex;
-
-    std::condition_variable m_signal;
-
-    std::deque<std::function<void()>> m_queue;
-
-    std::vector<std::thread> m_threads;
-};
+#ifdef _WIN32
+  CloseHandle(m_fd);
+#else
+  ::close(m_fd);
+#endif
+}
 
 
-///////////////////////// WorkQueue::Constructor //////////////////////////
-WorkQueue::WorkQueue(int threads)
+///////////////////////// FileHandle::Read ////////////////////////////////
+size_t FileHandle::read(uint64_t position, void *buffer, size_t bytes)
 {
-  m_done = false;
+  size_t total = 0;
 
-  for(int i = 0; i < threads; ++i)
+  while (total < bytes)
   {
-    m_threads.push_back(std::thread([=]() {
+#ifdef _WIN32
+    OVERLAPPED overlapped = {};
+    overlapped.Offset = (DWORD)(position + total);
+    overlapped.OffsetHigh = (DWORD)((position + total) >> 32);
 
-      while (!m_done)
-      {
-        std::function<void()> work;
+    DWORD count = 0;
 
-        {
-          unique_lock<std::mutex> lock(m_mutex);
+    if (!ReadFile(m_fd, (char*)buffer + total, (DWORD)min<size_t>(bytes - total, 0x40000000), &count, &overlapped))
+    {
+      if (GetLastError() == ERROR_HANDLE_EOF)
+        break;
 
-          while (m_queue.empty())
-          {
-            m_signal.wait(lock);
-          }
+      throw runtime_error("FileHandle Read Error");
+    }
+#else
+    auto count = ::pread(m_fd, (char*)buffer + total, bytes - total, position + total);
 
-          work = std::move(m_queue.front());
+    if (count < 0)
+    {
+      if (errno == EINTR)
+        continue;
 
-          m_queue.pop_front();
-        }
+      throw runtime_error("FileHandle Read Error");
+    }
+#endif
 
-        work();
-      }
+    if (count == 0)
+      break;
 
-    }));
+    total += count;
   }
-}
-
-
-///////////////////////// WorkQueue::Destructor ///////////////////////////
-WorkQueue::~WorkQueue()
-{
-  for(size_t i = 0; i < m_threads.size(); ++i)
-    push([=]() { m_done = true; });
 
-  for(auto &thread : m_threads)
-    thread.join();
+  return total;
 }
 
 
@@ -195,10 +167,6 @@ class Platform : public PlatformInterface
 
     RenderDevice renderdevice;
 
-  protected:
-
-    WorkQueue m_workqueue;
-
 } platform;
 
 RenderDevice Platform::render_device()
@@ -248,7 +216,7 @@ void Platform::set_cursor_position(float x, float y)
 
 void Platform::submit_work(void (*func)(PlatformInterface &, void*, void*), void *ldata, void *rdata)
 {
-  m_workqueue.push([=]() { func(*this, ldata, rdata); });
+  Studio::WorkQueue::instance()->push([=]() { func(*this, ldata, rdata); }, Studio::WorkQueue::Priority::Interactive);
 }
 
 void Platform::terminate()
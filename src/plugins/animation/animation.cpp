@@ -10,22 +10,167 @@
 #include "assetfile.h"
 #include "atlaspacker.h"
 #include <functional>
+#include <cmath>
 
 #include <QDebug>
 
 using namespace std;
 using namespace lml;
 
+namespace
+{
+  using Keyframe = PackAnimationPayload::Transform;
+
+  void hash_combine(size_t &seed, size_t key)
+  {
+    seed ^= key + 0x9e3779b9 + (seed<<6) + (seed>>2);
+  }
+
+  float alignment(Keyframe const &a, Keyframe const &b)
+  {
+    float d = a.transform[0]*b.transform[0] + a.transform[1]*b.transform[1] + a.transform[2]*b.transform[2] + a.transform[3]*b.transform[3];
+
+    return (d < 0) ? -1.0f : 1.0f;
+  }
+
+  float difference(Keyframe const &a, Keyframe const &b)
+  {
+    float sign = alignment(a, b);
+
+    float result = 0;
+
+    for(int i = 0; i < 8; ++i)
+      result = max(result, abs(a.transform[i] - sign * b.transform[i]));
+
+    return result;
+  }
+
+  Keyframe interpolate(Keyframe const &a, Keyframe const &b, float time)
+  {
+    Keyframe result;
+
+    float t = (b.time != a.time) ? (time - a.time) / (b.time - a.time) : 0.0f;
+
+    float sign = alignment(a, b);
+
+    for(int i = 0; i < 8; ++i)
+      result.transform[i] = (1 - t) * a.transform[i] + t * sign * b.transform[i];
+
+    float scale = 1 / sqrt(result.transform[0]*result.transform[0] + result.transform[1]*result.transform[1] + result.transform[2]*result.transform[2] + result.transform[3]*result.transform[3]);
+
+    for(int i = 0; i < 8; ++i)
+      result.transform[i] *= scale;
+
+    result.time = time;
+
+    return result;
+  }
+
+  // keyframe reduction : greedily extend each segment while linear
+  // interpolation between its end keys reproduces every skipped key
+
+  void reduce_keyframes(Keyframe const *keys, size_t count, float tolerance, vector<Keyframe> &transforms)
+  {
+    size_t anchor = 0;
+
+    transforms.push_back(keys[0]);
+
+    while (anchor + 1 < count)
+    {
+      size_t next = anchor + 1;
+
+      for(size_t end = anchor + 2; end < count; ++end)
+      {
+        bool valid = true;
+
+        for(size_t k = anchor + 1; k < end && valid; ++k)
+        {
+          valid = difference(interpolate(keys[anchor], keys[end], keys[k].time), keys[k]) <= tolerance;
+        }
+
+        if (!valid)
+          break;
+
+        next = end;
+      }
+
+      transforms.push_back(keys[next]);
+
+      anchor = next;
+    }
+  }
+
+  void compress_animation(vector<PackAnimationPayload::Joint> &joints, Keyframe const *transformtable, size_t transformcount, float tolerance, vector<Keyframe> &transforms)
+  {
+    Keyframe const identity = { 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f };
+
+    transforms.push_back({ 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f });
+    transforms.push_back({ 1.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f });
+
+    for(auto &joint : joints)
+    {
+      // joints without keys in the table fall back to identity, a single
+      // key is a constant track and is duplicated below
+
+      if (joint.count == 0 || joint.index + joint.count > transformcount)
+      {
+        joint.index = 0;
+        joint.count = 2;
+        continue;
+      }
+
+      auto keys = transformtable + joint.index;
+
+      bool constant = true;
+
+      for(size_t k = 1; k < joint.count && constant; ++k)
+      {
+        constant = difference(keys[0], keys[k]) <= tolerance;
+      }
+
+      // constant tracks : identity shares the default keys, others keep two
+
+      if (constant && difference(keys[0], identity) <= tolerance)
+      {
+        joint.index = 0;
+        joint.count = 2;
+        continue;
+      }
+
+      auto index = transforms.size();
+
+      if (constant)
+      {
+        transforms.push_back(keys[0]);
+        transforms.push_back(keys[0]);
+        transforms.back().time = keys[joint.count - 1].time;
+      }
+      else
+      {
+        reduce_keyframes(keys, joint.count, tolerance, transforms);
+      }
+
+      joint.index = index;
+      joint.count = transforms.size() - index;
+    }
+  }
+}
+
+
 ///////////////////////// hash //////////////////////////////////////////////
 void AnimationDocument::hash(Studio::Document *document, size_t *key)
 {
   *key = std::hash<double>{}(document->metadata("build", 0.0));
+
+  hash_combine(*key, std::hash<double>{}(document->metadata("tolerance", 0.0)));
 }
 
 
 ///////////////////////// pack //////////////////////////////////////////////
 void AnimationDocument::pack(Studio::PackerState &asset, ofstream &fout)
 {
+  auto tolerance = asset.document->metadata("tolerance", 0.0);
+
   asset.document->lock();
 
   PackAnimationHeader anim;
@@ -36,7 +181,15 @@ void AnimationDocument::pack(Studio::PackerState &asset, ofstream &fout)
 
     read_asset_payload(asset.document, anim.dataoffset, payload.data(), payload.size());
 
-    write_anim_asset(fout, asset.id, anim.duration, anim.jointcount, anim.transformcount, payload.data());
+    auto jointtable = PackAnimationPayload::jointtable(payload.data(), anim.jointcount, anim.transformcount);
+    auto transformtable = PackAnimationPayload::transformtable(payload.data(), anim.jointcount, anim.transformcount);
+
+    vector<PackAnimationPayload::Joint> joints(jointtable, jointtable + anim.jointcount);
+    vector<PackAnimationPayload::Transform> transforms;
+
+    compress_animation(joints, transformtable, anim.transformcount, tolerance, transforms);
+
+    write_anim_asset(fout, asset.id, anim.duration, joints, transforms);
   }
 
   asset.document->unlock();
@@ -172,6 +325,24 @@ vector<AnimationDocument::Joint> AnimationDocument::joints() const
 }
 
 
+///////////////////////// AnimationDocument::tolerance //////////////////////
+float AnimationDocument::tolerance() const
+{
+  return m_document->metadata("tolerance", 0.0);
+}
+
+
+///////////////////////// AnimationDocument::set_tolerance //////////////////
+void AnimationDocument::set_tolerance(float tolerance)
+{
+  m_document->lock_exclusive();
+
+  m_document->set_metadata("tolerance", tolerance);
+
+  m_document->unlock_exclusive();
+}
+
+
 ///////////////////////// AnimationDocument::attach /////////////////////////
 void AnimationDocument::attach(Studio::Document *document)
 {
@@ -60,6 +60,12 @@ class AnimationDocument : public QObject
 
     std::vector<Joint> joints() const;
 
+    float tolerance() const;
+
+  public:
+
+    void set_tolerance(float tolerance);
+
   signals:
 
     void document_changed();
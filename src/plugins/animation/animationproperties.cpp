@@ -10,6 +10,7 @@
 #include "contentapi.h"
 #include "assetfile.h"
 
+#include <QDoubleValidator>
 #include <QDebug>
 
 using namespace std;
@@ -24,6 +25,8 @@ AnimationProperties::AnimationProperties(QWidget *parent)
 {
   ui.setupUi(this);
 
+  ui.Tolerance->setValidator(new QDoubleValidator(0.0, 1.0, 6, this));
+
   ui.ImportSrc->set_browsetype(QcFileLineEdit::BrowseType::OpenFile);
 }
 
@@ -57,12 +60,24 @@ void AnimationProperties::refresh()
 
   ui.Joints->setText(QString::number(joints));
 
+  ui.Tolerance->setText(QString::number(m_document.tolerance()));
+
   ui.ImportSrc->setText(m_document->metadata("src").toString());
 
   m_document->unlock();
 }
 
 
+///////////////////////// AnimationProperties::Tolerance ////////////////////
+void AnimationProperties::on_Tolerance_editingFinished()
+{
+  if (ui.Tolerance->text().toFloat() != m_document.tolerance())
+  {
+    m_document.set_tolerance(ui.Tolerance->text().toFloat());
+  }
+}
+
+
 ///////////////////////// AnimationProperties::Reimport /////////////////////
 void AnimationProperties::on_Reimport_clicked()
 {
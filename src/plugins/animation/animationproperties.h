@@ -30,6 +30,8 @@ class AnimationProperties : public QDockWidget
 
     void refresh();
 
+    void on_Tolerance_editingFinished();
+
     void on_Reimport_clicked();
 
   private:
@@ -9,6 +9,7 @@
 #include "assimporter.h"
 #include "contentapi.h"
 #include "assetfile.h"
+#include "tangentspace.h"
 #include <leap.h>
 #include <leap/lml/matrixconstants.h>
 #include <assimp/Importer.hpp>
@@ -17,6 +18,7 @@
 #include <assimp/DefaultLogger.hpp>
 #include <QFileInfo>
 #include <QtPlugin>
+#include <algorithm>
 #include <cassert>
 
 #include <QDebug>
@@ -53,11 +55,6 @@ namespace
     vector<PackAnimationPayload::Transform> transforms;
   };
 
-  Vector3f vec(aiVector3D const &v)
-  {
-    return { v.x, v.y, v.z };
-  }
-
   Matrix4f mat(aiMatrix4x4 const &m)
   {
     return { { m.a1, m.a2, m.a3, m.a4 }, { m.b1, m.b2, m.b3, m.b4 }, { m.c1, m.c2, m.c3, m.c4 }, { m.d1, m.d2, m.d3, m.d4 } };
@@ -153,14 +150,6 @@ namespace
           mesh.vertices[k].normal[1] = scene->mMeshes[i]->mNormals[k].y;
           mesh.vertices[k].normal[2] = scene->mMeshes[i]->mNormals[k].z;
         }
-
-        if (scene->mMeshes[i]->HasTangentsAndBitangents())
-        {
-          mesh.vertices[k].tangent[0] = isnormal(scene->mMeshes[i]->mTangents[k].x) ? scene->mMeshes[i]->mTangents[k].x : 0;
-          mesh.vertices[k].tangent[1] = isnormal(scene->mMeshes[i]->mTangents[k].y) ? scene->mMeshes[i]->mTangents[k].y : 0;
-          mesh.vertices[k].tangent[2] = isnormal(scene->mMeshes[i]->mTangents[k].z) ? scene->mMeshes[i]->mTangents[k].z : 0;
-          mesh.vertices[k].tangent[3] = (dot(cross(vec(scene->mMeshes[i]->mNormals[k]), vec(scene->mMeshes[i]->mTangents[k])), vec(scene->mMeshes[i]->mBitangents[k])) < 0.0f) ? -1.0f : 1.0f;
-        }
       }
 
       mesh.indices.resize(scene->mMeshes[i]->mNumFaces * 3);
@@ -238,6 +227,48 @@ namespace
         }
       }
     }
+
+    //
+    // Tangents
+    //
+
+    for(auto &mesh : model.meshdata)
+    {
+      calculate_tangents(mesh.vertices, mesh.indices, mesh.rig);
+    }
+  }
+
+  aiVector3D sample(aiVectorKey const *keys, size_t count, double time)
+  {
+    auto j = upper_bound(keys, keys + count, time, [](double time, aiVectorKey const &key) { return time < key.mTime; }) - keys;
+
+    if (j == 0)
+      return keys[0].mValue;
+
+    if (j == (ptrdiff_t)count)
+      return keys[count-1].mValue;
+
+    auto alpha = (float)((time - keys[j-1].mTime) / (keys[j].mTime - keys[j-1].mTime));
+
+    return keys[j-1].mValue + alpha * (keys[j].mValue - keys[j-1].mValue);
+  }
+
+  aiQuaternion sample(aiQuatKey const *keys, size_t count, double time)
+  {
+    auto j = upper_bound(keys, keys + count, time, [](double time, aiQuatKey const &key) { return time < key.mTime; }) - keys;
+
+    if (j == 0)
+      return keys[0].mValue;
+
+    if (j == (ptrdiff_t)count)
+      return keys[count-1].mValue;
+
+    auto alpha = (float)((time - keys[j-1].mTime) / (keys[j].mTime - keys[j-1].mTime));
+
+    aiQuaternion result;
+    aiQuaternion::Interpolate(result, keys[j-1].mValue, keys[j].mValue, alpha);
+
+    return result.Normalize();
   }
 
   void build_heirarchy(Animation &anim, aiScene const *scene, aiNode const *node, int parent)
@@ -277,24 +308,46 @@ namespace
       if (joint == anim.joints.end())
         throw runtime_error("Animation joint not found in heirarchy");
 
-      if (animation->mChannels[i]->mNumScalingKeys < 2 || animation->mChannels[i]->mNumRotationKeys < 2 || animation->mChannels[i]->mNumPositionKeys < 2)
+      auto channel = animation->mChannels[i];
+
+      if (channel->mNumScalingKeys == 0 || channel->mNumRotationKeys == 0 || channel->mNumPositionKeys == 0)
         throw runtime_error("Insufficient Animation keyframes");
 
-      if (animation->mChannels[i]->mNumScalingKeys != animation->mChannels[i]->mNumRotationKeys || animation->mChannels[i]->mNumRotationKeys != animation->mChannels[i]->mNumPositionKeys)
-        throw runtime_error("Animation keyframes not baked");
+      // resample unbaked channels onto the union of their key times
+
+      vector<double> times;
+
+      for(size_t k = 0; k < channel->mNumScalingKeys; ++k)
+        times.push_back(channel->mScalingKeys[k].mTime);
+
+      for(size_t k = 0; k < channel->mNumRotationKeys; ++k)
+        times.push_back(channel->mRotationKeys[k].mTime);
+
+      for(size_t k = 0; k < channel->mNumPositionKeys; ++k)
+        times.push_back(channel->mPositionKeys[k].mTime);
+
+      sort(times.begin(), times.end());
+
+      times.erase(unique(times.begin(), times.end()), times.end());
+
+      if (times.size() < 2)
+        times.push_back(max(times.front(), animation->mDuration));
 
       joint->count = 0;
       joint->index = anim.transforms.size();
 
-      for(size_t k = 0; k < animation->mChannels[i]->mNumRotationKeys; ++k)
+      for(auto &time : times)
       {
         PackAnimationPayload::Transform transform;
 
-        transform.time = animation->mChannels[i]->mRotationKeys[k].mTime / animation->mTicksPerSecond;
+        transform.time = time / animation->mTicksPerSecond;
+
+        auto scale = sample(channel->mScalingKeys, channel->mNumScalingKeys, time);
+        auto position = sample(channel->mPositionKeys, channel->mNumPositionKeys, time);
+        auto rotation = sample(channel->mRotationKeys, channel->mNumRotationKeys, time);
 
-        auto t0 = Vec3(animation->mChannels[i]->mScalingKeys[k].mValue.x, animation->mChannels[i]->mScalingKeys[k].mValue.y, animation->mChannels[i]->mScalingKeys[k].mValue.z);
-        auto t1 = Transform::translation(t0.x*animation->mChannels[i]->mPositionKeys[k].mValue.x, t0.y*animation->mChannels[i]->mPositionKeys[k].mValue.y, t0.z*animation->mChannels[i]->mPositionKeys[k].mValue.z);
-        auto t2 = Transform::rotation({ animation->mChannels[i]->mRotationKeys[k].mValue.w, animation->mChannels[i]->mRotationKeys[k].mValue.x, animation->mChannels[i]->mRotationKeys[k].mValue.y, animation->mChannels[i]->mRotationKeys[k].mValue.z });
+        auto t1 = Transform::translation(scale.x*position.x, scale.y*position.y, scale.z*position.z);
+        auto t2 = Transform::rotation({ rotation.w, rotation.x, rotation.y, rotation.z });
         auto t3 = t1 * t2;
 
         memcpy(transform.transform, &t3, sizeof(transform.transform));
@@ -376,7 +429,6 @@ bool AssImporter::try_import(QString const &src, QString const &dst, QJsonObject
 
   unsigned int flags = 0;
 
-  flags |= aiProcess_CalcTangentSpace;
   flags |= aiProcess_Triangulate;
   flags |= aiProcess_JoinIdenticalVertices;
   flags |= aiProcess_TransformUVCoords;
@@ -13,6 +13,8 @@
 #include <QCloseEvent>
 #include <QScrollBar>
 #include <QPainter>
+#include <QLabel>
+#include <algorithm>
 
 #include <QDebug>
 
@@ -28,7 +30,18 @@ BinEditor::BinEditor(QWidget *parent)
 {
   m_readonly = true;
 
+  m_lines = 0;
+  m_windowpos = 0;
+
+  m_offsetedit = new QLineEdit(this);
+  m_offsetedit->setPlaceholderText("hex");
+  m_offsetedit->setMaximumWidth(100);
+
   m_toolbar = new CommandBar(this);
+  m_toolbar->addWidget(new QLabel("Offset:", this));
+  m_toolbar->addWidget(m_offsetedit);
+
+  connect(m_offsetedit, &QLineEdit::returnPressed, this, &BinEditor::on_offset_entered);
 
   setFont(QFont("Courier"));
 }
@@ -82,6 +95,8 @@ void BinEditor::refresh()
 
   m_chunks.clear();
 
+  m_window.clear();
+
   m_document->lock();
 
   uint64_t position = sizeof(PackHeader);
@@ -90,7 +105,8 @@ void BinEditor::refresh()
   {
     PackChunk chunk;
 
-    m_document->read(position, &chunk, sizeof(chunk));
+    if (m_document->read(position, &chunk, sizeof(chunk)) != sizeof(chunk))
+      break;
 
     if (chunk.type == "HEND"_packchunktype)
       break;
@@ -108,10 +124,28 @@ void BinEditor::refresh()
     position += chunk.length + sizeof(chunk) + sizeof(uint32_t);
   }
 
-  m_chunks.erase(m_chunks.begin());
+  if (!m_chunks.empty())
+    m_chunks.erase(m_chunks.begin());
 
   m_document->unlock();
 
+  m_lines = 0;
+
+  for(auto &chunk : m_chunks)
+  {
+    chunk.startline = m_lines;
+    chunk.linecount = 3 + chunk.datasize / BytesPerLine + 1;
+
+    m_lines += chunk.linecount;
+  }
+
+  relayout();
+}
+
+
+///////////////////////// BinEditor::relayout ///////////////////////////////
+void BinEditor::relayout()
+{
   QFontMetrics tm = fontMetrics();
 
   m_ascent = tm.ascent();
@@ -124,18 +158,9 @@ void BinEditor::refresh()
   horizontalScrollBar()->setRange(0, m_contentwidth - viewport()->width());
   horizontalScrollBar()->setPageStep(viewport()->width());
 
-  m_lines = 0;
   m_lineheight = tm.lineSpacing();
   m_linesperpage = viewport()->height() / m_lineheight;
 
-  for(auto &chunk : m_chunks)
-  {
-    chunk.startline = m_lines;
-    chunk.linecount = 3 + chunk.datasize / BytesPerLine + 1;
-
-    m_lines += chunk.linecount;
-  }
-
   verticalScrollBar()->setRange(0, m_lines - m_linesperpage);
   verticalScrollBar()->setPageStep(m_linesperpage);
 
@@ -143,16 +168,93 @@ void BinEditor::refresh()
 }
 
 
+///////////////////////// BinEditor::find_line //////////////////////////////
+vector<BinEditor::DataChunk>::const_iterator BinEditor::find_line(int line) const
+{
+  auto chunk = upper_bound(m_chunks.begin(), m_chunks.end(), line, [](int line, DataChunk const &chunk) { return line < chunk.startline; });
+
+  return (chunk != m_chunks.begin()) ? prev(chunk) : chunk;
+}
+
+
+///////////////////////// BinEditor::line_position //////////////////////////
+uint64_t BinEditor::line_position(DataChunk const &chunk, int line) const
+{
+  auto offset = uint64_t(max(line - chunk.startline - 3, 0)) * BytesPerLine;
+
+  return chunk.filepos + min(offset, uint64_t(chunk.datasize));
+}
+
+
+///////////////////////// BinEditor::prefetch ///////////////////////////////
+void BinEditor::prefetch(uint64_t begin, uint64_t end)
+{
+  if (m_windowpos <= begin && end <= m_windowpos + m_window.size())
+    return;
+
+  uint64_t margin = uint64_t(PrefetchPages) * max(m_linesperpage, 1) * BytesPerLine;
+
+  m_windowpos = begin - min(begin, margin);
+
+  m_window.resize(end + margin - m_windowpos);
+
+  m_document->lock();
+
+  m_window.resize(m_document->read(m_windowpos, m_window.data(), m_window.size()));
+
+  m_document->unlock();
+}
+
+
+///////////////////////// BinEditor::seek ///////////////////////////////////
+void BinEditor::seek(uint64_t position)
+{
+  if (m_chunks.empty())
+    return;
+
+  auto chunk = upper_bound(m_chunks.begin(), m_chunks.end(), position, [](uint64_t position, DataChunk const &chunk) { return position < chunk.filepos; });
+
+  if (chunk != m_chunks.begin())
+    --chunk;
+
+  int line = chunk->startline;
+
+  if (position >= chunk->filepos)
+  {
+    line += 3 + (min(position - chunk->filepos, uint64_t(chunk->datasize))) / BytesPerLine;
+  }
+
+  verticalScrollBar()->setValue(line);
+}
+
+
+///////////////////////// BinEditor::offset_entered /////////////////////////
+void BinEditor::on_offset_entered()
+{
+  bool ok = false;
+
+  auto position = m_offsetedit->text().remove(':').toULongLong(&ok, 16);
+
+  if (ok)
+  {
+    seek(position);
+  }
+}
+
+
 ///////////////////////// BinEditor::resizeEvent ////////////////////////////
 void BinEditor::resizeEvent(QResizeEvent *event)
 {
-  refresh();
+  relayout();
 }
 
 
 ///////////////////////// BinEditor::paintEvent /////////////////////////////
 void BinEditor::paintEvent(QPaintEvent *event)
 {
+  if (m_chunks.empty())
+    return;
+
   QPainter painter(viewport());
 
   int line = verticalScrollBar()->value();
@@ -161,17 +263,24 @@ void BinEditor::paintEvent(QPaintEvent *event)
   int x = -column;
   int y = -4;
 
+  int lastline = line + (event->rect().bottom() - y) / m_lineheight + 1;
+
+  auto first = find_line(line);
+  auto last = find_line(lastline);
+
+  prefetch(line_position(*first, line), line_position(*last, lastline) + BytesPerLine);
+
   painter.setPen(palette().text().color());
 
-  for(auto &chunk : m_chunks)
+  for(auto chunk = first; chunk != m_chunks.end() && chunk->startline <= lastline; ++chunk)
   {
-    if (chunk.startline <= line && line < chunk.startline + chunk.linecount)
+    if (chunk->startline <= line && line < chunk->startline + chunk->linecount)
     {
-      int cy = y + (chunk.startline - line) * m_lineheight;
+      int cy = y + (chunk->startline - line) * m_lineheight;
 
       cy += m_lineheight;
 
-      painter.drawText(x + m_charwidth, cy + m_ascent, QString("Data Block : %1 bytes").arg(chunk.datasize));
+      painter.drawText(x + m_charwidth, cy + m_ascent, QString("Data Block : %1 bytes").arg(chunk->datasize));
 
       cy += m_lineheight;
 
@@ -179,42 +288,33 @@ void BinEditor::paintEvent(QPaintEvent *event)
 
       cy += m_lineheight;
 
-      painter.drawLine(x + 10 * m_charwidth + m_charmargin, cy, x + 10 * m_charwidth + m_charmargin, cy + (chunk.linecount - 3) * m_lineheight);
+      painter.drawLine(x + 10 * m_charwidth + m_charmargin, cy, x + 10 * m_charwidth + m_charmargin, cy + (chunk->linecount - 3) * m_lineheight);
 
       for(size_t i = 2; i < 2*BytesPerLine; i += 4)
       {
-        QRect rect(x + 11 * m_charwidth + i * (m_charwidth + m_charmargin), cy, 2*(m_charwidth + m_charmargin), (chunk.linecount - 3) * m_lineheight);
+        QRect rect(x + 11 * m_charwidth + i * (m_charwidth + m_charmargin), cy, 2*(m_charwidth + m_charmargin), (chunk->linecount - 3) * m_lineheight);
 
         painter.fillRect(event->rect() & rect, palette().alternateBase());
       }
     }
 
-    m_document->lock();
-
-    uint64_t bufferpos = -1;
-    uint8_t buffer[4096];
-
-    while (chunk.startline <= line && line < chunk.startline + chunk.linecount && y - m_lineheight < event->rect().bottom())
+    while (chunk->startline <= line && line < chunk->startline + chunk->linecount && y - m_lineheight < event->rect().bottom())
     {
-      if (line >= chunk.startline + 3)
+      if (line >= chunk->startline + 3)
       {
-        uint64_t filepos = chunk.filepos + (line - chunk.startline - 3) * BytesPerLine;
+        uint64_t filepos = chunk->filepos + uint64_t(line - chunk->startline - 3) * BytesPerLine;
 
         QString addressstr = QString("%1:%2").arg(filepos >> 16, 4, 16, QLatin1Char('0')).arg(filepos & 0xFFFF, 4, 16, QLatin1Char('0'));
 
         painter.drawText(x + m_charwidth, y + m_ascent, addressstr);
 
-        if (filepos < bufferpos || filepos + BytesPerLine >= bufferpos + sizeof(buffer))
-        {
-          bufferpos = filepos;
-
-          m_document->read(filepos, buffer, sizeof(buffer));
-        }
-
         QString ascii = "";
-        for(size_t i = 0; i < min(size_t(BytesPerLine), chunk.filepos + chunk.datasize - filepos); ++i)
+        for(size_t i = 0; i < min(uint64_t(BytesPerLine), chunk->filepos + chunk->datasize - filepos); ++i)
         {
-          auto data = buffer[filepos + i - bufferpos];
+          if (filepos + i < m_windowpos || filepos + i >= m_windowpos + m_window.size())
+            break;
+
+          auto data = m_window[filepos + i - m_windowpos];
 
           QString bytestr = QString("%1").arg(data, 2, 16, QLatin1Char('0'));
 
@@ -230,8 +330,5 @@ void BinEditor::paintEvent(QPaintEvent *event)
 
       line += 1;
     }
-
-    m_document->unlock();
   }
 }
-
@@ -11,6 +11,8 @@
 #include "documentapi.h"
 #include <QAbstractScrollArea>
 #include <QToolBar>
+#include <QLineEdit>
+#include <vector>
 
 //-------------------------- BinEditor --------------------------------------
 //---------------------------------------------------------------------------
@@ -32,9 +34,14 @@ class BinEditor : public QAbstractScrollArea
     void view(Studio::Document *document);
     void edit(Studio::Document *document);
 
+    void seek(uint64_t position);
+
   protected:
 
     void refresh();
+    void relayout();
+
+    void on_offset_entered();
 
     void resizeEvent(QResizeEvent *event);
 
@@ -46,6 +53,8 @@ class BinEditor : public QAbstractScrollArea
 
     QToolBar *m_toolbar;
 
+    QLineEdit *m_offsetedit;
+
     struct DataChunk
     {
       uint64_t filepos;
@@ -55,8 +64,25 @@ class BinEditor : public QAbstractScrollArea
       int linecount;
     };
 
+    // ordered by both line and file position, built once per document
+    // change so painting and seeking are a binary search
+
     std::vector<DataChunk> m_chunks;
 
+    std::vector<DataChunk>::const_iterator find_line(int line) const;
+
+    uint64_t line_position(DataChunk const &chunk, int line) const;
+
+    // visible bytes are read in one go with a few pages either side so
+    // scrolling rarely touches the document
+
+    static constexpr int PrefetchPages = 4;
+
+    void prefetch(uint64_t begin, uint64_t end);
+
+    uint64_t m_windowpos;
+    std::vector<uint8_t> m_window;
+
     int m_ascent;
     int m_descent;
     int m_charwidth;
@@ -45,12 +45,38 @@ namespace Studio
 
       virtual void request_build(Document *document, QObject *receiver, std::function<void (Document *, QString const &)> const &notify, std::function<void (Document *)> const &failure = nullptr) = 0;
 
+      // as request_build, but notify is first called with a fast reduced
+      // quality build (for builders that provide one) and again once the
+      // final build is ready
+
+      template<typename Object>
+      void request_preview(Document *document, Object *receiver, void (Object::*notify)(Document *, QString const &))
+      {
+        request_preview(document, receiver, [=](Document *document, QString const &path) { (receiver->*notify)(document, path); });
+      }
+
+      template<typename Object>
+      void request_preview(Document *document, Object *receiver, void (Object::*notify)(Document *, QString const &), void (Object::*failure)(Document *))
+      {
+        request_preview(document, receiver, [=](Document *document, QString const &path) { (receiver->*notify)(document, path); }, [=](Document *document) { (receiver->*failure)(document); });
+      }
+
+      virtual void request_preview(Document *document, QObject *receiver, std::function<void (Document *, QString const &)> const &notify, std::function<void (Document *)> const &failure = nullptr) = 0;
+
       virtual void register_builder(QString const &type, QObject *builder) = 0;
 
     public:
 
       virtual bool build(Studio::Document *document, QString *path) = 0;
 
+      // preview builds are produced by a builder's optional preview slot,
+      // images no larger than PreviewSize. false if the builder has no
+      // preview or the final build is already available
+
+      enum { PreviewSize = 256 };
+
+      virtual bool build_preview(Studio::Document *document, QString *path) = 0;
+
     signals:
 
       void builder_added(QString const &type);
@@ -8,6 +8,8 @@
 
 #include "buildmanager.h"
 #include "projectapi.h"
+#include "trace.h"
+#include "workqueue.h"
 #include <leap.h>
 #include <fstream>
 
@@ -27,8 +29,6 @@ Builder::Builder(BuildManager *manager, Studio::Document *document)
   auto documentmanager = Studio::Core::instance()->find_object<Studio::DocumentManager>();
 
   m_document = documentmanager->dup(document);
-
-  setAutoDelete(true);
 }
 
 
@@ -48,6 +48,18 @@ void Builder::run()
 }
 
 
+///////////////////////// Builder::run_preview //////////////////////////////
+void Builder::run_preview()
+{
+  QString path;
+
+  if (m_manager->build_preview(m_document, &path))
+  {
+    emit build_complete(m_document, path);
+  }
+}
+
+
 
 //|---------------------- BuildManager --------------------------------------
 //|--------------------------------------------------------------------------
@@ -55,6 +67,8 @@ void Builder::run()
 ///////////////////////// BuildManager::Constructor /////////////////////////
 BuildManager::BuildManager()
 {
+  m_loading = false;
+
   auto projectmanager = Studio::Core::instance()->find_object<Studio::ProjectManager>();
 
   connect(projectmanager, &Studio::ProjectManager::project_changed, this, &BuildManager::on_project_changed);
@@ -63,6 +77,15 @@ BuildManager::BuildManager()
   auto documentmanager = Studio::Core::instance()->find_object<Studio::DocumentManager>();
 
   connect(documentmanager, &Studio::DocumentManager::document_renamed, this, &BuildManager::on_document_renamed);
+  connect(documentmanager, &Studio::DocumentManager::documents_changed, this, [=](QVector<Studio::DocumentManager::Change> const &changes) { for(auto &change : changes) { if (change.dst != "" && change.dst != change.src) on_document_renamed(change.document, change.src, change.dst); } });
+}
+
+
+///////////////////////// BuildManager::Destructor //////////////////////////
+BuildManager::~BuildManager()
+{
+  if (m_loader.joinable())
+    m_loader.join();
 }
 
 
@@ -78,60 +101,120 @@ QString BuildManager::basepath() const
 ///////////////////////// BuildManager::on_project_changed //////////////////
 void BuildManager::on_project_changed(QString const &projectfile)
 {
+  if (m_loader.joinable())
+    m_loader.join();
+
   SyncLock lock(m_mutex);
 
   m_path = QFileInfo(projectfile).dir();
 
   m_path.mkdir("Build");
+  m_path.mkdir("Build/Preview");
 
   m_builds.clear();
+  m_renames.clear();
 
-  ifstream fin(m_path.filePath("Build/buildstate.dat").toUtf8());
+  auto loaded = make_shared<promise<void>>();
 
-  string buffer;
+  m_loaded = loaded->get_future().share();
+  m_loading = true;
 
-  while (getline(fin, buffer))
-  {
-    auto line = trim(buffer);
+  m_loader = thread([this, path = m_path, loaded]() {
 
-    if (line == "[Builds]")
-      break;
-  }
+    QMultiHash<QString, Build> builds;
 
-  while (getline(fin, buffer))
-  {
-    auto line = trim(buffer);
+    try
+    {
+      ifstream fin(path.filePath("Build/buildstate.dat").toUtf8());
+
+      string buffer;
+
+      while (getline(fin, buffer))
+      {
+        auto line = trim(buffer);
+
+        if (line == "[Builds]")
+          break;
+      }
+
+      while (getline(fin, buffer))
+      {
+        auto line = trim(buffer);
+
+        if (line.empty())
+          break;
+
+        if (line[0] == '#' || line[0] == '/')
+          continue;
+
+        auto i = line.find_first_of(' ');
+        auto j = line.find_first_of(' ', i+1);
 
-    if (line.empty())
-      break;
+        QUuid id = line.substr(0, i).to_string().c_str();
+        size_t hash = stoull(line.substr(i+1, j).to_string());
+        QString file = path.filePath(line.substr(j+1).to_string().c_str());
 
-    if (line[0] == '#' || line[0] == '/')
-      continue;
+        builds.insert(file, { id, hash });
+      }
+    }
+    catch(exception &e)
+    {
+      qCritical() << "Build State Error:" << e.what();
+    }
+
+    {
+      SyncLock lock(m_mutex);
 
-    auto i = line.find_first_of(' ');
-    auto j = line.find_first_of(' ', i+1);
+      for(auto &rename : m_renames)
+      {
+        for(auto &build : builds.values(rename.first))
+        {
+          builds.insert(rename.second, build);
+        }
+
+        builds.remove(rename.first);
+      }
+
+      m_builds = std::move(builds);
+      m_renames.clear();
+      m_loading = false;
+    }
+
+    loaded->set_value();
+  });
+}
 
-    QUuid id = line.substr(0, i).to_string().c_str();
-    size_t hash = stoull(line.substr(i+1, j).to_string());
-    QString file = m_path.filePath(line.substr(j+1).to_string().c_str());
 
-    m_builds.push_back({ id, file, hash });
+///////////////////////// BuildManager::wait_loaded /////////////////////////
+void BuildManager::wait_loaded() const
+{
+  shared_future<void> loaded;
+
+  {
+    SyncLock lock(m_mutex);
+
+    loaded = m_loaded;
   }
+
+  if (loaded.valid())
+    loaded.wait();
 }
 
 
 ///////////////////////// BuildManager::on_project_closing //////////////////
 void BuildManager::on_project_closing(bool *cancel)
 {
+  wait_loaded();
+
   SyncLock lock(m_mutex);
 
   ofstream fout(m_path.filePath("Build/buildstate.dat").toUtf8());
 
   fout << "[Builds]" << '\n';
 
-  for(auto &build : m_builds)
+  for(auto build = m_builds.begin(); build != m_builds.end(); ++build)
   {
-    fout << build.id.toString().toStdString() << " " << build.hash << " " << m_path.relativeFilePath(build.file).toStdString() << '\n';
+    fout << build->id.toString().toStdString() << " " << build->hash << " " << m_path.relativeFilePath(build.key()).toStdString() << '\n';
   }
 
   fout << '\n';
@@ -143,21 +226,25 @@ void BuildManager::on_document_renamed(Studio::Document *document, QString const
 {
   SyncLock lock(m_mutex);
 
-  for(auto &build : m_builds)
+  if (m_loading)
   {
-    if (build.file == src)
-    {
-      build.file = dst;
-    }
+    m_renames.emplace_back(src, dst);
+
+    return;
+  }
+
+  for(auto &build : m_builds.values(src))
+  {
+    m_builds.insert(dst, build);
   }
+
+  m_builds.remove(src);
 }
 
 
-///////////////////////// BuildManager::request_build ///////////////////////
-void BuildManager::request_build(Studio::Document *document, QObject *receiver, std::function<void (Studio::Document *, QString const &)> const &notify, std::function<void (Studio::Document *)> const &failure)
+///////////////////////// BuildManager::create_builder //////////////////////
+Builder *BuildManager::create_builder(Studio::Document *document, QObject *receiver, std::function<void (Studio::Document *, QString const &)> const &notify, std::function<void (Studio::Document *)> const &failure)
 {
-  SyncLock lock(m_mutex);
-
   auto builder = new Builder(this, document);
 
   connect(builder, &Builder::build_complete, receiver, notify, Qt::QueuedConnection);
@@ -167,7 +254,38 @@ void BuildManager::request_build(Studio::Document *document, QObject *receiver,
     connect(builder, &Builder::build_failure, receiver, failure, Qt::QueuedConnection);
   }
 
-  QThreadPool::globalInstance()->start(builder);
+  return builder;
+}
+
+
+///////////////////////// BuildManager::request_build ///////////////////////
+void BuildManager::request_build(Studio::Document *document, QObject *receiver, std::function<void (Studio::Document *, QString const &)> const &notify, std::function<void (Studio::Document *)> const &failure)
+{
+  SyncLock lock(m_mutex);
+
+  auto builder = create_builder(document, receiver, notify, failure);
+
+  Studio::WorkQueue::instance()->push([=]() { builder->run(); delete builder; }, Studio::WorkQueue::Priority::Background);
+}
+
+
+///////////////////////// BuildManager::request_preview /////////////////////
+void BuildManager::request_preview(Studio::Document *document, QObject *receiver, std::function<void (Studio::Document *, QString const &)> const &notify, std::function<void (Studio::Document *)> const &failure)
+{
+  SyncLock lock(m_mutex);
+
+  auto builder = create_builder(document, receiver, notify, failure);
+
+  // the final build is queued behind the preview, so the receiver always
+  // sees the preview first and is then upgraded
+
+  Studio::WorkQueue::instance()->push([=]() {
+
+    builder->run_preview();
+
+    Studio::WorkQueue::instance()->push([=]() { builder->run(); delete builder; }, Studio::WorkQueue::Priority::Background);
+
+  }, Studio::WorkQueue::Priority::Interactive);
 }
 
 
@@ -180,52 +298,83 @@ void BuildManager::register_builder(QString const &type, QObject *builder)
 }
 
 
-///////////////////////// BuildManager::find_build //////////////////////////
-QUuid BuildManager::find_build(QString const &file, size_t hash) const
+///////////////////////// BuildManager::find_or_create_build ////////////////
+QUuid BuildManager::find_or_create_build(QString const &file, size_t hash)
 {
+  wait_loaded();
+
   SyncLock lock(m_mutex);
 
-  for(auto &build : m_builds)
+  for(auto build = m_builds.find(file); build != m_builds.end() && build.key() == file; ++build)
   {
-    if (build.file == file && build.hash == hash)
+    if (build->hash == hash)
     {
-      return build.id;
+      return build->id;
     }
   }
 
-  return QUuid();
+  auto id = QUuid::createUuid();
+
+  m_builds.insert(file, { id, hash });
+
+  return id;
 }
 
 
 ///////////////////////// BuildManager::build ///////////////////////////////
 bool BuildManager::build(Studio::Document *document, QString *path)
 {
+  return build(document, path, false);
+}
+
+
+///////////////////////// BuildManager::build_preview ///////////////////////
+bool BuildManager::build_preview(Studio::Document *document, QString *path)
+{
+  return build(document, path, true);
+}
+
+
+///////////////////////// BuildManager::build ///////////////////////////////
+bool BuildManager::build(Studio::Document *document, QString *path, bool preview)
+{
+  QObject *builder = m_builders.value(document->metadata("type").toString());
+
+  if (preview && builder && builder->metaObject()->indexOfMethod("preview(Studio::Document*,QString)") < 0)
+    return false;
+
+  auto pending = make_pair(document, preview);
+
   while(true)
   {
     {
       SyncLock lock(m_mutex);
 
-      if (find(m_pending.begin(), m_pending.end(), document) == m_pending.end())
+      if (find(m_pending.begin(), m_pending.end(), pending) == m_pending.end())
       {
-        m_pending.push_back(document);
+        m_pending.push_back(pending);
 
         break;
       }
     }
 
-    QThread::msleep(250);
+    QThread::msleep(preview ? 10 : 250);
   }
 
   bool result = false;
 
-  QObject *builder = m_builders[document->metadata("type").toString()];
-
   if (builder)
   {
+    QString file = Studio::Core::instance()->find_object<Studio::DocumentManager>()->path(document);
+
+    Studio::TraceScope trace("build", file);
+
     size_t hash = 0;
 
     try
     {
+      Studio::TraceScope trace("hash");
+
       QMetaObject::invokeMethod(builder, "hash", Qt::DirectConnection, Q_ARG(Studio::Document*, document), Q_ARG(size_t*, &hash));
     }
     catch(exception &e)
@@ -235,55 +384,84 @@ bool BuildManager::build(Studio::Document *document, QString *path)
 
     document->lock();
 
-    QString file = Studio::Core::instance()->find_object<Studio::DocumentManager>()->path(document);
+    auto id = find_or_create_build(file, hash);
 
-    auto id = find_build(file, hash);
+    document->unlock();
+
+    auto finalpath = basepath() + "/" + id.toString().mid(1, 36);
+    auto previewpath = basepath() + "/Preview/" + id.toString().mid(1, 36);
 
-    if (id.isNull())
+    if (preview)
     {
-      SyncLock lock(m_mutex);
+      // a finished final build supersedes any preview
 
-      id = QUuid::createUuid();
+      if (!QFile::exists(finalpath))
+      {
+        *path = previewpath;
 
-      m_builds.push_back({ id, file, hash });
-    }
+        result = QFile::exists(*path);
 
-    document->unlock();
+        if (!result)
+        {
+          try
+          {
+            Studio::TraceScope trace("preview");
 
-    *path = basepath() + "/" + id.toString().mid(1, 36);
+            QMetaObject::invokeMethod(builder, "preview", Qt::DirectConnection, Q_RETURN_ARG(bool, result), Q_ARG(Studio::Document*, document), Q_ARG(QString, *path + ".tmp"));
 
-    if (QFile::exists(*path))
-    {
-      result = true;
-    }
+            QFile::rename(*path + ".tmp", *path);
+          }
+          catch(exception &e)
+          {
+            qDebug() << "Preview Error:" << e.what();
 
-    if (!result)
+            QFile::remove(*path + ".tmp");
+          }
+        }
+      }
+    }
+    else
     {
-      qInfo() << "Building" << file;
+      *path = finalpath;
 
-      emit build_started(document);
-
-      try
+      if (QFile::exists(*path))
       {
-        QMetaObject::invokeMethod(builder, "build", Qt::DirectConnection, Q_RETURN_ARG(bool, result), Q_ARG(Studio::Document*, document), Q_ARG(QString, *path + ".tmp"));
-
-        QFile::rename(*path + ".tmp", *path);
+        result = true;
       }
-      catch(exception &e)
+
+      if (!result)
       {
-        qCritical() << "Build Error:" << e.what();
+        qInfo() << "Building" << file;
+
+        emit build_started(document);
+
+        try
+        {
+          QMetaObject::invokeMethod(builder, "build", Qt::DirectConnection, Q_RETURN_ARG(bool, result), Q_ARG(Studio::Document*, document), Q_ARG(QString, *path + ".tmp"));
+
+          QFile::rename(*path + ".tmp", *path);
+        }
+        catch(exception &e)
+        {
+          qCritical() << "Build Error:" << e.what();
 
-        QFile::remove(*path + ".tmp");
+          QFile::remove(*path + ".tmp");
+        }
+
+        emit build_completed(document);
       }
 
-      emit build_completed(document);
+      if (result)
+      {
+        QFile::remove(previewpath);
+      }
     }
   }
 
   {
     SyncLock lock(m_mutex);
 
-    m_pending.erase(find(m_pending.begin(), m_pending.end(), document));
+    m_pending.erase(find(m_pending.begin(), m_pending.end(), pending));
   }
 
   return result;
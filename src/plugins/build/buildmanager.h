@@ -13,14 +13,16 @@
 #include <leap/threadcontrol.h>
 #include <QDir>
 #include <QUuid>
-#include <QThreadPool>
+#include <QMultiHash>
+#include <future>
+#include <thread>
 
 class BuildManager;
 
 //-------------------------- Builder ----------------------------------------
 //---------------------------------------------------------------------------
 
-class Builder : public QObject, public QRunnable
+class Builder : public QObject
 {
   Q_OBJECT
 
@@ -29,6 +31,8 @@ class Builder : public QObject, public QRunnable
 
     void run();
 
+    void run_preview();
+
   signals:
 
     void build_failure(Studio::Document *document);
@@ -52,17 +56,22 @@ class BuildManager : public Studio::BuildManager
 
   public:
     BuildManager();
+    ~BuildManager();
 
     QString basepath() const;
 
     void request_build(Studio::Document *document, QObject *receiver, std::function<void (Studio::Document *, QString const &)> const &notify, std::function<void (Studio::Document *)> const &failure = nullptr);
 
+    void request_preview(Studio::Document *document, QObject *receiver, std::function<void (Studio::Document *, QString const &)> const &notify, std::function<void (Studio::Document *)> const &failure = nullptr);
+
     void register_builder(QString const &type, QObject *builder);
 
   public:
 
     bool build(Studio::Document *document, QString *path);
 
+    bool build_preview(Studio::Document *document, QString *path);
+
   protected:
 
     void on_project_changed(QString const &projectfile);
@@ -78,15 +87,40 @@ class BuildManager : public Studio::BuildManager
     struct Build
     {
       QUuid id;
-      QString file;
       size_t hash;
     };
 
-    std::vector<Build> m_builds;
+    // keyed by source file
+
+    QMultiHash<QString, Build> m_builds;
+
+    // final and preview builds of a document can race to record the same
+    // (file, hash), lookup and insert are one step so both share an id
+
+    QUuid find_or_create_build(QString const &file, size_t key);
+
+    Builder *create_builder(Studio::Document *document, QObject *receiver, std::function<void (Studio::Document *, QString const &)> const &notify, std::function<void (Studio::Document *)> const &failure);
+
+    bool build(Studio::Document *document, QString *path, bool preview);
+
+    // build state is read on a thread of its own at project open, so a
+    // pool thread waiting on it cannot starve the load. anything touching
+    // the builds waits for it first, except renames which are held and
+    // replayed over the loaded state
+
+    void wait_loaded() const;
+
+    std::thread m_loader;
+
+    std::shared_future<void> m_loaded;
+
+    bool m_loading;
+
+    std::vector<std::pair<QString, QString>> m_renames;
 
-    QUuid find_build(QString const &file, size_t key) const;
+    // final and preview builds of a document run independently
 
-    std::vector<Studio::Document*> m_pending;
+    std::vector<std::pair<Studio::Document*, bool>> m_pending;
 
     QMap<QString, QObject*> m_builders;
 
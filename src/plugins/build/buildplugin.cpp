@@ -37,6 +37,9 @@ bool BuildPlugin::initialise(QStringList const &arguments, QString *errormsg)
 {
   Studio::Core::instance()->add_object(new BuildManager);
 
+  if (arguments.contains("--headless"))
+    return true;
+
   auto actionmanager = Studio::Core::instance()->find_object<Studio::ActionManager>();
 
   auto report = new QWidgetAction(this);
@@ -7,8 +7,11 @@
 //
 
 #include "consoleplugin.h"
+#include "trace.h"
 #include <iostream>
 #include <QLabel>
+#include <QVBoxLayout>
+#include <QFileInfo>
 #include <QtPlugin>
 
 #include <QDebug>
@@ -74,6 +77,35 @@ bool ConsolePlugin::initialise(QStringList const &arguments, QString *errormsg)
 
   statusmanager->container()->addWidget(m_container);
 
+  m_timingview = new QAction("Build Timings", this);
+  m_timingview->setToolTip("Build Timings\nalt-8");
+  m_timingview->setShortcut(QKeySequence(Qt::ALT + Qt::Key_8));
+
+  auto timingview = actionmanager->register_action("Console.Timings", m_timingview);
+
+  statusmanager->add_statusview(8, timingview);
+
+  m_timings = new QWidget;
+
+  auto header = new CommandBar;
+  header->setSizePolicy(QSizePolicy::MinimumExpanding, QSizePolicy::Fixed);
+  header->addWidget(new QLabel("Build Timings"));
+  header->addSeparator();
+
+  m_summary = new QTreeWidget;
+  m_summary->setRootIsDecorated(false);
+  m_summary->setSortingEnabled(true);
+
+  auto layout = new QVBoxLayout(m_timings);
+  layout->setContentsMargins(0, 0, 0, 0);
+  layout->setSpacing(0);
+  layout->addWidget(header);
+  layout->addWidget(m_summary);
+
+  statusmanager->container()->addWidget(m_timings);
+
+  connect(Studio::Trace::instance(), &Studio::Trace::capture_complete, this, &ConsolePlugin::trace_summary);
+
   instance = this;
   qInstallMessageHandler(message_handler);
 
@@ -97,6 +129,13 @@ void ConsolePlugin::on_statusview_changed(QString const &view)
 
     statusmanager->container()->setCurrentWidget(m_container);
   }
+
+  if (view == "Build Timings")
+  {
+    auto statusmanager = Studio::Core::instance()->find_object<Studio::StatusManager>();
+
+    statusmanager->container()->setCurrentWidget(m_timings);
+  }
 }
 
 
@@ -117,3 +156,61 @@ void ConsolePlugin::log_message(QtMsgType type, QString const &message)
       break;
   }
 }
+
+
+///////////////////////// ConsolePlugin::trace_summary //////////////////////
+void ConsolePlugin::trace_summary()
+{
+  struct Summary
+  {
+    qint64 start;
+    qint64 finish;
+    QMap<QString, qint64> stages;
+  };
+
+  QStringList stages;
+  QMap<QString, Summary> assets;
+
+  for(auto &span : Studio::Trace::instance()->spans())
+  {
+    if (span.asset == "")
+      continue;
+
+    if (!stages.contains(span.name))
+      stages.push_back(span.name);
+
+    auto j = assets.find(span.asset);
+
+    if (j == assets.end())
+      j = assets.insert(span.asset, { span.start, span.start + span.duration, {} });
+
+    j->start = min(j->start, span.start);
+    j->finish = max(j->finish, span.start + span.duration);
+    j->stages[span.name] += span.duration;
+  }
+
+  m_summary->clear();
+  m_summary->setColumnCount(stages.size() + 2);
+  m_summary->setHeaderLabels(QStringList({ "Asset", "Total (ms)" }) + stages);
+
+  for(auto j = assets.begin(); j != assets.end(); ++j)
+  {
+    auto item = new QTreeWidgetItem(m_summary);
+
+    item->setText(0, QFileInfo(j.key()).completeBaseName());
+    item->setToolTip(0, j.key());
+    item->setData(1, Qt::DisplayRole, (j->finish - j->start) / 1000.0);
+
+    for(int i = 0; i < stages.size(); ++i)
+    {
+      item->setData(i + 2, Qt::DisplayRole, j->stages.value(stages[i], 0) / 1000.0);
+    }
+  }
+
+  m_summary->sortByColumn(1, Qt::DescendingOrder);
+
+  for(int i = 0; i < m_summary->columnCount(); ++i)
+  {
+    m_summary->resizeColumnToContents(i);
+  }
+}
@@ -10,6 +10,7 @@
 
 #include "api.h"
 #include "ui_consoleplugin.h"
+#include <QTreeWidget>
 
 //-------------------------- ConsolePlugin ----------------------------------
 //---------------------------------------------------------------------------
@@ -32,6 +33,8 @@ class ConsolePlugin : public Studio::Plugin
 
     void log_message(QtMsgType type, QString const &message);
 
+    void trace_summary();
+
   protected:
 
     void on_statusview_changed(QString const &view);
@@ -43,4 +46,10 @@ class ConsolePlugin : public Studio::Plugin
     QWidget *m_container;
 
     Ui::ConsolePlugin ui;
+
+    QAction *m_timingview;
+
+    QWidget *m_timings;
+
+    QTreeWidget *m_summary;
 };
@@ -0,0 +1,582 @@
+//
+// Asset Index
+//
+
+//
+// Copyright (C) 2016 Peter Niekamp
+//
+
+#include "assetindex.h"
+#include "projectapi.h"
+#include "assetfile.h"
+#include "workqueue.h"
+#include <QFileInfo>
+#include <QDateTime>
+#include <QDirIterator>
+#include <QDataStream>
+#include <QSaveFile>
+#include <QJsonArray>
+
+#include <QtDebug>
+
+using namespace std;
+
+namespace
+{
+  const quint32 IndexMagic = 0x58444941; // AIDX
+  const quint32 IndexVersion = 1;
+
+  void collect_paths(QJsonValue const &value, QString const &base, QStringList &paths)
+  {
+    if (value.isString() && value.toString().endsWith(".asset"))
+    {
+      paths.push_back(QDir::cleanPath(QDir(base).absoluteFilePath(value.toString())));
+    }
+
+    if (value.isArray())
+    {
+      for(auto element : value.toArray())
+        collect_paths(element, base, paths);
+    }
+
+    if (value.isObject())
+    {
+      for(auto element : value.toObject())
+        collect_paths(element, base, paths);
+    }
+  }
+}
+
+
+//|---------------------- AssetIndex ----------------------------------------
+//|--------------------------------------------------------------------------
+//| Asset Index
+//|
+
+///////////////////////// AssetIndex::Constructor ///////////////////////////
+AssetIndex::AssetIndex()
+{
+  m_shared = make_shared<Shared>();
+  m_shared->index = this;
+
+  auto projectmanager = Studio::Core::instance()->find_object<Studio::ProjectManager>();
+
+  connect(projectmanager, &Studio::ProjectManager::project_changed, this, &AssetIndex::on_project_changed);
+  connect(projectmanager, &Studio::ProjectManager::project_closing, this, &AssetIndex::on_project_closing);
+  connect(projectmanager, &Studio::ProjectManager::project_closed, this, &AssetIndex::on_project_closed);
+
+  auto contentmanager = Studio::Core::instance()->find_object<Studio::ContentManager>();
+
+  connect(contentmanager, &Studio::ContentManager::content_changed, this, &AssetIndex::on_content_changed);
+
+  connect(&m_watcher, &QFileSystemWatcher::directoryChanged, this, &AssetIndex::on_directory_changed);
+
+  connect(this, &AssetIndex::scanned, this, &AssetIndex::on_scanned, Qt::QueuedConnection);
+}
+
+
+///////////////////////// AssetIndex::Destructor ////////////////////////////
+AssetIndex::~AssetIndex()
+{
+  lock_guard<mutex> lock(m_shared->mutex);
+
+  m_shared->index = nullptr;
+}
+
+
+///////////////////////// AssetIndex::find //////////////////////////////////
+bool AssetIndex::find(QString const &path, Asset *asset) const
+{
+  lock_guard<mutex> lock(m_mutex);
+
+  auto entry = m_assets.find(path);
+
+  if (entry == m_assets.end())
+    return false;
+
+  *asset = *entry;
+
+  return true;
+}
+
+
+///////////////////////// AssetIndex::search ////////////////////////////////
+QStringList AssetIndex::search(QString const &text, QString const &type) const
+{
+  QStringList results;
+
+  lock_guard<mutex> lock(m_mutex);
+
+  for(auto &entry : m_assets)
+  {
+    if (type != "" && entry.type != type)
+      continue;
+
+    if (QFileInfo(entry.path).completeBaseName().contains(text, Qt::CaseInsensitive))
+      results.push_back(entry.path);
+  }
+
+  results.sort();
+
+  return results;
+}
+
+
+///////////////////////// AssetIndex::dependencies //////////////////////////
+QStringList AssetIndex::dependencies(QString const &path) const
+{
+  lock_guard<mutex> lock(m_mutex);
+
+  return m_assets.value(path).dependencies;
+}
+
+
+///////////////////////// AssetIndex::dependants ////////////////////////////
+QStringList AssetIndex::dependants(QString const &path, bool recursive) const
+{
+  QStringList results;
+
+  lock_guard<mutex> lock(m_mutex);
+
+  QSet<QString> visited = { path };
+
+  QStringList pending = { path };
+
+  while (!pending.isEmpty())
+  {
+    for(auto &dependant : m_dependants.values(pending.takeLast()))
+    {
+      if (visited.contains(dependant))
+        continue;
+
+      visited.insert(dependant);
+
+      results.push_back(dependant);
+
+      if (recursive)
+        pending.push_back(dependant);
+    }
+  }
+
+  return results;
+}
+
+
+///////////////////////// AssetIndex::project_changed ///////////////////////
+void AssetIndex::on_project_changed(QString const &projectfile)
+{
+  auto projectmanager = Studio::Core::instance()->find_object<Studio::ProjectManager>();
+  auto contentmanager = Studio::Core::instance()->find_object<Studio::ContentManager>();
+
+  on_project_closed();
+
+  {
+    lock_guard<mutex> lock(m_mutex);
+
+    m_basepath = contentmanager->basepath();
+  }
+
+  load(projectmanager->basepath() + "/Build/assetindex.dat");
+
+  scan(m_basepath, true);
+}
+
+
+///////////////////////// AssetIndex::project_closing ///////////////////////
+void AssetIndex::on_project_closing(bool *cancel)
+{
+  auto projectmanager = Studio::Core::instance()->find_object<Studio::ProjectManager>();
+
+  save(projectmanager->basepath() + "/Build/assetindex.dat");
+}
+
+
+///////////////////////// AssetIndex::project_closed ////////////////////////
+void AssetIndex::on_project_closed()
+{
+  {
+    lock_guard<mutex> lock(m_mutex);
+
+    m_assets.clear();
+    m_dependants.clear();
+
+    // scans still in flight for the old project are dropped (see insert)
+
+    m_basepath.clear();
+  }
+
+  if (!m_watched.isEmpty())
+    m_watcher.removePaths(m_watched.toList());
+
+  m_watched.clear();
+}
+
+
+///////////////////////// AssetIndex::content_changed ///////////////////////
+void AssetIndex::on_content_changed(QString const &path)
+{
+  QFileInfo fileinfo(path);
+
+  if (fileinfo.isDir())
+  {
+    scan(fileinfo.absoluteFilePath(), true);
+  }
+  else if (fileinfo.suffix() == "asset")
+  {
+    if (fileinfo.exists())
+      reindex(fileinfo.absoluteFilePath());
+    else
+      remove(fileinfo.absoluteFilePath());
+  }
+}
+
+
+///////////////////////// AssetIndex::directory_changed /////////////////////
+void AssetIndex::on_directory_changed(QString const &path)
+{
+  scan(path, false);
+}
+
+
+///////////////////////// AssetIndex::scanned ///////////////////////////////
+void AssetIndex::on_scanned(QStringList const &directories, bool recursive)
+{
+  auto root = directories.first();
+
+  if (m_basepath.isEmpty() || (root != m_basepath && !root.startsWith(m_basepath + "/")))
+    return;
+
+  // folders that went away since the last scan stop being watched, so one
+  // recreated under the same name is picked up again
+
+  if (!QFileInfo(root).isDir())
+  {
+    unwatch(root);
+
+    return;
+  }
+
+  auto present = directories.toSet();
+
+  for(auto &watched : m_watched.toList())
+  {
+    if (!watched.startsWith(root + "/"))
+      continue;
+
+    auto top = root + "/" + watched.mid(root.size() + 1).section('/', 0, 0);
+
+    if (!present.contains(recursive ? watched : top))
+      unwatch(watched);
+  }
+
+  for(auto &directory : directories)
+  {
+    if (m_watched.contains(directory))
+      continue;
+
+    m_watcher.addPath(directory);
+
+    m_watched.insert(directory);
+
+    // a folder that appeared under a watched one may arrive populated
+
+    if (!recursive)
+      scan(directory, true);
+  }
+}
+
+
+///////////////////////// AssetIndex::unwatch ///////////////////////////////
+void AssetIndex::unwatch(QString const &directory)
+{
+  for(auto &watched : m_watched.toList())
+  {
+    if (watched == directory || watched.startsWith(directory + "/"))
+    {
+      m_watcher.removePath(watched);
+
+      m_watched.remove(watched);
+    }
+  }
+}
+
+
+///////////////////////// AssetIndex::scan //////////////////////////////////
+void AssetIndex::scan(QString const &directory, bool recursive)
+{
+  auto shared = m_shared;
+
+  Studio::WorkQueue::instance()->push([=]() {
+
+    QStringList directories = { directory };
+
+    QSet<QString> files;
+
+    QDirIterator iterator(directory, QDir::Files | QDir::Dirs | QDir::NoDotAndDotDot, recursive ? QDirIterator::Subdirectories : QDirIterator::NoIteratorFlags);
+
+    while (iterator.hasNext())
+    {
+      iterator.next();
+
+      auto fileinfo = iterator.fileInfo();
+
+      if (fileinfo.isDir())
+        directories.push_back(fileinfo.absoluteFilePath());
+
+      if (fileinfo.isFile() && fileinfo.suffix() == "asset")
+        files.insert(fileinfo.absoluteFilePath());
+    }
+
+    lock_guard<mutex> guard(shared->mutex);
+
+    if (!shared->index)
+      return;
+
+    auto index = shared->index;
+
+    QStringList stale, removed;
+
+    {
+      lock_guard<mutex> lock(index->m_mutex);
+
+      for(auto &file : files)
+      {
+        auto entry = index->m_assets.find(file);
+
+        if (entry == index->m_assets.end())
+        {
+          stale.push_back(file);
+          continue;
+        }
+
+        QFileInfo fileinfo(file);
+
+        if (entry->modified != fileinfo.lastModified().toMSecsSinceEpoch() || entry->size != fileinfo.size())
+          stale.push_back(file);
+      }
+
+      for(auto &entry : index->m_assets)
+      {
+        if (!entry.path.startsWith(directory + "/") || files.contains(entry.path))
+          continue;
+
+        auto subpath = entry.path.mid(directory.size() + 1);
+
+        // deeper entries go only when their folder has gone
+
+        if (recursive || !subpath.contains('/') || !directories.contains(directory + "/" + subpath.section('/', 0, 0)))
+          removed.push_back(entry.path);
+      }
+    }
+
+    for(auto &path : removed)
+      index->remove(path);
+
+    for(auto &path : stale)
+      index->reindex(path);
+
+    emit index->scanned(directories, recursive);
+
+  }, Studio::WorkQueue::Priority::Background);
+}
+
+
+///////////////////////// AssetIndex::reindex ///////////////////////////////
+void AssetIndex::reindex(QString const &path)
+{
+  auto shared = m_shared;
+
+  Studio::WorkQueue::instance()->push([=]() {
+
+    Entry entry;
+
+    if (!extract(path, &entry))
+      return;
+
+    lock_guard<mutex> guard(shared->mutex);
+
+    if (shared->index)
+    {
+      shared->index->insert(entry);
+    }
+
+  }, Studio::WorkQueue::Priority::Background);
+}
+
+
+///////////////////////// AssetIndex::extract ///////////////////////////////
+bool AssetIndex::extract(QString const &path, Entry *entry)
+{
+  try
+  {
+    QFileInfo fileinfo(path);
+
+    ifstream fin(path.toUtf8(), ios::binary);
+
+    if (!fin)
+      return false;
+
+    auto metadata = read_asset_metadata(fin);
+
+    entry->path = path;
+    entry->type = metadata["type"].toString();
+    entry->src = metadata["src"].toString();
+    entry->iconhash = qHash(read_asset_icon(fin));
+    entry->modified = fileinfo.lastModified().toMSecsSinceEpoch();
+    entry->size = fileinfo.size();
+
+    auto base = fileinfo.absolutePath();
+
+    // only definition and shader assets carry references, asset 1 of an
+    // image or mesh is its payload
+
+    auto assettype = read_asset_type(fin, 1);
+
+    if (assettype == "TEXT"_packchunktype && entry->type != "Shader")
+    {
+      collect_paths(read_asset_json(fin, 1), base, entry->dependencies);
+    }
+
+    if (assettype == "TEXT"_packchunktype && entry->type == "Shader")
+    {
+      for(auto &line : read_asset_text(fin, 1).split('\n'))
+      {
+        if (line.startsWith("#include"))
+        {
+          auto include = QString(line.mid(line.indexOf('"') + 1, line.lastIndexOf('"') - line.indexOf('"') - 1)) + ".asset";
+
+          entry->dependencies.push_back(QDir::cleanPath(QDir(base).absoluteFilePath(include)));
+        }
+      }
+    }
+
+    entry->dependencies.removeDuplicates();
+
+    return true;
+  }
+  catch(exception &e)
+  {
+    qDebug() << "Index Error:" << path << e.what();
+  }
+
+  return false;
+}
+
+
+///////////////////////// AssetIndex::insert ////////////////////////////////
+void AssetIndex::insert(Entry const &entry)
+{
+  {
+    lock_guard<mutex> lock(m_mutex);
+
+    if (m_basepath.isEmpty() || !entry.path.startsWith(m_basepath + "/"))
+      return;
+
+    auto previous = m_assets.find(entry.path);
+
+    if (previous != m_assets.end())
+    {
+      for(auto &dependency : previous->dependencies)
+        m_dependants.remove(dependency, entry.path);
+    }
+
+    m_assets[entry.path] = entry;
+
+    for(auto &dependency : entry.dependencies)
+      m_dependants.insert(dependency, entry.path);
+  }
+
+  emit asset_indexed(entry.path);
+}
+
+
+///////////////////////// AssetIndex::remove ////////////////////////////////
+void AssetIndex::remove(QString const &path)
+{
+  {
+    lock_guard<mutex> lock(m_mutex);
+
+    auto entry = m_assets.find(path);
+
+    if (entry == m_assets.end())
+      return;
+
+    for(auto &dependency : entry->dependencies)
+      m_dependants.remove(dependency, path);
+
+    m_assets.erase(entry);
+  }
+
+  emit asset_removed(path);
+}
+
+
+///////////////////////// AssetIndex::load //////////////////////////////////
+void AssetIndex::load(QString const &file)
+{
+  QFile fin(file);
+
+  if (!fin.open(QIODevice::ReadOnly))
+    return;
+
+  QDataStream stream(&fin);
+
+  quint32 magic, version, count;
+
+  stream >> magic >> version >> count;
+
+  if (magic != IndexMagic || version != IndexVersion)
+    return;
+
+  QDir base(QFileInfo(file).dir().filePath(".."));
+
+  lock_guard<mutex> lock(m_mutex);
+
+  for(quint32 i = 0; i < count && stream.status() == QDataStream::Ok; ++i)
+  {
+    Entry entry;
+
+    stream >> entry.path >> entry.type >> entry.src >> entry.iconhash >> entry.dependencies >> entry.modified >> entry.size;
+
+    entry.path = QDir::cleanPath(base.absoluteFilePath(entry.path));
+
+    for(auto &dependency : entry.dependencies)
+    {
+      dependency = QDir::cleanPath(base.absoluteFilePath(dependency));
+
+      m_dependants.insert(dependency, entry.path);
+    }
+
+    m_assets.insert(entry.path, entry);
+  }
+}
+
+
+///////////////////////// AssetIndex::save //////////////////////////////////
+void AssetIndex::save(QString const &file) const
+{
+  QSaveFile fout(file);
+
+  if (!fout.open(QIODevice::WriteOnly))
+    return;
+
+  QDataStream stream(&fout);
+
+  QDir base(QFileInfo(file).dir().filePath(".."));
+
+  lock_guard<mutex> lock(m_mutex);
+
+  stream << IndexMagic << IndexVersion << quint32(m_assets.size());
+
+  for(auto &entry : m_assets)
+  {
+    QStringList dependencies;
+
+    for(auto &dependency : entry.dependencies)
+      dependencies.push_back(base.relativeFilePath(dependency));
+
+    stream << base.relativeFilePath(entry.path) << entry.type << entry.src << entry.iconhash << dependencies << entry.modified << entry.size;
+  }
+
+  fout.commit();
+}
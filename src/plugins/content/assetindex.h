@@ -0,0 +1,105 @@
+//
+// Asset Index
+//
+
+//
+// Copyright (C) 2016 Peter Niekamp
+//
+
+#pragma once
+
+#include "api.h"
+#include "contentapi.h"
+#include <QHash>
+#include <QMultiHash>
+#include <QSet>
+#include <QFileSystemWatcher>
+#include <memory>
+#include <mutex>
+
+//-------------------------- AssetIndex -------------------------------------
+//---------------------------------------------------------------------------
+
+// type, source, icon hash and definition referenced dependencies of every
+// asset in the project content. persisted with the build state, validated
+// against file modification time on project open and refreshed from file
+// system and content change notifications, so it may briefly lag the disk
+// functions are thread safe
+
+class AssetIndex : public Studio::AssetIndex
+{
+  Q_OBJECT
+
+  public:
+    AssetIndex();
+    ~AssetIndex();
+
+    bool find(QString const &path, Asset *asset) const;
+
+    QStringList search(QString const &text, QString const &type = QString()) const;
+
+    QStringList dependencies(QString const &path) const;
+
+    QStringList dependants(QString const &path, bool recursive = false) const;
+
+  signals:
+
+    void scanned(QStringList const &directories, bool recursive);
+
+  protected:
+
+    void on_project_changed(QString const &projectfile);
+
+    void on_project_closing(bool *cancel);
+
+    void on_project_closed();
+
+    void on_content_changed(QString const &path);
+
+    void on_directory_changed(QString const &path);
+
+    void on_scanned(QStringList const &directories, bool recursive);
+
+  private:
+
+    struct Entry : public Asset
+    {
+      qint64 modified;
+      qint64 size;
+    };
+
+    static bool extract(QString const &path, Entry *entry);
+
+    void load(QString const &file);
+    void save(QString const &file) const;
+
+    void scan(QString const &directory, bool recursive);
+
+    void reindex(QString const &path);
+
+    void insert(Entry const &entry);
+    void remove(QString const &path);
+
+    void unwatch(QString const &directory);
+
+    struct Shared
+    {
+      std::mutex mutex;
+
+      AssetIndex *index;
+    };
+
+    std::shared_ptr<Shared> m_shared;
+
+    QString m_basepath;
+
+    QHash<QString, Entry> m_assets;
+
+    QMultiHash<QString, QString> m_dependants;
+
+    QSet<QString> m_watched;
+
+    QFileSystemWatcher m_watcher;
+
+    mutable std::mutex m_mutex;
+};
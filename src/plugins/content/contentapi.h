@@ -53,4 +53,47 @@ namespace Studio
     protected:
       virtual ~ContentManager() { }
   };
+
+
+  //-------------------------- AssetIndex -------------------------------------
+  //---------------------------------------------------------------------------
+
+  // lookup aid for browsing, search and delete warnings. it settles behind
+  // the file system, builds track their own dependencies (see HashCache)
+  // and never consult it
+
+  class CONTENTPLUGIN_EXPORT AssetIndex : public QObject
+  {
+    Q_OBJECT
+
+    public:
+
+      struct Asset
+      {
+        QString path;
+        QString type;
+        QString src;
+
+        uint iconhash;
+
+        QStringList dependencies;
+      };
+
+      virtual bool find(QString const &path, Asset *asset) const = 0;
+
+      virtual QStringList search(QString const &text, QString const &type = QString()) const = 0;
+
+      virtual QStringList dependencies(QString const &path) const = 0;
+
+      virtual QStringList dependants(QString const &path, bool recursive = false) const = 0;
+
+    signals:
+
+      void asset_indexed(QString const &path);
+
+      void asset_removed(QString const &path);
+
+    protected:
+      virtual ~AssetIndex() { }
+  };
 }
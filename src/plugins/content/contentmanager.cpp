@@ -9,12 +9,48 @@
 #include "contentmanager.h"
 #include "projectapi.h"
 #include "documentapi.h"
+#include "editorapi.h"
+#include "workqueue.h"
 #include <QDir>
+#include <QSet>
+#include <QDateTime>
+#include <QCryptographicHash>
+#include <QProgressDialog>
+#include <QCoreApplication>
+#include <condition_variable>
+#include <atomic>
 
 #include <QtDebug>
 
 using namespace std;
 
+namespace
+{
+  QJsonObject source_stamp(QString const &src, bool digest)
+  {
+    QJsonObject stamp;
+
+    QFileInfo fileinfo(src);
+
+    stamp["modified"] = static_cast<double>(fileinfo.lastModified().toMSecsSinceEpoch());
+    stamp["size"] = static_cast<double>(fileinfo.size());
+
+    if (digest)
+    {
+      QFile fin(src);
+
+      QCryptographicHash hash(QCryptographicHash::Sha1);
+
+      if (fin.open(QIODevice::ReadOnly) && hash.addData(&fin))
+      {
+        stamp["digest"] = QString(hash.result().toHex());
+      }
+    }
+
+    return stamp;
+  }
+}
+
 //|---------------------- ContentManager ------------------------------------
 //|--------------------------------------------------------------------------
 //| Content Manager
@@ -23,10 +59,13 @@ using namespace std;
 ///////////////////////// ContentManager::Constructor ///////////////////////
 ContentManager::ContentManager()
 {
+  m_reimporting = false;
+
   auto documentmanager = Studio::Core::instance()->find_object<Studio::DocumentManager>();
 
   connect(documentmanager, &Studio::DocumentManager::document_changed, this, &ContentManager::on_document_changed);
   connect(documentmanager, &Studio::DocumentManager::document_renamed, this, &ContentManager::on_document_renamed);
+  connect(documentmanager, &Studio::DocumentManager::documents_changed, this, &ContentManager::on_documents_changed);
 }
 
 
@@ -45,6 +84,28 @@ void ContentManager::on_document_renamed(Studio::Document *document, QString con
 }
 
 
+///////////////////////// ContentManager::documents_changed /////////////////
+void ContentManager::on_documents_changed(QVector<Studio::DocumentManager::Change> const &changes)
+{
+  QSet<QString> folders;
+
+  for(auto &change : changes)
+  {
+    folders.insert(QFileInfo(change.src).absolutePath());
+
+    if (change.dst != "")
+      folders.insert(QFileInfo(change.dst).absolutePath());
+  }
+
+  // one notification per affected folder rather than per asset
+
+  for(auto &folder : folders)
+  {
+    emit content_changed(folder);
+  }
+}
+
+
 ///////////////////////// ContentManager::basepath //////////////////////////
 QString ContentManager::basepath() const
 {
@@ -136,12 +197,13 @@ bool ContentManager::import(QString const &src, QString const &dst)
 
   try
   {
-    for(auto &importer : m_importers)
+    QJsonObject metadata;
+
+    metadata["srcstamp"] = source_stamp(src, true);
+
+    if (!result)
     {
-      if (!result)
-      {
-        QMetaObject::invokeMethod(importer, "try_import", Q_RETURN_ARG(bool, result), Q_ARG(QString, src), Q_ARG(QString, path), Q_ARG(QJsonObject, QJsonObject()));
-      }
+      result = try_import(src, path, metadata);
     }
 
     if (result)
@@ -160,17 +222,36 @@ bool ContentManager::import(QString const &src, QString const &dst)
 }
 
 
-///////////////////////// ContentManager::reimport //////////////////////////
-bool ContentManager::reimport(QString const &path)
+///////////////////////// ContentManager::try_import ////////////////////////
+bool ContentManager::try_import(QString const &src, QString const &dst, QJsonObject const &metadata)
+{
+  bool result = false;
+
+  // importers own progress widgets and library globals, gui thread only
+
+  for(auto &importer : m_importers)
+  {
+    if (!result)
+    {
+      QMetaObject::invokeMethod(importer, "try_import", Q_RETURN_ARG(bool, result), Q_ARG(QString, src), Q_ARG(QString, dst), Q_ARG(QJsonObject, metadata));
+    }
+  }
+
+  return result;
+}
+
+
+///////////////////////// ContentManager::collect ///////////////////////////
+void ContentManager::collect(QString const &path, vector<Reimport> &jobs)
 {
   if (QFileInfo(path).isDir())
   {
     for(auto &entry : QDir(path).entryInfoList(QDir::Files | QDir::Dirs | QDir::NoDotAndDotDot, QDir::Name))
     {
-      reimport(entry.filePath());
+      collect(entry.filePath(), jobs);
     }
 
-    return true;
+    return;
   }
 
   auto documentmanager = Studio::Core::instance()->find_object<Studio::DocumentManager>();
@@ -178,45 +259,189 @@ bool ContentManager::reimport(QString const &path)
   if (auto document = documentmanager->open(path))
   {
     QString src = document->metadata("src").toString();
-    QString dst = path + ".tmp";
 
-    bool result = false;
+    if (src != "" && QFileInfo(src).exists())
+    {
+      auto metadata = document->metadata();
+
+      auto stamp = metadata["srcstamp"].toObject();
+      auto current = source_stamp(src, false);
+
+      // matching modification time and size is taken as unchanged without
+      // reading the source, anything else is settled by digest on the worker
+
+      if (stamp.value("modified") != current.value("modified") || stamp.value("size") != current.value("size") || stamp.value("digest").toString() == "")
+      {
+        jobs.push_back({ document, src, path + ".tmp", metadata, QJsonObject(), false, false });
+
+        return;
+      }
+    }
+
+    documentmanager->close(document);
+  }
+}
+
+
+///////////////////////// ContentManager::reimport //////////////////////////
+bool ContentManager::reimport(QString const &path)
+{
+  // workers hold pointers into the jobs below while events are pumped, the
+  // dialog is modal and content edits are refused until it finishes
+
+  if (m_reimporting)
+    return false;
+
+  m_reimporting = true;
+
+  auto documentmanager = Studio::Core::instance()->find_object<Studio::DocumentManager>();
+
+  vector<Reimport> jobs;
+
+  collect(path, jobs);
+
+  auto mainwindow = Studio::Core::instance()->find_object<Studio::MainWindow>();
+
+  QProgressDialog dlg("Checking sources...", "Abort", 0, 2*jobs.size(), mainwindow->handle());
+
+  dlg.setWindowTitle("Reimport");
+  dlg.setWindowModality(Qt::ApplicationModal);
+  dlg.setMinimumDuration(500);
+
+  struct Progress
+  {
+    mutex lock;
+    condition_variable signal;
+
+    size_t remaining;
+
+    atomic<bool> cancelled;
+
+  } progress;
+
+  progress.remaining = jobs.size();
+  progress.cancelled = false;
+
+  // only the digests run on the work queue, sources that really changed are
+  // imported below on this thread
+
+  for(auto &job : jobs)
+  {
+    Studio::WorkQueue::instance()->push([job = &job, progress = &progress]() {
+
+      if (!progress->cancelled)
+      {
+        auto stamp = source_stamp(job->src, true);
+        auto previous = job->metadata["srcstamp"].toObject();
+
+        job->stamp = stamp;
+        job->changed = (stamp.value("size") != previous.value("size") || stamp.value("digest") != previous.value("digest"));
+      }
+
+      lock_guard<mutex> lock(progress->lock);
+
+      if (--progress->remaining == 0)
+        progress->signal.notify_all();
+
+    }, Studio::WorkQueue::Priority::Background);
+  }
+
+  while (true)
+  {
+    size_t remaining;
 
-    if (src != "")
+    {
+      unique_lock<mutex> lock(progress.lock);
+
+      if (progress.signal.wait_for(lock, chrono::milliseconds(50), [&]() { return progress.remaining == 0; }))
+        break;
+
+      remaining = progress.remaining;
+    }
+
+    dlg.setValue(jobs.size() - remaining);
+
+    QCoreApplication::processEvents();
+
+    if (dlg.wasCanceled())
+      progress.cancelled = true;
+  }
+
+  // imports run one at a time, only the digests above are parallel
+
+  dlg.setLabelText("Importing changed sources...");
+
+  for(size_t i = 0; i < jobs.size(); ++i)
+  {
+    auto &job = jobs[i];
+
+    dlg.setValue(jobs.size() + i);
+
+    if (dlg.wasCanceled())
+      break;
+
+    if (job.changed)
     {
       try
       {
-        for(auto &importer : m_importers)
-        {
-          if (!result)
-          {
-            QMetaObject::invokeMethod(importer, "try_import", Q_RETURN_ARG(bool, result), Q_ARG(QString, src), Q_ARG(QString, dst), Q_ARG(QJsonObject, document->metadata()));
-          }
-        }
-
-        if (result)
-        {
-          documentmanager->rewrite(document, dst);
-        }
+        job.metadata["srcstamp"] = job.stamp;
+
+        job.result = try_import(job.src, job.dst, job.metadata);
       }
       catch(exception &e)
       {
         qCritical() << "Import Error:" << e.what();
 
-        QFile::remove(dst);
+        job.result = false;
       }
     }
+    else if (!job.stamp.isEmpty() && !job.document->modified())
+    {
+      // content unchanged but the file was touched, refresh the stamp so the
+      // next reimport settles it without another digest
 
-    documentmanager->close(document);
+      job.document->lock_exclusive();
+
+      job.document->set_metadata("srcstamp", job.stamp.toVariantMap());
+
+      job.document->save();
+
+      job.document->unlock_exclusive(false);
+    }
   }
 
-  return true;
+  dlg.setValue(2*jobs.size());
+
+  // rewrite and close together once every import has landed
+
+  documentmanager->begin_batch();
+
+  for(auto &job : jobs)
+  {
+    if (job.result)
+    {
+      documentmanager->rewrite(job.document, job.dst);
+    }
+
+    QFile::remove(job.dst);
+
+    documentmanager->close(job.document);
+  }
+
+  documentmanager->end_batch();
+
+  m_reimporting = false;
+
+  return !dlg.wasCanceled();
 }
 
 
 ///////////////////////// ContentManager::rename_content ////////////////////
 bool ContentManager::rename_content(QString const &src, QString const &dst)
 {
+  if (m_reimporting)
+    return false;
+
   if (QFileInfo(dst).exists())
     return false;
 
@@ -226,11 +451,15 @@ bool ContentManager::rename_content(QString const &src, QString const &dst)
   if (QFileInfo(dst).dir().absolutePath().left(QFileInfo(src).absoluteFilePath().length()) == QFileInfo(src).absoluteFilePath())
     return false;
 
+  auto documentmanager = Studio::Core::instance()->find_object<Studio::DocumentManager>();
+
   if (QFileInfo(src).isDir())
   {
     if (!create("Folder", dst))
       return false;
 
+    documentmanager->begin_batch();
+
     for(auto &entry : QDir(src).entryInfoList(QDir::Files | QDir::Dirs | QDir::NoDotAndDotDot, QDir::Name))
     {
       rename_content(entry.filePath(), QDir(dst).filePath(entry.fileName()));
@@ -238,11 +467,11 @@ bool ContentManager::rename_content(QString const &src, QString const &dst)
 
     delete_content(src);
 
+    documentmanager->end_batch();
+
     return true;
   }
 
-  auto documentmanager = Studio::Core::instance()->find_object<Studio::DocumentManager>();
-
   if (auto document = documentmanager->open(src))
   {
     documentmanager->rename(document, dst);
@@ -257,15 +486,24 @@ bool ContentManager::rename_content(QString const &src, QString const &dst)
 ///////////////////////// ContentManager::delete_content ////////////////////
 bool ContentManager::delete_content(QString const &path)
 {
+  if (m_reimporting)
+    return false;
+
+  auto documentmanager = Studio::Core::instance()->find_object<Studio::DocumentManager>();
+
   if (QFileInfo(path).isDir())
   {
     bool result = true;
 
+    documentmanager->begin_batch();
+
     for(auto &entry : QDir(path).entryInfoList(QDir::Files | QDir::Dirs | QDir::NoDotAndDotDot, QDir::Name))
     {
       result &= delete_content(entry.filePath());
     }
 
+    documentmanager->end_batch();
+
     if (result)
     {
       QDir(path).removeRecursively();
@@ -276,14 +514,7 @@ bool ContentManager::delete_content(QString const &path)
     return true;
   }
 
-  if (QFile::remove(path))
-  {
-    emit content_changed(path);
-
-    return true;
-  }
-
-  return false;
+  return documentmanager->remove(path);
 }
 
 
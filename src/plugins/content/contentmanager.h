@@ -11,6 +11,7 @@
 #include "api.h"
 #include "contentapi.h"
 #include "documentapi.h"
+#include <vector>
 
 //-------------------------- ContentManager ---------------------------------
 //---------------------------------------------------------------------------
@@ -41,9 +42,31 @@ class ContentManager : public Studio::ContentManager
 
     void on_document_changed(Studio::Document *document, QString const &path);
     void on_document_renamed(Studio::Document *document, QString const &src, QString const &dst);
+    void on_documents_changed(QVector<Studio::DocumentManager::Change> const &changes);
 
   private:
 
+    struct Reimport
+    {
+      Studio::Document *document;
+
+      QString src;
+      QString dst;
+
+      QJsonObject metadata;
+
+      QJsonObject stamp;
+
+      bool changed;
+      bool result;
+    };
+
+    void collect(QString const &path, std::vector<Reimport> &jobs);
+
+    bool try_import(QString const &src, QString const &dst, QJsonObject const &metadata);
+
+    bool m_reimporting;
+
     QMap<QString, QObject*> m_creators;
 
     QVector<QObject*> m_importers;
@@ -8,6 +8,7 @@
 
 #include "contentplugin.h"
 #include "contentmanager.h"
+#include "assetindex.h"
 #include "projectapi.h"
 #include "editorapi.h"
 #include <QWidgetAction>
@@ -28,6 +29,7 @@ using namespace std;
 
 ///////////////////////// ContentPlugin::Constructor ////////////////////////
 ContentPlugin::ContentPlugin()
+  : m_container(nullptr)
 {
 }
 
@@ -43,6 +45,10 @@ ContentPlugin::~ContentPlugin()
 bool ContentPlugin::initialise(QStringList const &arguments, QString *errormsg)
 {
   Studio::Core::instance()->add_object(new ContentManager);
+  Studio::Core::instance()->add_object(new AssetIndex);
+
+  if (arguments.contains("--headless"))
+    return true;
 
   auto actionmanager = Studio::Core::instance()->find_object<Studio::ActionManager>();
 
@@ -130,6 +136,9 @@ bool ContentPlugin::initialise(QStringList const &arguments, QString *errormsg)
 ///////////////////////// ContentPlugin::shutdown ///////////////////////////
 void ContentPlugin::shutdown()
 {
+  if (!m_container)
+    return;
+
   QSettings settings;
 
   settings.setValue("contentplugin/splitter", ui.Splitter->saveState());
@@ -322,7 +331,43 @@ void ContentPlugin::on_Delete_triggered()
 {
   auto contentmanager = Studio::Core::instance()->find_object<Studio::ContentManager>();
 
-  if (QMessageBox::question(m_container, "Delete Content", "Delete Selected Content\n\nSure ?", QMessageBox::Ok | QMessageBox::Cancel) == QMessageBox::Ok)
+  auto assetindex = Studio::Core::instance()->find_object<Studio::AssetIndex>();
+
+  QString message = "Delete Selected Content";
+
+  if (m_container->focusWidget() == ui.Content)
+  {
+    // warn about assets that still reference the selection
+
+    QStringList dependants;
+
+    for(auto &path : ui.Content->selected_paths())
+    {
+      dependants += assetindex->dependants(path);
+    }
+
+    for(auto &path : ui.Content->selected_paths())
+    {
+      dependants.removeAll(path);
+    }
+
+    dependants.removeDuplicates();
+
+    if (!dependants.isEmpty())
+    {
+      message += "\n\nReferenced By:";
+
+      for(int i = 0; i < min(dependants.size(), 10); ++i)
+      {
+        message += "\n  " + QDir(contentmanager->basepath()).relativeFilePath(dependants[i]);
+      }
+
+      if (dependants.size() > 10)
+        message += QString("\n  ... %1 more").arg(dependants.size() - 10);
+    }
+  }
+
+  if (QMessageBox::question(m_container, "Delete Content", message + "\n\nSure ?", QMessageBox::Ok | QMessageBox::Cancel) == QMessageBox::Ok)
   {
     if (m_container->focusWidget() == ui.Folders && ui.Folders->currentIndex().parent().isValid())
     {
@@ -13,6 +13,7 @@
 #include <QDragMoveEvent>
 #include <QMimeData>
 #include <QLineEdit>
+#include <QScrollBar>
 #include <QTimer>
 
 #include <QtDebug>
@@ -20,6 +21,7 @@
 using namespace std;
 
 const int PathRole = Qt::UserRole + 1;
+const int RequestedRole = Qt::UserRole + 2;
 
 //|---------------------- ContentView ---------------------------------------
 //|--------------------------------------------------------------------------
@@ -32,6 +34,16 @@ ContentView::ContentView(QWidget *parent)
 {
   setContextMenuPolicy(Qt::CustomContextMenu);
 
+  setUniformItemSizes(true);
+  setLayoutMode(QListView::Batched);
+
+  m_thumbnails = new ThumbnailService(this);
+
+  connect(m_thumbnails, &ThumbnailService::thumbnail_ready, this, &ContentView::on_thumbnail_ready);
+
+  connect(verticalScrollBar(), &QScrollBar::valueChanged, this, &ContentView::load_visible);
+  connect(horizontalScrollBar(), &QScrollBar::valueChanged, this, &ContentView::load_visible);
+
   connect(this, &QListWidget::itemDoubleClicked, this, &ContentView::itemDoubleClicked);
 }
 
@@ -187,6 +199,13 @@ void ContentView::update(QString const &path)
 {
   QFileInfo pathinfo(path);
 
+  if (pathinfo.absoluteFilePath() == QFileInfo(m_path).absoluteFilePath())
+  {
+    refresh();
+
+    return;
+  }
+
   if (pathinfo.absoluteDir() == m_path)
   {
     bool found = false;
@@ -203,6 +222,13 @@ void ContentView::update(QString const &path)
           {
             item->setIcon(document->icon());
 
+            // an unsaved icon outranks whatever the thumbnail cache holds
+
+            if (document->modified())
+              m_modified.insert(path);
+            else
+              m_modified.remove(path);
+
             documentmanager->close(document);
           }
         }
@@ -230,6 +256,9 @@ void ContentView::refresh()
 
   clear();
 
+  m_items.clear();
+  m_modified.clear();
+
   blockSignals(true);
 
   for(auto &entry : QDir(m_path).entryInfoList(QDir::Files | QDir::Dirs | QDir::NoDotAndDotDot, QDir::DirsFirst | QDir::Name))
@@ -252,10 +281,74 @@ void ContentView::refresh()
     else
     {
       item->setIcon(QIcon(":/contentplugin/icon.png"));
+      item->setData(RequestedRole, false);
 
-      QTimer::singleShot(50, this, [=]() { update(entry.filePath()); });
+      m_items.insert(entry.filePath(), item);
     }
   }
 
   blockSignals(false);
+
+  // icons load once the layout settles, and only for items in view
+
+  QTimer::singleShot(0, this, &ContentView::load_visible);
+}
+
+
+///////////////////////// ContentView::resizeEvent //////////////////////////
+void ContentView::resizeEvent(QResizeEvent *event)
+{
+  QListWidget::resizeEvent(event);
+
+  load_visible();
+}
+
+
+///////////////////////// ContentView::load_visible /////////////////////////
+void ContentView::load_visible()
+{
+  if (count() == 0)
+    return;
+
+  auto visible = viewport()->rect();
+
+  // items flow in row order, so the corners bound the rows in view. a corner
+  // that lands in the spacing between items leaves that end open
+
+  auto first = indexAt(visible.topLeft());
+  auto last = indexAt(visible.bottomRight());
+
+  int begin = first.isValid() ? first.row() : 0;
+  int end = last.isValid() ? last.row() : count() - 1;
+
+  for(int row = begin; row <= end; ++row)
+  {
+    auto item = this->item(row);
+
+    if (!item->data(RequestedRole).isValid() || item->data(RequestedRole).toBool())
+      continue;
+
+    if (!visualItemRect(item).intersects(visible))
+      continue;
+
+    item->setData(RequestedRole, true);
+
+    m_thumbnails->request(item->data(PathRole).toString());
+  }
+}
+
+
+///////////////////////// ContentView::thumbnail_ready //////////////////////
+void ContentView::on_thumbnail_ready(QString const &path, QImage const &image)
+{
+  if (m_modified.contains(path))
+    return;
+
+  if (auto item = m_items.value(path))
+  {
+    if (!image.isNull())
+    {
+      item->setIcon(QIcon(QPixmap::fromImage(image)));
+    }
+  }
 }
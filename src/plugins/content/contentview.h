@@ -8,7 +8,10 @@
 
 #pragma once
 
+#include "thumbnailservice.h"
 #include <QListWidget>
+#include <QHash>
+#include <QSet>
 
 //-------------------------- ContentView ------------------------------------
 //---------------------------------------------------------------------------
@@ -53,7 +56,21 @@ class ContentView : public QListWidget
     Qt::DropActions supportedDropActions() const;
     void dropEvent(QDropEvent *event);
 
+    void resizeEvent(QResizeEvent *event);
+
+  protected slots:
+
+    void load_visible();
+
+    void on_thumbnail_ready(QString const &path, QImage const &image);
+
   private:
 
     QString m_path;
+
+    QHash<QString, QListWidgetItem*> m_items;
+
+    QSet<QString> m_modified;
+
+    ThumbnailService *m_thumbnails;
 };
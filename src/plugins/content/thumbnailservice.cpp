@@ -0,0 +1,133 @@
+//
+// Thumbnail Service
+//
+
+//
+// Copyright (C) 2016 Peter Niekamp
+//
+
+#include "thumbnailservice.h"
+#include "assetfile.h"
+#include "workqueue.h"
+#include <QFileInfo>
+#include <QDateTime>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QCryptographicHash>
+
+#include <QtDebug>
+
+using namespace std;
+
+//|---------------------- ThumbnailService ----------------------------------
+//|--------------------------------------------------------------------------
+
+///////////////////////// ThumbnailService::Constructor /////////////////////
+ThumbnailService::ThumbnailService(QObject *parent)
+  : QObject(parent)
+{
+  m_shared = make_shared<Shared>();
+  m_shared->service = this;
+
+  m_cachedir = QDir(QStandardPaths::writableLocation(QStandardPaths::CacheLocation)).filePath("thumbnails");
+
+  m_cachedir.mkpath(".");
+
+  auto cachedir = m_cachedir;
+
+  Studio::WorkQueue::instance()->push([=]() { trim(cachedir); }, Studio::WorkQueue::Priority::Background);
+}
+
+
+///////////////////////// ThumbnailService::Destructor //////////////////////
+ThumbnailService::~ThumbnailService()
+{
+  lock_guard<mutex> lock(m_shared->mutex);
+
+  m_shared->service = nullptr;
+}
+
+
+///////////////////////// ThumbnailService::request /////////////////////////
+void ThumbnailService::request(QString const &path)
+{
+  QFileInfo fileinfo(path);
+
+  QCryptographicHash key(QCryptographicHash::Sha1);
+
+  key.addData(fileinfo.absoluteFilePath().toUtf8());
+  key.addData(QByteArray::number(fileinfo.lastModified().toMSecsSinceEpoch()));
+  key.addData(QByteArray::number(fileinfo.size()));
+
+  auto cachepath = m_cachedir.filePath(key.result().toHex() + ".png");
+
+  auto shared = m_shared;
+
+  Studio::WorkQueue::instance()->push([=]() {
+
+    auto image = extract(path, cachepath);
+
+    lock_guard<mutex> lock(shared->mutex);
+
+    if (shared->service)
+    {
+      emit shared->service->thumbnail_ready(path, image);
+    }
+
+  }, Studio::WorkQueue::Priority::Interactive);
+}
+
+
+///////////////////////// ThumbnailService::extract /////////////////////////
+QImage ThumbnailService::extract(QString const &path, QString const &cachepath)
+{
+  QImage image;
+
+  if (image.load(cachepath, "PNG"))
+    return image;
+
+  try
+  {
+    ifstream fin(path.toUtf8(), ios::binary);
+
+    if (!fin)
+      return image;
+
+    image = decode_icon_image(read_asset_icon(fin));
+
+    if (!image.isNull())
+    {
+      QSaveFile fout(cachepath);
+
+      if (fout.open(QIODevice::WriteOnly) && image.save(&fout, "PNG"))
+        fout.commit();
+    }
+  }
+  catch(exception &e)
+  {
+    qDebug() << "Thumbnail Error:" << path << e.what();
+  }
+
+  return image;
+}
+
+
+///////////////////////// ThumbnailService::trim ////////////////////////////
+void ThumbnailService::trim(QDir const &cachedir)
+{
+  // newest first, everything past the budget goes
+
+  qint64 total = 0;
+
+  auto entries = cachedir.entryInfoList(QStringList("*.png"), QDir::Files, QDir::Time);
+
+  for(auto &entry : entries)
+  {
+    total += entry.size();
+
+    if (total > CacheSize)
+    {
+      QFile::remove(entry.filePath());
+    }
+  }
+}
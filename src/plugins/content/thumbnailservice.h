@@ -0,0 +1,59 @@
+//
+// Thumbnail Service
+//
+
+//
+// Copyright (C) 2016 Peter Niekamp
+//
+
+#pragma once
+
+#include <QObject>
+#include <QImage>
+#include <QDir>
+#include <memory>
+#include <mutex>
+
+//-------------------------- ThumbnailService -------------------------------
+//---------------------------------------------------------------------------
+
+// asset icons extracted on the work queue, decoded icons are cached on disk
+// keyed by path and modification time so revisiting a folder skips the
+// asset metadata entirely. the cache is trimmed to CacheSize, oldest entries
+// first, each time a service starts
+
+class ThumbnailService : public QObject
+{
+  Q_OBJECT
+
+  public:
+
+    static constexpr qint64 CacheSize = 64*1024*1024;
+
+  public:
+    ThumbnailService(QObject *parent = nullptr);
+    ~ThumbnailService();
+
+    void request(QString const &path);
+
+  signals:
+
+    void thumbnail_ready(QString const &path, QImage const &image);
+
+  private:
+
+    static QImage extract(QString const &path, QString const &cachepath);
+
+    static void trim(QDir const &cachedir);
+
+    struct Shared
+    {
+      std::mutex mutex;
+
+      ThumbnailService *service;
+    };
+
+    std::shared_ptr<Shared> m_shared;
+
+    QDir m_cachedir;
+};
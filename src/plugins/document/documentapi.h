@@ -76,6 +76,16 @@ namespace Studio
 
       void document_changed();
 
+      // emitted directly, with the document exclusively locked, so holders
+      // of deferred writes can land or drop them first
+
+      void about_to_save();
+      void about_to_discard();
+
+      void save_progress(int progress);
+
+      void save_complete(bool result);
+
     protected:
       virtual ~Document() { }
   };
@@ -102,12 +112,30 @@ namespace Studio
 
       virtual bool rewrite(Document *document, QString const &src) = 0;
 
+      virtual bool remove(QString const &path) = 0;
+
+      // changes between begin_batch and end_batch are reported together by
+      // a single documents_changed in place of the per document signals, so
+      // every listener of those must handle documents_changed as well
+
+      virtual void begin_batch() = 0;
+      virtual void end_batch() = 0;
+
+      struct Change
+      {
+        Document *document; // null for a file that was not open (or closed within the batch)
+        QString src;
+        QString dst;        // same as src unless renamed, empty if removed
+      };
+
     signals:
 
       void document_changed(Document *document, QString const &path);
 
       void document_renamed(Document *document, QString const &src, QString const &dst);
 
+      void documents_changed(QVector<Studio::DocumentManager::Change> const &changes);
+
     protected:
       virtual ~DocumentManager() { }
   };
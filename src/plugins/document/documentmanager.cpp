@@ -8,8 +8,12 @@
 
 #include "documentmanager.h"
 #include "assetfile.h"
+#include "workqueue.h"
 #include <QFileInfo>
+#include <QSaveFile>
 #include <QFile>
+#include <QDir>
+#include <sstream>
 #include <cassert>
 
 #include <QtDebug>
@@ -23,13 +27,16 @@ using namespace leap::threadlib;
 
 ///////////////////////// Document::Constructor /////////////////////////////
 Document::Document(QString const &path)
-  : m_modified(false)
+  : m_modified(false),
+    m_iconloaded(false),
+    m_dirtyblocks(0),
+    m_journalsize(0)
 {
   lock_exclusive();
 
   attach(path);
 
-  m_metadata = read_asset_json(m_file, 0);
+  m_metadata = read_asset_metadata(m_file);
 
 #if 0
   uint64_t position = sizeof(PackHeader);
@@ -110,6 +117,13 @@ Document::Document(QString const &path)
 }
 
 
+///////////////////////// Document::Destructor //////////////////////////////
+Document::~Document()
+{
+  wait();
+}
+
+
 ///////////////////////// Document::type ////////////////////////////////////
 QString Document::type() const
 {
@@ -120,14 +134,31 @@ QString Document::type() const
 ///////////////////////// Document::icon ////////////////////////////////////
 QIcon Document::icon() const
 {
-  return decode_icon(metadata("icon").toString());
+  SyncLock lock(m_mutex);
+
+  if (!m_iconloaded)
+  {
+    lock_guard<mutex> lock(m_filemutex);
+
+    m_icon = read_asset_icon(m_file);
+    m_iconloaded = true;
+  }
+
+  return decode_icon(m_icon);
 }
 
 
 ///////////////////////// Document::set_icon ////////////////////////////////
 void Document::set_icon(QIcon const &icon)
 {
-  set_metadata("icon", encode_icon(icon));
+  assert(m_exclusive);
+
+  SyncLock lock(m_mutex);
+
+  m_icon = encode_icon(icon);
+  m_iconloaded = true;
+
+  m_modified = true;
 }
 
 
@@ -174,6 +205,10 @@ void Document::attach(QString const &path)
 {
   assert(m_exclusive);
 
+  lock_guard<mutex> lock(m_filemutex);
+
+  m_path = path;
+
   m_file.open(path.toUtf8(), ios::in | ios::out | ios::binary);
 
   if (!m_file)
@@ -186,10 +221,41 @@ void Document::detach()
 {
   assert(m_exclusive);
 
+  wait();
+
+  lock_guard<mutex> lock(m_filemutex);
+
   m_file.close();
 }
 
 
+///////////////////////// Document::wait ////////////////////////////////////
+void Document::wait()
+{
+  shared_ptr<SaveJob> job;
+
+  {
+    lock_guard<mutex> lock(m_filemutex);
+
+    job = m_saving;
+  }
+
+  if (job)
+  {
+    job->result.wait();
+  }
+}
+
+
+///////////////////////// Document::saving //////////////////////////////////
+shared_future<bool> Document::saving() const
+{
+  lock_guard<mutex> lock(m_filemutex);
+
+  return m_saving ? m_saving->result : shared_future<bool>();
+}
+
+
 ///////////////////////// Document::read ////////////////////////////////////
 size_t Document::read(uint64_t position, void *buffer, size_t bytes)
 {
@@ -218,11 +284,7 @@ size_t Document::read(uint64_t position, void *buffer, size_t bytes)
       block.index = index;
       block.modified = false;
 
-      m_file.clear();
-      m_file.seekg(index * blocksize);
-      m_file.read((char*)block.data, blocksize);
-
-      block.size = m_file.gcount();
+      load(block);
 
       blk = m_blocks.insert({ index, block }).first;
 
@@ -279,13 +341,11 @@ size_t Document::write(uint64_t position, void const *buffer, size_t bytes)
       block.index = index;
       block.modified = true;
 
-      m_file.clear();
-      m_file.seekg(index * blocksize);
-      m_file.read((char*)block.data, blocksize);
-
-      block.size = m_file.gcount();
+      load(block);
 
       blk = m_blocks.insert({ index, block }).first;
+
+      m_dirtyblocks += 1;
     }
 
     if (!blk->second.modified)
@@ -293,6 +353,8 @@ size_t Document::write(uint64_t position, void const *buffer, size_t bytes)
       blk->second.modified = true;
       m_lru.erase(blk->second.lrunode);
       blk->second.lrunode = std::list<Block*>::iterator();
+
+      m_dirtyblocks += 1;
     }
 
     memcpy(blk->second.data + offset, buffer, size);
@@ -303,6 +365,11 @@ size_t Document::write(uint64_t position, void const *buffer, size_t bytes)
     position += size;
     buffer = (char*)buffer + size;
     writebytes += size;
+
+    if (m_dirtyblocks > MaxDirtyBlocks)
+    {
+      spill();
+    }
   }
 
   m_modified = true;
@@ -316,24 +383,151 @@ void Document::discard()
 {
   assert(m_exclusive);
 
+  emit about_to_discard();
+
+  wait();
+
   SyncLock lock(m_mutex);
 
   m_lru.clear();
   m_blocks.clear();
-  m_metadata = read_asset_json(m_file, 0);
+  m_journal.clear();
+  m_journalfile.reset();
+  m_journalsize = 0;
+  m_dirtyblocks = 0;
+
+  {
+    lock_guard<mutex> lock(m_filemutex);
+
+    m_saving = nullptr;
+    m_metadata = read_asset_metadata(m_file);
+  }
+
+  m_icon.clear();
+  m_iconloaded = false;
+
   m_modified = false;
 }
 
 
+///////////////////////// Document::load ////////////////////////////////////
+void Document::load(Block &block)
+{
+  constexpr size_t blocksize = sizeof(Document::Block::data);
+
+  auto spill = m_journal.find(block.index);
+
+  if (spill != m_journal.end())
+  {
+    m_journalfile->seek(spill->second.offset);
+    m_journalfile->read((char*)block.data, spill->second.size);
+
+    block.size = spill->second.size;
+
+    return;
+  }
+
+  lock_guard<mutex> lock(m_filemutex);
+
+  if (m_saving && m_saving->lookup(block.index, block))
+    return;
+
+  m_file.clear();
+  m_file.seekg(block.index * blocksize);
+  m_file.read((char*)block.data, blocksize);
+
+  block.size = m_file.gcount();
+}
+
+
+///////////////////////// Document::spill ///////////////////////////////////
+void Document::spill()
+{
+  assert(m_exclusive);
+
+  constexpr size_t blocksize = sizeof(Document::Block::data);
+
+  if (!m_journalfile)
+  {
+    m_journalfile = make_unique<QTemporaryFile>(QDir::temp().filePath("datumstudio.XXXXXX.journal"));
+
+    if (!m_journalfile->open())
+      throw runtime_error("Error Creating Document Journal");
+  }
+
+  for(auto blk = m_blocks.begin(); blk != m_blocks.end(); )
+  {
+    auto &block = blk->second;
+
+    if (block.modified)
+    {
+      auto spill = m_journal.find(block.index);
+
+      if (spill == m_journal.end())
+      {
+        spill = m_journal.insert({ block.index, { m_journalsize, 0 } }).first;
+
+        m_journalsize += blocksize;
+      }
+
+      spill->second.size = block.size;
+
+      m_journalfile->seek(spill->second.offset);
+
+      if (m_journalfile->write((char*)block.data, blocksize) != (qint64)blocksize)
+        throw runtime_error("Error Writing Document Journal");
+
+      blk = m_blocks.erase(blk);
+    }
+    else
+      ++blk;
+  }
+
+  m_dirtyblocks = 0;
+}
+
+
 ///////////////////////// Document::save ////////////////////////////////////
 void Document::save()
 {
   assert(m_exclusive);
 
-  m_file.clear();
-  m_file.seekg(0);
+  emit about_to_save();
+
+  // one save in flight per document, others overlap freely
+
+  wait();
+
+  auto job = make_shared<SaveJob>();
+
+  {
+    SyncLock lock(m_mutex);
+
+    if (!m_iconloaded)
+    {
+      lock_guard<mutex> lock(m_filemutex);
+
+      m_icon = read_asset_icon(m_file);
+      m_iconloaded = true;
+    }
+
+    job->metadata = m_metadata;
+
+    if (m_icon != "")
+      job->metadata["icon"] = m_icon;
+  }
+
+  // metadata that outgrew its block moves the assets down behind a larger
+  // one, through the blocks so the snapshot below carries the new layout
+
+  job->headersize = asset_header_size(this);
+
+  if (asset_header_size(job->metadata) > job->headersize)
+  {
+    job->headersize = relocate_assets(this, job->metadata);
+  }
 
-  write_asset_header(m_file, m_metadata);
+  job->result = job->promise.get_future().share();
 
   for(auto &blk : m_blocks)
   {
@@ -341,15 +535,198 @@ void Document::save()
 
     if (block.modified)
     {
-      m_file.seekg(block.index * sizeof(Document::Block::data));
-      m_file.write((char*)block.data, block.size);
+      job->blocks.insert({ block.index, block });
 
       block.modified = false;
       block.lrunode = m_lru.insert(m_lru.end(), &block);
     }
   }
 
+  while (m_lru.size() > MaxCacheBlocks)
+  {
+    m_blocks.erase(m_lru.front()->index);
+
+    m_lru.pop_front();
+  }
+
+  job->journal = std::move(m_journal);
+  job->journalfile = std::move(m_journalfile);
+
+  m_journal.clear();
+  m_journalsize = 0;
+  m_dirtyblocks = 0;
+
+  {
+    lock_guard<mutex> lock(m_filemutex);
+
+    job->base = m_saving;
+
+    m_saving = job;
+  }
+
   m_modified = false;
+
+  Studio::WorkQueue::instance()->push([=]() { commit(job); }, Studio::WorkQueue::Priority::Interactive);
+}
+
+
+///////////////////////// Document::commit //////////////////////////////////
+void Document::commit(shared_ptr<SaveJob> const &job)
+{
+  constexpr size_t blocksize = sizeof(Document::Block::data);
+  constexpr size_t maxrunbytes = 1024*1024;
+
+  bool result = false;
+
+  try
+  {
+    ifstream fin(m_path.toUtf8(), ios::binary | ios::ate);
+
+    if (!fin)
+      throw runtime_error("Unable to read document");
+
+    size_t count = max<size_t>((static_cast<size_t>(fin.tellg()) + blocksize - 1) / blocksize, job->extent());
+
+    // the header is rewritten at the size save settled on, asset offsets
+    // follow it
+
+    ostringstream header;
+
+    write_asset_header(header, job->metadata, job->headersize);
+
+    auto headerbytes = header.str();
+
+    QSaveFile fout(m_path);
+
+    if (!fout.open(QIODevice::WriteOnly))
+      throw runtime_error("Unable to create save file");
+
+    // whole file in order, unchanged ranges copied from the original
+
+    vector<char> run;
+
+    Block block = {};
+
+    for(size_t index = 0; index < count; ++index)
+    {
+      if (!job->lookup(index, block))
+      {
+        fin.clear();
+        fin.seekg(index * blocksize);
+        fin.read((char*)block.data, blocksize);
+
+        block.size = fin.gcount();
+
+        if (block.size < blocksize && index + 1 < count)
+        {
+          memset(block.data + block.size, 0, blocksize - block.size);
+
+          block.size = blocksize;
+        }
+      }
+
+      if (index * blocksize < headerbytes.size())
+      {
+        auto offset = index * blocksize;
+        auto bytes = min(blocksize, headerbytes.size() - offset);
+
+        memcpy(block.data, headerbytes.data() + offset, bytes);
+
+        block.size = max(block.size, bytes);
+      }
+
+      run.insert(run.end(), (char*)block.data, (char*)block.data + block.size);
+
+      if (run.size() >= maxrunbytes || index + 1 == count)
+      {
+        if (fout.write(run.data(), run.size()) != (qint64)run.size())
+          throw runtime_error("Error writing save file");
+
+        run.clear();
+
+        emit save_progress(100 * (index + 1) / count);
+      }
+    }
+
+    fin.close();
+
+    lock_guard<mutex> lock(m_filemutex);
+
+    m_file.close();
+
+    // flushes, syncs and renames over the original
+
+    result = fout.commit();
+
+    m_file.open(m_path.toUtf8(), ios::in | ios::out | ios::binary);
+
+    if (result)
+    {
+      m_saving = nullptr;
+    }
+  }
+  catch(exception &e)
+  {
+    qCritical() << "Save Error:" << m_path << e.what();
+  }
+
+  if (!result)
+  {
+    qCritical() << "Save Failed:" << m_path;
+
+    m_modified = true;
+  }
+
+  emit save_complete(result);
+
+  job->promise.set_value(result);
+}
+
+
+///////////////////////// SaveJob::lookup ///////////////////////////////////
+bool Document::SaveJob::lookup(size_t index, Block &block)
+{
+  auto blk = blocks.find(index);
+
+  if (blk != blocks.end())
+  {
+    memcpy(block.data, blk->second.data, blk->second.size);
+
+    block.size = blk->second.size;
+
+    return true;
+  }
+
+  auto spill = journal.find(index);
+
+  if (spill != journal.end())
+  {
+    lock_guard<mutex> lock(journalmutex);
+
+    journalfile->seek(spill->second.offset);
+    journalfile->read((char*)block.data, spill->second.size);
+
+    block.size = spill->second.size;
+
+    return true;
+  }
+
+  return base && base->lookup(index, block);
+}
+
+
+///////////////////////// SaveJob::extent ///////////////////////////////////
+size_t Document::SaveJob::extent() const
+{
+  size_t count = base ? base->extent() : 0;
+
+  if (!blocks.empty())
+    count = max(count, blocks.rbegin()->first + 1);
+
+  if (!journal.empty())
+    count = max(count, journal.rbegin()->first + 1);
+
+  return count;
 }
 
 
@@ -403,6 +780,7 @@ void Document::unlock_exclusive(bool changed)
 ///////////////////////// DocumentManager::Constructor //////////////////////
 DocumentManager::DocumentManager()
 {
+  m_batchdepth = 0;
 }
 
 
@@ -413,20 +791,47 @@ Document *DocumentManager::open(QString const &path)
 
   try
   {
+    shared_future<bool> closing;
+
+    {
+      SyncLock lock(m_mutex);
+
+      if (auto doc = m_paths.value(path))
+      {
+        doc->refcount += 1;
+
+        return doc->document;
+      }
+
+      closing = m_closing.value(path).second;
+    }
+
+    // a closed copy may still be saving over the file
+
+    if (closing.valid())
+      closing.wait();
+
+    // constructed unlocked so separate documents open in parallel, the
+    // loser of a race on the same path is dropped
+
+    unique_ptr<Document> document(new Document(path));
+
+    document->moveToThread(thread());
+
     SyncLock lock(m_mutex);
 
-    auto doc = find_if(m_documents.begin(), m_documents.end(), [&](auto &doc) { return doc.path == path; });
+    auto doc = m_paths.value(path);
 
-    if (doc == m_documents.end())
+    if (!doc)
     {
-      DocInfo docinfo;
-      docinfo.path = path;
-      docinfo.document = new Document(path);
-      docinfo.refcount = 0;
+      doc = &m_documents[document.get()];
+      doc->path = path;
+      doc->document = document.release();
+      doc->refcount = 0;
 
-      doc = m_documents.insert(m_documents.end(), docinfo);
+      m_paths.insert(path, doc);
 
-      connect(docinfo.document, &Document::document_changed, this, [this,document=docinfo.document,path]() { emit document_changed(document, path); });
+      connect(doc->document, &Document::document_changed, this, [this,document=doc->document,path]() { if (!notify({ document, path, path })) emit document_changed(document, path); });
     }
 
     doc->refcount += 1;
@@ -464,46 +869,102 @@ Document *DocumentManager::dup(Studio::Document *document)
 {
   SyncLock lock(m_mutex);
 
-  auto doc = find_if(m_documents.begin(), m_documents.end(), [&](auto &doc) { return doc.document == document; });
+  auto doc = m_documents.find(document);
 
   assert(doc != m_documents.end());
 
-  doc->refcount += 1;
+  doc->second.refcount += 1;
 
-  return doc->document;
+  return doc->second.document;
 }
 
 
 ///////////////////////// DocumentManager::close ////////////////////////////
 void DocumentManager::close(Studio::Document *document)
 {
-  SyncLock lock(m_mutex);
+  Document *closed = nullptr;
 
-  auto doc = find_if(m_documents.begin(), m_documents.end(), [&](auto &doc) { return doc.document == document; });
+  QString path;
+  shared_future<bool> saving;
 
-  assert(doc != m_documents.end());
+  {
+    SyncLock lock(m_mutex);
+
+    auto doc = m_documents.find(document);
+
+    assert(doc != m_documents.end());
 
-  doc->refcount -= 1;
+    doc->second.refcount -= 1;
+
+    if (doc->second.refcount == 0)
+    {
+      closed = doc->second.document;
+      path = doc->second.path;
+      saving = closed->saving();
+
+      if (saving.valid())
+        m_closing.insert(path, { closed, saving });
+
+      m_paths.remove(path);
+
+      m_documents.erase(doc);
+    }
+  }
+
+  if (!closed)
+    return;
+
+  // changes held by an open batch must not outlive the document, they
+  // report it as not open instead
 
-  if (doc->refcount == 0)
   {
-    delete doc->document;
+    lock_guard<mutex> lock(m_batchmutex);
 
-    m_documents.erase(doc);
+    for(auto &change : m_changes)
+    {
+      if (change.document == closed)
+        change.document = nullptr;
+    }
   }
+
+  // destroying a document waits for its save, which rewrites the whole
+  // file. a save still in flight is waited on from the work queue (behind
+  // the interactive commit) and the document goes once it lands
+
+  if (!saving.valid())
+  {
+    delete closed;
+
+    return;
+  }
+
+  Studio::WorkQueue::instance()->push([=]() {
+
+    saving.wait();
+
+    {
+      SyncLock lock(m_mutex);
+
+      if (m_closing.value(path).first == closed)
+        m_closing.remove(path);
+    }
+
+    closed->deleteLater();
+
+  }, Studio::WorkQueue::Priority::Background);
 }
 
 
-///////////////////////// DocumentManager::rewrite //////////////////////////
+///////////////////////// DocumentManager::path /////////////////////////////
 QString DocumentManager::path(Studio::Document *document) const
 {
   SyncLock lock(m_mutex);
 
-  auto doc = find_if(m_documents.begin(), m_documents.end(), [&](auto &doc) { return doc.document == document; });
+  auto doc = m_documents.find(document);
 
   assert(doc != m_documents.end());
 
-  return doc->path;
+  return doc->second.path;
 }
 
 
@@ -514,30 +975,36 @@ bool DocumentManager::rename(Studio::Document *document, QString const &dst)
 
   bool result = false;
 
-  auto doc = find_if(m_documents.begin(), m_documents.end(), [&](auto &doc) { return doc.document == document; });
+  auto doc = m_documents.find(document);
 
   assert(doc != m_documents.end());
 
-  QString src = doc->path;
+  auto &docinfo = doc->second;
+
+  QString src = docinfo.path;
 
-  doc->document->lock_exclusive();
+  docinfo.document->lock_exclusive();
 
   try
   {
-    doc->document->detach();
+    docinfo.document->detach();
 
     if (QFile::rename(src, dst))
     {
-      disconnect(doc->document, &Document::document_changed, this, 0);
+      disconnect(docinfo.document, &Document::document_changed, this, 0);
+
+      m_paths.remove(src);
+
+      docinfo.path = dst;
 
-      doc->path = dst;
+      m_paths.insert(dst, &docinfo);
 
-      connect(doc->document, &Document::document_changed, this, [this,document=doc->document,path=doc->path]() { emit document_changed(document, path); });
+      connect(docinfo.document, &Document::document_changed, this, [this,document=docinfo.document,path=docinfo.path]() { if (!notify({ document, path, path })) emit document_changed(document, path); });
 
       result = true;
     }
 
-    doc->document->attach(doc->path);
+    docinfo.document->attach(docinfo.path);
   }
   catch(exception &e)
   {
@@ -548,9 +1015,9 @@ bool DocumentManager::rename(Studio::Document *document, QString const &dst)
 
   document->unlock_exclusive(false);
 
-  if (result)
+  if (result && !notify({ document, src, dst }))
   {
-    emit document_renamed(doc->document, src, dst);
+    emit document_renamed(document, src, dst);
   }
 
   return result;
@@ -564,27 +1031,29 @@ bool DocumentManager::rewrite(Studio::Document *document, QString const &src)
 
   bool result = false;
 
-  auto doc = find_if(m_documents.begin(), m_documents.end(), [&](auto &doc) { return doc.document == document; });
+  auto doc = m_documents.find(document);
 
   assert(doc != m_documents.end());
 
-  doc->document->lock_exclusive();
+  auto &docinfo = doc->second;
+
+  docinfo.document->lock_exclusive();
 
   try
   {
-    doc->document->detach();
+    docinfo.document->detach();
 
-    if (QFile::remove(doc->path))
+    if (QFile::remove(docinfo.path))
     {
-      if (QFile::rename(src, doc->path))
+      if (QFile::rename(src, docinfo.path))
       {
         result = true;
       }
     }
 
-    doc->document->attach(doc->path);
+    docinfo.document->attach(docinfo.path);
 
-    doc->document->discard();
+    docinfo.document->discard();
   }
   catch(exception &e)
   {
@@ -597,3 +1066,75 @@ bool DocumentManager::rewrite(Studio::Document *document, QString const &src)
 
   return result;
 }
+
+
+///////////////////////// DocumentManager::remove ///////////////////////////
+bool DocumentManager::remove(QString const &path)
+{
+  Studio::Document *document = nullptr;
+
+  {
+    SyncLock lock(m_mutex);
+
+    if (auto doc = m_paths.value(path))
+      document = doc->document;
+  }
+
+  // an open document keeps its handle, it is only the file that goes
+
+  if (!QFile::remove(path))
+    return false;
+
+  if (!notify({ document, path, QString() }))
+  {
+    emit documents_changed({ { document, path, QString() } });
+  }
+
+  return true;
+}
+
+
+///////////////////////// DocumentManager::begin_batch //////////////////////
+void DocumentManager::begin_batch()
+{
+  lock_guard<mutex> lock(m_batchmutex);
+
+  m_batchdepth += 1;
+}
+
+
+///////////////////////// DocumentManager::end_batch ////////////////////////
+void DocumentManager::end_batch()
+{
+  QVector<Change> changes;
+
+  {
+    lock_guard<mutex> lock(m_batchmutex);
+
+    assert(m_batchdepth > 0);
+
+    if (--m_batchdepth != 0)
+      return;
+
+    swap(changes, m_changes);
+  }
+
+  if (!changes.isEmpty())
+  {
+    emit documents_changed(changes);
+  }
+}
+
+
+///////////////////////// DocumentManager::notify ///////////////////////////
+bool DocumentManager::notify(Change const &change)
+{
+  lock_guard<mutex> lock(m_batchmutex);
+
+  if (m_batchdepth == 0)
+    return false;
+
+  m_changes.push_back(change);
+
+  return true;
+}
@@ -11,7 +11,13 @@
 #include "api.h"
 #include "documentapi.h"
 #include <leap/threadcontrol.h>
+#include <QTemporaryFile>
+#include <QHash>
+#include <unordered_map>
 #include <fstream>
+#include <memory>
+#include <future>
+#include <mutex>
 
 //-------------------------- Document ---------------------------------------
 //---------------------------------------------------------------------------
@@ -25,6 +31,7 @@ class Document : public Studio::Document
 
   public:
     Document(QString const &path);
+    ~Document();
 
     QString type() const;
 
@@ -61,15 +68,25 @@ class Document : public Studio::Document
     void attach(QString const &path);
     void detach();
 
+    void wait();
+
+    std::shared_future<bool> saving() const;
+
   private:
 
-    bool m_modified;
+    std::atomic<bool> m_modified;
 
     QJsonObject m_metadata;
 
+    // icon is left in the file until first asked for
+
+    mutable bool m_iconloaded;
+    mutable QString m_icon;
+
   private:
 
     static constexpr int MaxCacheBlocks = 64;
+    static constexpr int MaxDirtyBlocks = 4096;
 
     struct Block
     {
@@ -85,6 +102,63 @@ class Document : public Studio::Document
     std::list<Block*> m_lru;
     std::map<size_t, Block> m_blocks;
 
+    void load(Block &block);
+
+    void spill();
+
+    // modified blocks beyond MaxDirtyBlocks are spilled to a journal file
+    // until save, each block keeps its journal slot once assigned
+
+    struct Spill
+    {
+      uint64_t offset;
+      size_t size;
+    };
+
+    int m_dirtyblocks;
+
+    std::map<size_t, Spill> m_journal;
+
+    uint64_t m_journalsize;
+
+    std::unique_ptr<QTemporaryFile> m_journalfile;
+
+  private:
+
+    // a save snapshots the dirty blocks and journal and hands them to a
+    // background job that streams the whole file to a temporary, syncs and
+    // renames it over the original. until that lands (or if it fails) the
+    // snapshot is consulted ahead of the file, a failed snapshot is chained
+    // under the next one
+
+    struct SaveJob
+    {
+      QJsonObject metadata;
+      uint64_t headersize;
+
+      std::map<size_t, Block> blocks;
+
+      std::map<size_t, Spill> journal;
+      std::unique_ptr<QTemporaryFile> journalfile;
+
+      std::shared_ptr<SaveJob> base;
+
+      bool lookup(size_t index, Block &block);
+
+      size_t extent() const;
+
+      std::promise<bool> promise;
+      std::shared_future<bool> result;
+
+      std::mutex journalmutex;
+    };
+
+    void commit(std::shared_ptr<SaveJob> const &job);
+
+    QString m_path;
+
+    std::shared_ptr<SaveJob> m_saving;
+
 #ifndef NDEBUG
     std::atomic<int> m_locked{0};
     std::atomic<int> m_exclusive{0};
@@ -92,6 +166,8 @@ class Document : public Studio::Document
 
     std::fstream m_file;
 
+    mutable std::mutex m_filemutex;
+
     leap::threadlib::ReadWriteLock m_lock;
 
     mutable leap::threadlib::SpinLock m_mutex;
@@ -121,6 +197,11 @@ class DocumentManager : public Studio::DocumentManager
 
     bool rewrite(Studio::Document *document, QString const &src);
 
+    bool remove(QString const &path);
+
+    void begin_batch();
+    void end_batch();
+
   private:
 
     struct DocInfo
@@ -132,7 +213,24 @@ class DocumentManager : public Studio::DocumentManager
       int refcount;
     };
 
-    std::vector<DocInfo> m_documents;
+    std::unordered_map<Studio::Document*, DocInfo> m_documents;
+
+    QHash<QString, DocInfo*> m_paths;
+
+    // closed documents whose save is still landing, a reopen of the path
+    // waits for it
+
+    QHash<QString, std::pair<Document*, std::shared_future<bool>>> m_closing;
 
     mutable leap::threadlib::CriticalSection m_mutex;
+
+  private:
+
+    bool notify(Change const &change);
+
+    int m_batchdepth;
+
+    QVector<Change> m_changes;
+
+    std::mutex m_batchmutex;
 };
@@ -63,6 +63,7 @@ EditorView::EditorView(QWidget *parent)
   auto documentmanager = Studio::Core::instance()->find_object<Studio::DocumentManager>();
 
   connect(documentmanager, &Studio::DocumentManager::document_renamed, this, &EditorView::on_document_renamed);
+  connect(documentmanager, &Studio::DocumentManager::documents_changed, this, &EditorView::on_documents_changed);
 }
 
 
@@ -207,6 +208,19 @@ void EditorView::on_document_renamed(Studio::Document *document, QString src, QS
 }
 
 
+///////////////////////// EditorView::documents_changed /////////////////////
+void EditorView::on_documents_changed(QVector<Studio::DocumentManager::Change> const &changes)
+{
+  for(auto &change : changes)
+  {
+    if (change.document && change.dst != "" && change.dst != change.src)
+    {
+      on_document_renamed(change.document, change.src, change.dst);
+    }
+  }
+}
+
+
 ///////////////////////// EditorView::save_editor ///////////////////////////
 int EditorView::save_editor(int index)
 {
@@ -43,6 +43,7 @@ class EditorView : public QWidget
     void on_doclist_changed();
 
     void on_document_renamed(Studio::Document *document, QString src, QString dst);
+    void on_documents_changed(QVector<Studio::DocumentManager::Change> const &changes);
 
     int save_editor(int index);
     int close_editor(int index);
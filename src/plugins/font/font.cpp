@@ -8,6 +8,7 @@
 
 #include "font.h"
 #include "assetfile.h"
+#include "trace.h"
 #include "atlaspacker.h"
 #include <QPainter>
 #include <QJsonDocument>
@@ -38,9 +39,17 @@ namespace
 
     memcpy(payload.data(), atlas.bits(), atlas.byteCount());
 
-    image_buildmips_srgb(width, height, layers, levels, payload.data());
+    {
+      Studio::TraceScope trace("mips");
+
+      image_buildmips_srgb(width, height, layers, levels, payload.data());
+    }
 
-    write_imag_asset(fout, id, width, height, layers, levels, PackImageHeader::rgba, payload.data());
+    {
+      Studio::TraceScope trace("write");
+
+      write_imag_asset(fout, id, width, height, layers, levels, PackImageHeader::rgba, payload.data());
+    }
 
     return id + 1;
   }
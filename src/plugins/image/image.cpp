@@ -8,6 +8,7 @@
 
 #include "image.h"
 #include "assetfile.h"
+#include "trace.h"
 #include <functional>
 #include <cassert>
 
@@ -110,8 +111,10 @@ void ImageDocument::attach(Studio::Document *document)
 
 
 ///////////////////////// data //////////////////////////////////////////////
-HDRImage ImageDocument::data(long flags) const
+HDRImage ImageDocument::data(long flags, int maxsize) const
 {
+  Studio::TraceScope trace("decode");
+
   HDRImage image = {};
 
   if (m_document)
@@ -126,29 +129,40 @@ HDRImage ImageDocument::data(long flags) const
 
       read_asset_payload(m_document, imag.dataoffset, payload.data(), payload.size());
 
-      image.width = imag.width;
-      image.height = imag.height;
+      int stride = 1;
+
+      if (maxsize > 0)
+        stride = max<int>((max(imag.width, imag.height) + maxsize - 1) / maxsize, 1);
+
+      image.width = (imag.width + stride - 1) / stride;
+      image.height = (imag.height + stride - 1) / stride;
       image.bits.resize(image.width * image.height);
 
-      uint32_t *src = (uint32_t*)payload.data();
+      auto dst = image.bits.begin();
 
-      for(size_t i = 0; i < image.bits.size(); ++i)
+      for(int y = 0; y < image.height; ++y)
       {
-        switch(imag.format)
-        {
-          case PackImageHeader::rgba:
-            image.bits[i] = (flags & srgb) ? srgba(*src) : rgba(*src);
-            break;
+        uint32_t *src = (uint32_t*)payload.data() + y * stride * imag.width;
 
-          case PackImageHeader::rgbe:
-            image.bits[i] = rgbe(*src);
-            break;
-
-          default:
-            assert(false);
+        for(int x = 0; x < image.width; ++x)
+        {
+          switch(imag.format)
+          {
+            case PackImageHeader::rgba:
+              *dst = (flags & srgb) ? srgba(*src) : rgba(*src);
+              break;
+
+            case PackImageHeader::rgbe:
+              *dst = rgbe(*src);
+              break;
+
+            default:
+              assert(false);
+          }
+
+          src += stride;
+          ++dst;
         }
-
-        ++src;
       }
     }
 
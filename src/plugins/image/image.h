@@ -46,7 +46,9 @@ class ImageDocument : public QObject
       srgb = 0x01
     };
 
-    HDRImage data(long flags = srgb) const;
+    // maxsize > 0 point samples down to at most maxsize texels per side
+
+    HDRImage data(long flags = srgb, int maxsize = 0) const;
 
   signals:
 
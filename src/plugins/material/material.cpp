@@ -9,6 +9,9 @@
 #include "material.h"
 #include "image.h"
 #include "assetfile.h"
+#include "definition.h"
+#include "hashcache.h"
+#include "trace.h"
 #include <QPainter>
 #include <QJsonDocument>
 #include <functional>
@@ -42,6 +45,8 @@ namespace
 
   HDRImage normalmap_from_image(HDRImage const &src, float strength = 1.0f)
   {
+    Studio::TraceScope trace("process");
+
     HDRImage normalmap(src.width, src.height);
 
     for(int y = 0; y < src.height; ++y)
@@ -102,16 +107,20 @@ namespace
       }
     }
 
-    if (cutout)
     {
-      image_buildmips_srgb_a(0.5, width, height, layers, levels, payload.data());
+      Studio::TraceScope trace("mips");
+
+      if (cutout)
+        image_buildmips_srgb_a(0.5, width, height, layers, levels, payload.data());
+      else
+        image_buildmips_srgb(width, height, layers, levels, payload.data());
     }
-    else
+
     {
-      image_buildmips_srgb(width, height, layers, levels, payload.data());
-    }
+      Studio::TraceScope trace("write");
 
-    write_imag_asset(fout, id, width, height, layers, levels, PackImageHeader::rgba, payload.data());
+      write_imag_asset(fout, id, width, height, layers, levels, PackImageHeader::rgba, payload.data());
+    }
 
     return id + 1;
   }
@@ -138,9 +147,17 @@ namespace
       }
     }
 
-    image_buildmips_rgb(width, height, layers, levels, payload.data());
+    {
+      Studio::TraceScope trace("mips");
 
-    write_imag_asset(fout, id, width, height, layers, levels, PackImageHeader::rgba, payload.data());
+      image_buildmips_rgb(width, height, layers, levels, payload.data());
+    }
+
+    {
+      Studio::TraceScope trace("write");
+
+      write_imag_asset(fout, id, width, height, layers, levels, PackImageHeader::rgba, payload.data());
+    }
 
     return id + 1;
   }
@@ -167,9 +184,17 @@ namespace
       }
     }
 
-    image_buildmips_rgb(width, height, layers, levels, payload.data());
+    {
+      Studio::TraceScope trace("mips");
+
+      image_buildmips_rgb(width, height, layers, levels, payload.data());
+    }
+
+    {
+      Studio::TraceScope trace("write");
 
-    write_imag_asset(fout, id, width, height, layers, levels, PackImageHeader::rgba, payload.data());
+      write_imag_asset(fout, id, width, height, layers, levels, PackImageHeader::rgba, payload.data());
+    }
 
     return id + 1;
   }
@@ -207,70 +232,54 @@ void MaterialDocument::create(string const &path, Color4 const &color, float met
 ///////////////////////// hash //////////////////////////////////////////////
 void MaterialDocument::hash(Studio::Document *document, size_t *key)
 {
-  QJsonObject definition;
-
-  document->lock();
+  *key = HashCache::instance()->hash(document, "hash", [&](QStringList &dependencies) {
 
-  PackTextHeader text;
+    auto definition = DefinitionCache::instance()->read(document);
 
-  if (read_asset_header(document, 1, &text))
-  {
-    QByteArray payload(pack_payload_size(text), 0);
-
-    read_asset_payload(document, text.dataoffset, payload.data(), payload.size());
-
-    definition = QJsonDocument::fromBinaryData(payload).object();
-  }
+    size_t seed = std::hash<double>{}(document->metadata("build", 0.0));
 
-  document->unlock();
+    for(auto &name : ImageNames)
+    {
+      dependencies.push_back(fullpath(document, definition[name].toString()));
 
-  *key = std::hash<double>{}(document->metadata("build", 0.0));
+      hash_combine(seed, image_hash(dependencies.back()));
+    }
 
-  for(auto &name : ImageNames)
-  {
-    hash_combine(*key, image_hash(fullpath(document, definition[name].toString())));
-  }
+    return seed;
+  });
 }
 
 
 ///////////////////////// hash //////////////////////////////////////////////
 void MaterialDocument::build_hash(Studio::Document *document, size_t *key)
 {
-  QJsonObject definition;
-
-  document->lock();
+  *key = HashCache::instance()->hash(document, "build_hash", [&](QStringList &dependencies) {
 
-  PackTextHeader text;
+    auto definition = DefinitionCache::instance()->read(document);
 
-  if (read_asset_header(document, 1, &text))
-  {
-    QByteArray payload(pack_payload_size(text), 0);
-
-    read_asset_payload(document, text.dataoffset, payload.data(), payload.size());
-
-    definition = QJsonDocument::fromBinaryData(payload).object();
-  }
+    size_t seed = 0;
 
-  document->unlock();
+    hash_combine(seed, std::hash<int>{}(definition["albedooutput"].toInt(0)));
+    hash_combine(seed, std::hash<int>{}(definition["metalnessoutput"].toInt(0)));
+    hash_combine(seed, std::hash<int>{}(definition["roughnessoutput"].toInt(3)));
+    hash_combine(seed, std::hash<int>{}(definition["reflectivityoutput"].toInt(1)));
+    hash_combine(seed, std::hash<int>{}(definition["normaloutput"].toInt(0)));
+    hash_combine(seed, std::hash<double>{}(definition["normalscale"].toDouble(1.0)));
 
-  *key = 0;
+    for(auto &name : ImageNames)
+    {
+      dependencies.push_back(fullpath(document, definition[name].toString()));
 
-  hash_combine(*key, std::hash<int>{}(definition["albedooutput"].toInt(0)));
-  hash_combine(*key, std::hash<int>{}(definition["metalnessoutput"].toInt(0)));
-  hash_combine(*key, std::hash<int>{}(definition["roughnessoutput"].toInt(3)));
-  hash_combine(*key, std::hash<int>{}(definition["reflectivityoutput"].toInt(1)));
-  hash_combine(*key, std::hash<int>{}(definition["normaloutput"].toInt(0)));
-  hash_combine(*key, std::hash<double>{}(definition["normalscale"].toDouble(1.0)));
+      hash_combine(seed, image_hash(dependencies.back()));
+    }
 
-  for(auto &name : ImageNames)
-  {
-    hash_combine(*key, image_hash(fullpath(document, definition[name].toString())));
-  }
+    return seed;
+  });
 }
 
 
 ///////////////////////// build /////////////////////////////////////////////
-void MaterialDocument::build(Studio::Document *document, string const &path)
+void MaterialDocument::build(Studio::Document *document, string const &path, int maxsize)
 {
   auto materialdocument = MaterialDocument(document);
 
@@ -282,11 +291,11 @@ void MaterialDocument::build(Studio::Document *document, string const &path)
 
   if (materialdocument.image(MaterialDocument::Image::AlbedoMap))
   {
-    auto albedomap = ImageDocument(materialdocument.image(MaterialDocument::Image::AlbedoMap)).data();
+    auto albedomap = ImageDocument(materialdocument.image(MaterialDocument::Image::AlbedoMap)).data(ImageDocument::srgb, maxsize);
 
     if (materialdocument.image(MaterialDocument::Image::AlbedoMask))
     {
-      auto albedomask = ImageDocument(materialdocument.image(MaterialDocument::Image::AlbedoMask)).data();
+      auto albedomask = ImageDocument(materialdocument.image(MaterialDocument::Image::AlbedoMask)).data(ImageDocument::srgb, maxsize);
 
       if (albedomask.width != albedomap.width || albedomask.height != albedomap.height)
         throw runtime_error("Material build failed - albedo mask size mismatch");
@@ -303,9 +312,9 @@ void MaterialDocument::build(Studio::Document *document, string const &path)
 
   if (materialdocument.image(MaterialDocument::Image::MetalnessMap) || materialdocument.image(MaterialDocument::Image::RoughnessMap) || materialdocument.image(MaterialDocument::Image::ReflectivityMap))
   {
-    auto metalnessmap = ImageDocument(materialdocument.image(MaterialDocument::Image::MetalnessMap)).data(ImageDocument::raw);
-    auto roughnessmap = ImageDocument(materialdocument.image(MaterialDocument::Image::RoughnessMap)).data(ImageDocument::raw);
-    auto reflectivitymap = ImageDocument(materialdocument.image(MaterialDocument::Image::ReflectivityMap)).data(ImageDocument::raw);
+    auto metalnessmap = ImageDocument(materialdocument.image(MaterialDocument::Image::MetalnessMap)).data(ImageDocument::raw, maxsize);
+    auto roughnessmap = ImageDocument(materialdocument.image(MaterialDocument::Image::RoughnessMap)).data(ImageDocument::raw, maxsize);
+    auto reflectivitymap = ImageDocument(materialdocument.image(MaterialDocument::Image::ReflectivityMap)).data(ImageDocument::raw, maxsize);
 
     HDRImage surfacemap;
     surfacemap.width = max({ metalnessmap.width, roughnessmap.width, reflectivitymap.width });
@@ -464,7 +473,7 @@ void MaterialDocument::build(Studio::Document *document, string const &path)
 
   if (materialdocument.image(MaterialDocument::Image::NormalMap))
   {
-    auto normalmap = ImageDocument(materialdocument.image(MaterialDocument::Image::NormalMap)).data(ImageDocument::raw);
+    auto normalmap = ImageDocument(materialdocument.image(MaterialDocument::Image::NormalMap)).data(ImageDocument::raw, maxsize);
 
     switch(materialdocument.normaloutput())
     {
@@ -545,7 +554,11 @@ void MaterialDocument::pack(Studio::PackerState &asset, ofstream &fout)
 
       read_asset_payload(fin, imag.dataoffset, payload.data(), payload.size());
 
-      image_compress_bc3(imag.width, imag.height, imag.layers, imag.levels, payload.data());
+      {
+        Studio::TraceScope trace("compress");
+
+        image_compress_bc3(imag.width, imag.height, imag.layers, imag.levels, payload.data());
+      }
 
       write_imag_asset(fout, asset.id, imag.width, imag.height, imag.layers, imag.levels, PackImageHeader::rgba_bc3, payload.data());
     }
@@ -561,7 +574,11 @@ void MaterialDocument::pack(Studio::PackerState &asset, ofstream &fout)
 
       read_asset_payload(fin, imag.dataoffset, payload.data(), payload.size());
 
-      image_compress_bc3(imag.width, imag.height, imag.layers, imag.levels, payload.data());
+      {
+        Studio::TraceScope trace("compress");
+
+        image_compress_bc3(imag.width, imag.height, imag.layers, imag.levels, payload.data());
+      }
 
       write_imag_asset(fout, asset.id, imag.width, imag.height, imag.layers, imag.levels, PackImageHeader::rgba_bc3, payload.data());
     }
@@ -592,6 +609,7 @@ MaterialDocument::MaterialDocument()
   auto documentmanager = Studio::Core::instance()->find_object<Studio::DocumentManager>();
 
   connect(documentmanager, &Studio::DocumentManager::document_changed, this, &MaterialDocument::touch);
+  connect(documentmanager, &Studio::DocumentManager::documents_changed, this, [=](QVector<Studio::DocumentManager::Change> const &changes) { for(auto &change : changes) { if (change.document && change.dst == change.src) touch(change.document, change.dst); } });
 }
 
 
@@ -790,20 +808,7 @@ void MaterialDocument::set_normaloutput(MaterialDocument::NormalOutput output)
 ///////////////////////// MaterialDocument::refresh /////////////////////////
 void MaterialDocument::refresh()
 {
-  m_document->lock();
-
-  PackTextHeader text;
-
-  if (read_asset_header(m_document, 1, &text))
-  {
-    QByteArray payload(pack_payload_size(text), 0);
-
-    read_asset_payload(m_document, text.dataoffset, payload.data(), payload.size());
-
-    m_definition = QJsonDocument::fromBinaryData(payload).object();
-  }
-
-  m_document->unlock();
+  m_definition = DefinitionCache::instance()->read(m_document);
 
   auto documentmanager = Studio::Core::instance()->find_object<Studio::DocumentManager>();
 
@@ -823,20 +828,5 @@ void MaterialDocument::refresh()
 ///////////////////////// MaterialDocument::update //////////////////////////
 void MaterialDocument::update()
 {
-  QByteArray data = QJsonDocument(m_definition).toBinaryData();
-
-  m_document->lock_exclusive();
-
-  PackTextHeader text;
-
-  if (auto position = read_asset_header(m_document, 1, &text))
-  {
-    position += write_text_asset(m_document, position, 1, data.size(), data.data());
-
-    position += write_footer(m_document, position);
-
-    m_document->set_metadata("build", buildtime());
-  }
-
-  m_document->unlock_exclusive();
+  DefinitionCache::instance()->write(m_document, m_definition);
 }
@@ -28,7 +28,7 @@ class MaterialDocument : public QObject
 
     static void build_hash(Studio::Document *document, size_t *key);
 
-    static void build(Studio::Document *document, std::string const &path);
+    static void build(Studio::Document *document, std::string const &path, int maxsize = 0);
 
     static void pack(Studio::PackerState &asset, std::ofstream &fout);
 
@@ -108,6 +108,15 @@ bool MaterialPlugin::build(Studio::Document *document, QString const &path)
 }
 
 
+///////////////////////// MaterialPlugin::preview ///////////////////////////
+bool MaterialPlugin::preview(Studio::Document *document, QString const &path)
+{
+  MaterialDocument::build(document, path.toStdString(), Studio::BuildManager::PreviewSize);
+
+  return true;
+}
+
+
 ///////////////////////// MaterialPlugin::pack //////////////////////////////
 bool MaterialPlugin::pack(Studio::PackerState &asset, ofstream &fout)
 {
@@ -38,6 +38,8 @@ class MaterialPlugin : public Studio::Plugin
 
     bool build(Studio::Document *document, QString const &path);
 
+    bool preview(Studio::Document *document, QString const &path);
+
     bool pack(Studio::PackerState &asset, std::ofstream &fout);
 };
 
@@ -98,7 +98,7 @@ void MaterialView::refresh()
   {
     auto buildmanager = Studio::Core::instance()->find_object<Studio::BuildManager>();
 
-    buildmanager->request_build(m_document, this, &MaterialView::on_material_build_complete);
+    buildmanager->request_preview(m_document, this, &MaterialView::on_material_build_complete);
 
     m_buildhash = hash;
   }
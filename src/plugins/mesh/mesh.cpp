@@ -8,8 +8,10 @@
 
 #include "mesh.h"
 #include "assetfile.h"
+#include "hashcache.h"
 #include "atlaspacker.h"
 #include <functional>
+#include <map>
 
 #include <QDebug>
 
@@ -19,7 +21,10 @@ using namespace lml;
 ///////////////////////// hash //////////////////////////////////////////////
 void MeshDocument::hash(Studio::Document *document, size_t *key)
 {
-  *key = std::hash<double>{}(document->metadata("build", 0.0));
+  *key = HashCache::instance()->hash(document, "hash", [&](QStringList &dependencies) {
+
+    return std::hash<double>{}(document->metadata("build", 0.0));
+  });
 }
 
 
@@ -28,101 +33,268 @@ void MeshDocument::pack(Studio::PackerState &asset, ofstream &fout)
 {
   if (asset.index == 0)
   {
-    vector<PackVertex> vertices;
-    vector<uint32_t> indices;
-    vector<PackMeshPayload::Rig> rig;
-    vector<PackMeshPayload::Bone> bones;
-    map<string, uint32_t> bonemap;
+    auto meshdocument = MeshDocument(asset.document);
+
+    switch (meshdocument.packmode())
+    {
+      case PackMode::Merged:
+        pack_merged(asset, fout);
+        break;
 
+      case PackMode::Instanced:
+        pack_instanced(asset, fout);
+        break;
+    }
+  }
+
+  if (asset.index > 0)
+  {
     asset.document->lock();
 
-    auto meshdocument = MeshDocument(asset.document);
+    PackMeshHeader mesh;
+
+    if (read_asset_header(asset.document, asset.index, &mesh))
+    {
+      vector<char> payload(pack_payload_size(mesh));
+
+      read_asset_payload(asset.document, mesh.dataoffset, payload.data(), payload.size());
+
+      write_mesh_asset(fout, asset.id, mesh.vertexcount, mesh.indexcount, mesh.bonecount, Bound3(Vec3(mesh.mincorner[0], mesh.mincorner[1], mesh.mincorner[2]), Vec3(mesh.maxcorner[0], mesh.maxcorner[1], mesh.maxcorner[2])), payload.data());
+    }
+
+    asset.document->unlock();
+  }
+}
+
+
+///////////////////////// pack_merged ///////////////////////////////////////
+void MeshDocument::pack_merged(Studio::PackerState &asset, ofstream &fout)
+{
+  struct SubMesh
+  {
+    PackMeshHeader header;
+
+    vector<PackVertex> vertextable;
+    vector<uint32_t> indextable;
+    vector<PackMeshPayload::Rig> rigtable;
+    vector<PackMeshPayload::Bone> bonetable;
+  };
+
+  auto meshdocument = MeshDocument(asset.document);
+
+  auto instances = meshdocument.instances();
 
-    for(auto &instance : meshdocument.instances())
+  asset.document->lock();
+
+  // read each distinct submesh once
+
+  map<size_t, SubMesh> submeshes;
+
+  for(auto &instance : instances)
+  {
+    if (submeshes.find(instance.index) != submeshes.end())
+      continue;
+
+    SubMesh submesh;
+
+    if (read_asset_header(asset.document, instance.index, &submesh.header))
     {
-      PackMeshHeader mesh;
+      auto &mesh = submesh.header;
+
+      uint64_t position = mesh.dataoffset + sizeof(PackChunk);
+
+      submesh.vertextable.resize(mesh.vertexcount);
+      submesh.indextable.resize(mesh.indexcount);
 
-      if (read_asset_header(asset.document, instance.index, &mesh))
+      position += asset.document->read(position, submesh.vertextable.data(), submesh.vertextable.size() * sizeof(PackVertex));
+      position += asset.document->read(position, submesh.indextable.data(), submesh.indextable.size() * sizeof(uint32_t));
+
+      if (mesh.bonecount != 0)
       {
-        uint64_t position = mesh.dataoffset + sizeof(PackChunk);
+        submesh.rigtable.resize(mesh.vertexcount);
+        submesh.bonetable.resize(mesh.bonecount);
 
-        vector<PackVertex> vertextable(mesh.vertexcount);
+        position += asset.document->read(position, submesh.rigtable.data(), submesh.rigtable.size() * sizeof(PackMeshPayload::Rig));
+        position += asset.document->read(position, submesh.bonetable.data(), submesh.bonetable.size() * sizeof(PackMeshPayload::Bone));
+      }
+    }
 
-        position += asset.document->read(position, vertextable.data(), vertextable.size() * sizeof(PackVertex));
+    submeshes.emplace(instance.index, std::move(submesh));
+  }
 
-        vector<uint32_t> indextable(mesh.indexcount);
+  asset.document->unlock();
 
-        position += asset.document->read(position, indextable.data(), indextable.size() * sizeof(uint32_t));
+  // size output buffers up front
 
-        uint32_t base = vertices.size();
+  size_t vertexcount = 0;
+  size_t indexcount = 0;
+  bool rigged = false;
 
-        for(auto &vertex : vertextable)
-        {
-          auto position = instance.transform * Vec3(vertex.position[0], vertex.position[1], vertex.position[2]);
-          auto normal = instance.transform.rotation() * Vec3(vertex.normal[0], vertex.normal[1], vertex.normal[2]);
-          auto tangent = instance.transform.rotation() * Vec3(vertex.tangent[0], vertex.tangent[1], vertex.tangent[2]);
+  for(auto &instance : instances)
+  {
+    auto &submesh = submeshes[instance.index];
 
-          vertices.push_back({ position.x, position.y, position.z, vertex.texcoord[0], vertex.texcoord[1], normal.x, normal.y, normal.z, tangent.x, tangent.y, tangent.z, vertex.tangent[3] });
-        }
+    vertexcount += submesh.vertextable.size();
+    indexcount += submesh.indextable.size();
+    rigged |= !submesh.bonetable.empty();
+  }
 
-        for(auto &index: indextable)
-        {
-          indices.push_back(index + base);
-        }
+  vector<PackVertex> vertices(vertexcount);
+  vector<uint32_t> indices(indexcount);
+  vector<PackMeshPayload::Rig> rig(rigged ? vertexcount : 0);
+  vector<PackMeshPayload::Bone> bones;
+  map<string, uint32_t> bonemap;
 
-        if (mesh.bonecount != 0)
-        {
-          vector<PackMeshPayload::Rig> rigtable(mesh.vertexcount);
+  uint32_t vertexbase = 0;
+  uint32_t indexbase = 0;
+
+  for(auto &instance : instances)
+  {
+    auto &submesh = submeshes[instance.index];
+
+    auto rotation = instance.transform.rotation();
+
+    for(size_t i = 0; i < submesh.vertextable.size(); ++i)
+    {
+      auto &vertex = submesh.vertextable[i];
+
+      auto position = instance.transform * Vec3(vertex.position[0], vertex.position[1], vertex.position[2]);
+      auto normal = rotation * Vec3(vertex.normal[0], vertex.normal[1], vertex.normal[2]);
+      auto tangent = rotation * Vec3(vertex.tangent[0], vertex.tangent[1], vertex.tangent[2]);
+
+      vertices[vertexbase + i] = { position.x, position.y, position.z, vertex.texcoord[0], vertex.texcoord[1], normal.x, normal.y, normal.z, tangent.x, tangent.y, tangent.z, vertex.tangent[3] };
+    }
+
+    for(size_t i = 0; i < submesh.indextable.size(); ++i)
+    {
+      indices[indexbase + i] = submesh.indextable[i] + vertexbase;
+    }
+
+    if (!submesh.bonetable.empty())
+    {
+      // resolve bones once per mesh, rig quads then remap by index
 
-          position += asset.document->read(position, rigtable.data(), rigtable.size() * sizeof(PackMeshPayload::Rig));
+      vector<uint32_t> boneremap(submesh.bonetable.size());
 
-          vector<PackMeshPayload::Bone> bonetable(mesh.bonecount);
+      for(size_t i = 0; i < submesh.bonetable.size(); ++i)
+      {
+        auto bone = submesh.bonetable[i];
 
-          position += asset.document->read(position, bonetable.data(), bonetable.size() * sizeof(PackMeshPayload::Bone));
+        auto j = bonemap.find(bone.name);
 
-          for(auto &bone : bonetable)
-          {
-            if (bonemap.find(bone.name) == bonemap.end())
-            {
-              auto transform = Transform{ { bone.transform[0], bone.transform[1], bone.transform[2], bone.transform[3] }, { bone.transform[4], bone.transform[5], bone.transform[6], bone.transform[7] } } * inverse(instance.transform);
+        if (j == bonemap.end())
+        {
+          auto transform = Transform{ { bone.transform[0], bone.transform[1], bone.transform[2], bone.transform[3] }, { bone.transform[4], bone.transform[5], bone.transform[6], bone.transform[7] } } * inverse(instance.transform);
 
-              memcpy(bone.transform, &transform, sizeof(bone.transform));
+          memcpy(bone.transform, &transform, sizeof(bone.transform));
 
-              bones.push_back(bone);
-              bonemap.emplace(bone.name, bones.size() - 1);
-            }
-          }
+          bones.push_back(bone);
 
-          for(auto &rigquad : rigtable)
-          {
-            rig.push_back({ bonemap[bonetable[rigquad.bone[0]].name], bonemap[bonetable[rigquad.bone[1]].name], bonemap[bonetable[rigquad.bone[2]].name], bonemap[bonetable[rigquad.bone[3]].name], rigquad.weight[0], rigquad.weight[1], rigquad.weight[2], rigquad.weight[3] });
-          }
+          j = bonemap.emplace(bone.name, bones.size() - 1).first;
         }
+
+        boneremap[i] = j->second;
       }
-    }
 
-    asset.document->unlock();
+      for(size_t i = 0; i < submesh.rigtable.size(); ++i)
+      {
+        auto &rigquad = submesh.rigtable[i];
+
+        rig[vertexbase + i] = { boneremap[rigquad.bone[0]], boneremap[rigquad.bone[1]], boneremap[rigquad.bone[2]], boneremap[rigquad.bone[3]], rigquad.weight[0], rigquad.weight[1], rigquad.weight[2], rigquad.weight[3] };
+      }
+    }
 
-    write_mesh_asset(fout, asset.id, vertices, indices, rig, bones);
+    vertexbase += submesh.vertextable.size();
+    indexbase += submesh.indextable.size();
   }
 
-  if (asset.index > 0)
+  write_mesh_asset(fout, asset.id, vertices, indices, rig, bones);
+}
+
+
+///////////////////////// pack_instanced ////////////////////////////////////
+void MeshDocument::pack_instanced(Studio::PackerState &asset, ofstream &fout)
+{
+  vector<PackModelPayload::Texture> textures;
+  vector<PackModelPayload::Material> materials;
+  vector<PackModelPayload::Mesh> meshes;
+  vector<PackModelPayload::Instance> instances;
+
+  map<size_t, size_t> meshmap;
+
+  textures.push_back({ PackModelPayload::Texture::nullmap, 0 });
+
+  asset.document->lock();
+
+  PackModelHeader modl;
+
+  if (read_asset_header(asset.document, 1, &modl))
   {
-    asset.document->lock();
+    vector<char> payload(pack_payload_size(modl));
 
-    PackMeshHeader mesh;
+    read_asset_payload(asset.document, modl.dataoffset, payload.data(), payload.size());
 
-    if (read_asset_header(asset.document, asset.index, &mesh))
+    auto materialtable = PackModelPayload::materialtable(payload.data(), modl.texturecount, modl.materialcount, modl.meshcount, modl.instancecount);
+
+    for(size_t i = 0; i < modl.materialcount; ++i)
     {
-      vector<char> payload(pack_payload_size(mesh));
+      auto material = materialtable[i];
 
-      read_asset_payload(asset.document, mesh.dataoffset, payload.data(), payload.size());
+      // imported meshes carry only the null texture, clamp anything else
+      // rather than reference a texture this asset does not pack
 
-      write_mesh_asset(fout, asset.id, mesh.vertexcount, mesh.indexcount, mesh.bonecount, Bound3(Vec3(mesh.mincorner[0], mesh.mincorner[1], mesh.mincorner[2]), Vec3(mesh.maxcorner[0], mesh.maxcorner[1], mesh.maxcorner[2])), payload.data());
+      if (material.albedomap >= textures.size())
+        material.albedomap = 0;
+
+      if (material.surfacemap >= textures.size())
+        material.surfacemap = 0;
+
+      if (material.normalmap >= textures.size())
+        material.normalmap = 0;
+
+      materials.push_back(material);
     }
+  }
 
-    asset.document->unlock();
+  asset.document->unlock();
+
+  auto meshdocument = MeshDocument(asset.document);
+
+  for(auto &instance : meshdocument.instances())
+  {
+    auto mesh = meshmap.find(instance.index);
+
+    if (mesh == meshmap.end())
+    {
+      PackModelPayload::Mesh entry;
+
+      entry.mesh = asset.add_dependant(asset.document, instance.index, "Mesh");
+
+      meshes.push_back(entry);
+
+      mesh = meshmap.insert({ instance.index, meshes.size() - 1 }).first;
+    }
+
+    PackModelPayload::Instance entry;
+
+    entry.mesh = mesh->second;
+    entry.material = (instance.material < materials.size()) ? instance.material : 0;
+    memcpy(&entry.transform, &instance.transform, sizeof(Transform));
+    entry.childcount = 0;
+
+    instances.push_back(entry);
   }
+
+  if (materials.empty())
+  {
+    materials.push_back({ 0.75f, 0.75f, 0.75f, 1.0f, 0.0f, 1.0f, 0.5f, 0.0f, 0, 0, 0 });
+  }
+
+  write_modl_asset(fout, asset.id, textures, materials, meshes, instances);
+
+  // the catalog entry is a model, not a mesh, so report it as one
+
+  asset.type = "Model";
 }
 
 
@@ -251,6 +423,24 @@ vector<MeshDocument::Instance> MeshDocument::instances() const
 }
 
 
+///////////////////////// MeshDocument::packmode ////////////////////////////
+MeshDocument::PackMode MeshDocument::packmode() const
+{
+  return static_cast<PackMode>(m_document->metadata("packmode", 0));
+}
+
+
+///////////////////////// MeshDocument::set_packmode ////////////////////////
+void MeshDocument::set_packmode(PackMode packmode)
+{
+  m_document->lock_exclusive();
+
+  m_document->set_metadata("packmode", static_cast<int>(packmode));
+
+  m_document->unlock_exclusive();
+}
+
+
 ///////////////////////// MeshDocument::attach //////////////////////////////
 void MeshDocument::attach(Studio::Document *document)
 {
@@ -53,10 +53,27 @@ class MeshDocument : public QObject
 
     std::vector<Instance> instances() const;
 
+    enum class PackMode
+    {
+      Merged,
+      Instanced
+    };
+
+    PackMode packmode() const;
+
+  public:
+
+    void set_packmode(PackMode packmode);
+
   signals:
 
     void document_changed();
 
+  private:
+
+    static void pack_merged(Studio::PackerState &asset, std::ofstream &fout);
+    static void pack_instanced(Studio::PackerState &asset, std::ofstream &fout);
+
   private:
 
     void attach(Studio::Document *document);
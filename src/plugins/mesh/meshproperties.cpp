@@ -83,6 +83,7 @@ void MeshProperties::refresh()
   ui.Materials->setText(QString::number(materials));
   ui.Vertices->setText(QLocale(QLocale::English).toString(vertices));
   ui.Triangles->setText(QLocale(QLocale::English).toString(triangles));
+  ui.PackMode->setCurrentIndex(static_cast<int>(m_document.packmode()));
 
   ui.ImportSrc->setText(m_document->metadata("src").toString());
   ui.ImportScale->setText(m_document->metadata("importscale").toString());
@@ -91,6 +92,13 @@ void MeshProperties::refresh()
 }
 
 
+///////////////////////// MeshProperties::PackMode //////////////////////////
+void MeshProperties::on_PackMode_activated(int index)
+{
+  m_document.set_packmode(static_cast<MeshDocument::PackMode>(index));
+}
+
+
 ///////////////////////// MeshProperties::Reimport //////////////////////////
 void MeshProperties::on_Reimport_clicked()
 {
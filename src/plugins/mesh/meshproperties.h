@@ -30,6 +30,8 @@ class MeshProperties : public QDockWidget
 
     void refresh();
 
+    void on_PackMode_activated(int index);
+
     void on_Reimport_clicked();
 
   private:
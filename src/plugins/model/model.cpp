@@ -266,6 +266,7 @@ ModelDocument::ModelDocument()
   auto documentmanager = Studio::Core::instance()->find_object<Studio::DocumentManager>();
 
   connect(documentmanager, &Studio::DocumentManager::document_changed, this, &ModelDocument::touch);
+  connect(documentmanager, &Studio::DocumentManager::documents_changed, this, [=](QVector<Studio::DocumentManager::Change> const &changes) { for(auto &change : changes) { if (change.document) touch(change.document, change.dst); } });
 }
 
 
@@ -148,7 +148,7 @@ Material const *ModelView::find_or_create_material(Studio::Document *document, C
     {
       auto buildmanager = Studio::Core::instance()->find_object<Studio::BuildManager>();
 
-      buildmanager->request_build(document, this, &ModelView::on_material_build_complete);
+      buildmanager->request_preview(document, this, &ModelView::on_material_build_complete);
 
       materialdata.hash = hash;
     }
@@ -9,11 +9,17 @@
 #include "objimporter.h"
 #include "contentapi.h"
 #include "assetfile.h"
+#include "tangentspace.h"
 #include "datum/math.h"
 #include <leap.h>
 #include <QFileInfo>
+#include <QFile>
 #include <QtPlugin>
-#include <unordered_map>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <map>
+#include <cmath>
 
 #include <QDebug>
 
@@ -23,196 +29,731 @@ using namespace leap;
 
 namespace
 {
-  vector<string_view> seperate(string_view str, const char *delimiters = " \t\r\n")
+  struct Corner
   {
-    vector<string_view> result;
+    int position;
+    int texcoord;
+    int normal;
+    int relative;
+  };
 
-    size_t i = 0;
-    size_t j = 0;
+  struct Group
+  {
+    enum { Object, Material } type;
 
-    while (j != string_view::npos)
-    {
-      j = str.find_first_of(delimiters, i);
+    size_t face;
+    string name;
+  };
 
-      result.push_back(str.substr(i, j-i));
+  struct Chunk
+  {
+    const char *beg;
+    const char *end;
 
-      i = j + 1;
-    }
+    vector<Vec3> points;
+    vector<Vec3> normals;
+    vector<Vec2> texcoords;
+
+    vector<uint32_t> faces;
+    vector<Corner> corners;
+    vector<Group> groups;
+
+    size_t pointbase;
+    size_t normalbase;
+    size_t texcoordbase;
+  };
+
+  struct Span
+  {
+    Chunk const *chunk;
+
+    size_t facebeg;
+    size_t faceend;
+    size_t cornerbeg;
+  };
+
+  struct Mesh
+  {
+    uint32_t material;
+
+    vector<Span> spans;
+
+    vector<PackVertex> vertices;
+    vector<uint32_t> indices;
+  };
+
+  template<typename Func>
+  void parallel_for(size_t count, Func &&func)
+  {
+    atomic<size_t> next(0);
+
+    exception_ptr error;
+    mutex errorlock;
+
+    auto worker = [&]() {
+
+      for(size_t i = next++; i < count; i = next++)
+      {
+        try
+        {
+          func(i);
+        }
+        catch(...)
+        {
+          lock_guard<mutex> lock(errorlock);
+
+          if (!error)
+            error = current_exception();
+        }
+      }
+    };
+
+    vector<thread> threads;
+
+    for(size_t i = 1; i < min<size_t>(max(thread::hardware_concurrency(), 1u), count); ++i)
+      threads.emplace_back(worker);
+
+    worker();
+
+    for(auto &thread : threads)
+      thread.join();
 
-    return result;
+    if (error)
+      rethrow_exception(error);
   }
 
-  void calculate_tangents(vector<PackVertex> &vertices, vector<uint32_t> &indices)
+  inline bool is_space(char ch)
   {
-    vector<Vec3> tan1(vertices.size(), Vec3(0));
-    vector<Vec3> tan2(vertices.size(), Vec3(0));
+    return (ch == ' ' || ch == '\t' || ch == '\r');
+  }
+
+  inline bool is_digit(char ch)
+  {
+    return (ch >= '0' && ch <= '9');
+  }
+
+  inline const char *skip_space(const char *p, const char *end)
+  {
+    while (p != end && is_space(*p))
+      ++p;
+
+    return p;
+  }
+
+  inline const char *skip_line(const char *p, const char *end)
+  {
+    while (p != end && *p != '\n')
+      ++p;
+
+    return p;
+  }
+
+  inline const char *parse_int(const char *p, const char *end, int *value)
+  {
+    bool negative = false;
+
+    if (p != end && (*p == '-' || *p == '+'))
+      negative = (*p++ == '-');
+
+    int result = 0;
+
+    while (p != end && is_digit(*p))
+      result = result * 10 + (*p++ - '0');
 
-    for(size_t i = 0; i < indices.size(); i += 3)
+    *value = negative ? -result : result;
+
+    return p;
+  }
+
+  inline const char *parse_float(const char *p, const char *end, float *value)
+  {
+    static const double powers[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+
+    p = skip_space(p, end);
+
+    bool negative = false;
+
+    if (p != end && (*p == '-' || *p == '+'))
+      negative = (*p++ == '-');
+
+    int digits = 0;
+    int exponent = 0;
+    uint64_t mantissa = 0;
+
+    while (p != end && is_digit(*p))
     {
-      auto &v1 = vertices[indices[i+0]];
-      auto &v2 = vertices[indices[i+1]];
-      auto &v3 = vertices[indices[i+2]];
+      if (digits < 19)
+      {
+        mantissa = mantissa * 10 + (*p - '0');
 
-      auto x1 = v2.position[0] - v1.position[0];
-      auto x2 = v3.position[0] - v1.position[0];
-      auto y1 = v2.position[1] - v1.position[1];
-      auto y2 = v3.position[1] - v1.position[1];
-      auto z1 = v2.position[2] - v1.position[2];
-      auto z2 = v3.position[2] - v1.position[2];
+        digits += (mantissa != 0) ? 1 : 0;
+      }
+      else
+      {
+        exponent += 1;
+      }
 
-      auto s1 = v2.texcoord[0] - v1.texcoord[0];
-      auto s2 = v3.texcoord[0] - v1.texcoord[0];
-      auto t1 = v1.texcoord[1] - v2.texcoord[1];
-      auto t2 = v1.texcoord[1] - v3.texcoord[1];
+      ++p;
+    }
 
-      auto r = s1 * t2 - s2 * t1;
+    if (p != end && *p == '.')
+    {
+      ++p;
 
-      if (r != 0)
+      while (p != end && is_digit(*p))
       {
-        auto sdir = Vec3(t2 * x1 - t1 * x2, t2 * y1 - t1 * y2, t2 * z1 - t1 * z2) / r;
-        auto tdir = Vec3(s1 * x2 - s2 * x1, s1 * y2 - s2 * y1, s1 * z2 - s2 * z1) / r;
+        if (digits < 19)
+        {
+          mantissa = mantissa * 10 + (*p - '0');
 
-        auto uvarea = area(Vec2(v1.texcoord[0], v1.texcoord[1]), Vec2(v2.texcoord[0], v2.texcoord[1]), Vec2(v3.texcoord[0], v3.texcoord[1]));
+          digits += (mantissa != 0) ? 1 : 0;
 
-        tan1[indices[i+0]] += sdir * uvarea;
-        tan1[indices[i+1]] += sdir * uvarea;
-        tan1[indices[i+2]] += sdir * uvarea;
+          exponent -= 1;
+        }
 
-        tan2[indices[i+0]] += tdir * uvarea;
-        tan2[indices[i+1]] += tdir * uvarea;
-        tan2[indices[i+2]] += tdir * uvarea;
+        ++p;
       }
     }
 
-    for(size_t i = 0; i < vertices.size(); ++i)
+    if (p != end && (*p == 'e' || *p == 'E'))
     {
-      auto normal = Vec3(vertices[i].normal[0], vertices[i].normal[1], vertices[i].normal[2]);
+      int e = 0;
+
+      p = parse_int(p + 1, end, &e);
+
+      exponent += e;
+    }
+
+    double result = mantissa;
 
-      auto tangent = tan1[i];
-      auto bitangent = tan2[i];
+    if (exponent < 0)
+      result /= (exponent >= -22) ? powers[-exponent] : pow(10.0, -exponent);
 
-      orthonormalise(normal, tangent, bitangent);
+    if (exponent > 0)
+      result *= (exponent <= 22) ? powers[exponent] : pow(10.0, exponent);
 
-      vertices[i].tangent[0] = tangent.x;
-      vertices[i].tangent[1] = tangent.y;
-      vertices[i].tangent[2] = tangent.z;
-      vertices[i].tangent[3] = (dot(bitangent, tan2[i]) < 0.0f) ? -1.0f : 1.0f;
+    *value = static_cast<float>(negative ? -result : result);
+
+    return p;
+  }
+
+  inline const char *parse_index(const char *p, const char *end, size_t count, int *index, int *relative, int flag)
+  {
+    int value = 0;
+
+    p = parse_int(p, end, &value);
+
+    if (value > 0)
+      *index = value - 1;
+
+    if (value < 0)
+    {
+      *index = count + value;
+      *relative |= flag;
     }
 
+    return p;
   }
 
-  uint32_t write_mesh_asset(ostream &fout, uint32_t id, string const &path, float scale = 1.0f)
+  inline string parse_name(const char *p, const char *end)
   {
-    vector<Vec3> points;
-    vector<Vec3> normals;
-    vector<Vec2> texcoords;
+    p = skip_space(p, end);
 
-    vector<PackVertex> vertices;
-    vector<uint32_t> indices;
-    unordered_map<PackVertex, uint32_t> vertexmap;
+    auto q = skip_line(p, end);
 
-    ifstream fin(path);
+    while (q != p && is_space(*(q - 1)))
+      --q;
 
-    if (!fin)
-      throw runtime_error("unable to read obj file - " + path);
+    return string(p, q);
+  }
 
-    string buffer;
+  void parse_chunk(Chunk &chunk)
+  {
+    auto p = chunk.beg;
+    auto end = chunk.end;
 
-    while (getline(fin, buffer))
+    while (p != end)
     {
-      auto line = trim(buffer);
+      p = skip_space(p, end);
 
-      // skip comments
-      if (line.empty() || line[0] == '#' || line[0] == '/')
-        continue;
+      auto keyword = p;
 
-      auto fields = split(line);
+      while (p != end && !is_space(*p) && *p != '\n')
+        ++p;
 
-      if (fields[0] == "v")
+      auto length = p - keyword;
+
+      if (length == 1 && keyword[0] == 'v')
       {
-        points.emplace_back(ato<float>(fields[1]), ato<float>(fields[2]), ato<float>(fields[3]));
+        Vec3 point;
+
+        p = parse_float(p, end, &point.x);
+        p = parse_float(p, end, &point.y);
+        p = parse_float(p, end, &point.z);
+
+        chunk.points.push_back(point);
       }
 
-      if (fields[0] == "vn")
+      else if (length == 2 && keyword[0] == 'v' && keyword[1] == 'n')
       {
-        normals.emplace_back(ato<float>(fields[1]), ato<float>(fields[2]), ato<float>(fields[3]));
+        Vec3 normal;
+
+        p = parse_float(p, end, &normal.x);
+        p = parse_float(p, end, &normal.y);
+        p = parse_float(p, end, &normal.z);
+
+        chunk.normals.push_back(normal);
       }
 
-      if (fields[0] == "vt")
+      else if (length == 2 && keyword[0] == 'v' && keyword[1] == 't')
       {
-        texcoords.emplace_back(ato<float>(fields[1]), ato<float>(fields[2]));
+        Vec2 texcoord;
+
+        p = parse_float(p, end, &texcoord.x);
+        p = parse_float(p, end, &texcoord.y);
+
+        chunk.texcoords.push_back(texcoord);
       }
 
-      if (fields[0] == "f")
+      else if (length == 1 && keyword[0] == 'f')
       {
-        vector<string_view> face[] = { seperate(fields[1], "/"), seperate(fields[2], "/"), seperate(fields[3], "/") };
+        uint32_t count = 0;
 
-        for(auto &v : face)
+        while (true)
         {
-          PackVertex vertex = {};
+          p = skip_space(p, end);
 
-          if (v.size() > 0 && ato<int>(v[0]) != 0)
-            memcpy(vertex.position, &points[ato<int>(v[0]) - 1], sizeof(vertex.position));
+          if (p == end || !(is_digit(*p) || *p == '-' || *p == '+'))
+            break;
 
-          if (v.size() > 1 && ato<int>(v[1]) != 0)
-            memcpy(vertex.texcoord, &texcoords[ato<int>(v[1]) - 1], sizeof(vertex.texcoord));
+          Corner corner = { -1, -1, -1, 0 };
 
-          if (v.size() > 2 && ato<int>(v[2]) != 0)
-            memcpy(vertex.normal, &normals[ato<int>(v[2]) - 1], sizeof(vertex.normal));
+          p = parse_index(p, end, chunk.points.size(), &corner.position, &corner.relative, 1);
 
-          if (vertexmap.find(vertex) == vertexmap.end())
+          if (p != end && *p == '/')
           {
-            vertices.push_back(vertex);
+            if (++p != end && *p != '/')
+              p = parse_index(p, end, chunk.texcoords.size(), &corner.texcoord, &corner.relative, 2);
 
-            vertexmap[vertex] = vertices.size() - 1;
+            if (p != end && *p == '/')
+              p = parse_index(p + 1, end, chunk.normals.size(), &corner.normal, &corner.relative, 4);
           }
 
-          indices.push_back(vertexmap[vertex]);
+          chunk.corners.push_back(corner);
+
+          count += 1;
         }
+
+        chunk.faces.push_back(count);
+      }
+
+      else if ((length == 1 && (keyword[0] == 'o' || keyword[0] == 'g')))
+      {
+        chunk.groups.push_back({ Group::Object, chunk.faces.size(), parse_name(p, end) });
       }
+
+      else if (length == 6 && memcmp(keyword, "usemtl", 6) == 0)
+      {
+        chunk.groups.push_back({ Group::Material, chunk.faces.size(), parse_name(p, end) });
+      }
+
+      p = skip_line(p, end);
+
+      if (p != end)
+        ++p;
     }
+  }
 
-    for(auto &vertex : vertices)
+  void resolve_chunk(Chunk &chunk, size_t pointcount, size_t normalcount, size_t texcoordcount)
+  {
+    for(auto &corner : chunk.corners)
     {
-      vertex.position[0] *= scale;
-      vertex.position[1] *= scale;
-      vertex.position[2] *= scale;
+      if (corner.relative & 1)
+        corner.position += chunk.pointbase;
+
+      if (corner.relative & 2)
+        corner.texcoord += chunk.texcoordbase;
+
+      if (corner.relative & 4)
+        corner.normal += chunk.normalbase;
+
+      if (corner.position < 0 || corner.position >= (int)pointcount)
+        throw runtime_error("invalid obj face vertex index");
+
+      if (corner.texcoord < -1 || corner.texcoord >= (int)texcoordcount)
+        throw runtime_error("invalid obj face texcoord index");
+
+      if (corner.normal < -1 || corner.normal >= (int)normalcount)
+        throw runtime_error("invalid obj face normal index");
     }
+  }
+
+  class VertexMap
+  {
+    public:
+
+      VertexMap(size_t count)
+      {
+        size_t capacity = 64;
+
+        while (capacity < 2*count)
+          capacity *= 2;
+
+        m_slots.resize(capacity, Slot{ {}, Empty });
+      }
+
+      // returns existing index for corner, or inserts index and returns it
+      uint32_t insert(Corner const &corner, uint32_t index)
+      {
+        if (2*(m_size + 1) > m_slots.size())
+          grow();
+
+        auto mask = m_slots.size() - 1;
+
+        for(size_t i = hash(corner) & mask; true; i = (i + 1) & mask)
+        {
+          auto &slot = m_slots[i];
+
+          if (slot.index == Empty)
+          {
+            slot.corner = corner;
+            slot.index = index;
+
+            m_size += 1;
+
+            return index;
+          }
+
+          if (slot.corner.position == corner.position && slot.corner.texcoord == corner.texcoord && slot.corner.normal == corner.normal)
+            return slot.index;
+        }
+      }
 
-    calculate_tangents(vertices, indices);
+    private:
+
+      static constexpr uint32_t Empty = ~0u;
+
+      static size_t hash(Corner const &corner)
+      {
+        uint64_t key = (uint64_t)(uint32_t)corner.position * 0x9E3779B97F4A7C15ull;
+
+        key ^= (uint64_t)(uint32_t)corner.texcoord * 0xC2B2AE3D27D4EB4Full;
+        key ^= (uint64_t)(uint32_t)corner.normal * 0x165667B19E3779F9ull;
+
+        return key ^ (key >> 29);
+      }
+
+      void grow()
+      {
+        vector<Slot> slots(2 * m_slots.size(), Slot{ {}, Empty });
+
+        swap(slots, m_slots);
+
+        m_size = 0;
+
+        for(auto &slot : slots)
+        {
+          if (slot.index != Empty)
+            insert(slot.corner, slot.index);
+        }
+      }
+
+      struct Slot
+      {
+        Corner corner;
+        uint32_t index;
+      };
+
+      size_t m_size = 0;
+
+      vector<Slot> m_slots;
+  };
+
+  void build_mesh(Mesh &mesh, vector<Vec3> const &points, vector<Vec3> const &normals, vector<Vec2> const &texcoords)
+  {
+    size_t cornercount = 0;
+    size_t trianglecount = 0;
+
+    for(auto &span : mesh.spans)
+    {
+      for(size_t i = span.facebeg; i < span.faceend; ++i)
+      {
+        cornercount += span.chunk->faces[i];
+        trianglecount += max(span.chunk->faces[i], 2u) - 2;
+      }
+    }
+
+    VertexMap vertexmap(cornercount);
+
+    mesh.vertices.reserve(cornercount);
+    mesh.indices.reserve(trianglecount * 3);
+
+    vector<uint32_t> face;
+
+    for(auto &span : mesh.spans)
+    {
+      auto corner = span.chunk->corners.data() + span.cornerbeg;
+
+      for(size_t i = span.facebeg; i < span.faceend; corner += span.chunk->faces[i], ++i)
+      {
+        face.clear();
+
+        for(size_t k = 0; k < span.chunk->faces[i]; ++k)
+        {
+          auto index = vertexmap.insert(corner[k], mesh.vertices.size());
+
+          if (index == mesh.vertices.size())
+          {
+            PackVertex vertex = {};
+
+            memcpy(vertex.position, &points[corner[k].position], sizeof(vertex.position));
+
+            if (corner[k].texcoord >= 0)
+              memcpy(vertex.texcoord, &texcoords[corner[k].texcoord], sizeof(vertex.texcoord));
+
+            if (corner[k].normal >= 0)
+              memcpy(vertex.normal, &normals[corner[k].normal], sizeof(vertex.normal));
+
+            mesh.vertices.push_back(vertex);
+          }
+
+          face.push_back(index);
+        }
+
+        // fan triangulation of polygonal faces
+
+        for(size_t k = 2; k < face.size(); ++k)
+        {
+          mesh.indices.push_back(face[0]);
+          mesh.indices.push_back(face[k-1]);
+          mesh.indices.push_back(face[k]);
+        }
+      }
+    }
+  }
+
+  uint32_t write_mesh_asset(ostream &fout, uint32_t id, string const &path, float scale = 1.0f)
+  {
+    QFile file(QString::fromStdString(path));
+
+    if (!file.open(QIODevice::ReadOnly))
+      throw runtime_error("unable to read obj file - " + path);
+
+    QByteArray buffer;
+
+    auto beg = reinterpret_cast<const char*>(file.map(0, file.size()));
+
+    if (!beg)
+    {
+      buffer = file.readAll();
+
+      beg = buffer.constData();
+    }
+
+    auto end = beg + file.size();
+
+    //
+    // Parse
+    //
+
+    constexpr size_t MinChunkSize = 1024*1024;
+
+    size_t chunksize = max(MinChunkSize, (size_t)(end - beg) / (4 * max(thread::hardware_concurrency(), 1u)) + 1);
+
+    vector<Chunk> chunks;
+
+    for(auto p = beg; p != end; )
+    {
+      auto q = (end - p > (ptrdiff_t)chunksize) ? skip_line(p + chunksize, end) : end;
+
+      if (q != end)
+        ++q;
+
+      chunks.push_back({ p, q });
+
+      p = q;
+    }
+
+    parallel_for(chunks.size(), [&](size_t i) { parse_chunk(chunks[i]); });
+
+    size_t pointcount = 0;
+    size_t normalcount = 0;
+    size_t texcoordcount = 0;
+
+    for(auto &chunk : chunks)
+    {
+      chunk.pointbase = pointcount;
+      chunk.normalbase = normalcount;
+      chunk.texcoordbase = texcoordcount;
+
+      pointcount += chunk.points.size();
+      normalcount += chunk.normals.size();
+      texcoordcount += chunk.texcoords.size();
+    }
+
+    vector<Vec3> points(pointcount);
+    vector<Vec3> normals(normalcount);
+    vector<Vec2> texcoords(texcoordcount);
+
+    parallel_for(chunks.size(), [&](size_t i) {
+
+      auto &chunk = chunks[i];
+
+      copy(chunk.points.begin(), chunk.points.end(), points.begin() + chunk.pointbase);
+      copy(chunk.normals.begin(), chunk.normals.end(), normals.begin() + chunk.normalbase);
+      copy(chunk.texcoords.begin(), chunk.texcoords.end(), texcoords.begin() + chunk.texcoordbase);
+
+      resolve_chunk(chunk, pointcount, normalcount, texcoordcount);
+
+      chunk.points = {};
+      chunk.normals = {};
+      chunk.texcoords = {};
+    });
+
+    //
+    // Groups
+    //
+
+    vector<Mesh> meshes;
+    vector<string> materials;
+
+    map<pair<string, string>, size_t> meshmap;
+    map<string, uint32_t> materialmap;
+
+    string object, material;
+
+    for(auto &chunk : chunks)
+    {
+      size_t face = 0;
+      size_t corner = 0;
+
+      for(size_t i = 0; i <= chunk.groups.size(); ++i)
+      {
+        size_t faceend = (i < chunk.groups.size()) ? chunk.groups[i].face : chunk.faces.size();
+
+        if (face != faceend)
+        {
+          auto mesh = meshmap.find({ object, material });
+
+          if (mesh == meshmap.end())
+          {
+            auto mat = materialmap.find(material);
+
+            if (mat == materialmap.end())
+            {
+              materials.push_back(material);
+
+              mat = materialmap.emplace(material, materials.size() - 1).first;
+            }
+
+            meshes.push_back({ mat->second });
+
+            mesh = meshmap.emplace(make_pair(object, material), meshes.size() - 1).first;
+          }
+
+          meshes[mesh->second].spans.push_back({ &chunk, face, faceend, corner });
+
+          for( ; face != faceend; ++face)
+            corner += chunk.faces[face];
+        }
+
+        if (i < chunk.groups.size())
+        {
+          switch (chunk.groups[i].type)
+          {
+            case Group::Object:
+              object = chunk.groups[i].name;
+              break;
+
+            case Group::Material:
+              material = chunk.groups[i].name;
+              break;
+          }
+        }
+      }
+    }
+
+    if (meshes.empty())
+      throw runtime_error("obj file has no faces - " + path);
+
+    //
+    // Meshes
+    //
+
+    parallel_for(meshes.size(), [&](size_t i) {
+
+      auto &mesh = meshes[i];
+
+      build_mesh(mesh, points, normals, texcoords);
+
+      for(auto &vertex : mesh.vertices)
+      {
+        vertex.position[0] *= scale;
+        vertex.position[1] *= scale;
+        vertex.position[2] *= scale;
+      }
+
+      calculate_tangents(mesh.vertices, mesh.indices);
+    });
+
+    //
+    // Model
+    //
+
+    vector<PackModelPayload::Texture> texturetable;
+    vector<PackModelPayload::Material> materialtable;
+    vector<PackModelPayload::Mesh> meshtable;
+    vector<PackModelPayload::Instance> instancetable;
 
     PackModelPayload::Texture texture;
     texture.type = PackModelPayload::Texture::nullmap;
 
-    PackModelPayload::Material material;
-    material.color[0] = 0.75f;
-    material.color[1] = 0.75f;
-    material.color[2] = 0.75f;
-    material.color[3] = 1.0f;
-    material.metalness = 0.0f;
-    material.roughness = 1.0f;
-    material.reflectivity = 0.5f;
-    material.emissive = 0.0f;
-    material.albedomap = 0;
-    material.surfacemap = 0;
-    material.normalmap = 0;
-
-    PackModelPayload::Mesh mesh;
-    mesh.mesh = 1;
+    texturetable.push_back(texture);
+
+    for(size_t i = 0; i < materials.size(); ++i)
+    {
+      PackModelPayload::Material material;
+      material.color[0] = 0.75f;
+      material.color[1] = 0.75f;
+      material.color[2] = 0.75f;
+      material.color[3] = 1.0f;
+      material.metalness = 0.0f;
+      material.roughness = 1.0f;
+      material.reflectivity = 0.5f;
+      material.emissive = 0.0f;
+      material.albedomap = 0;
+      material.surfacemap = 0;
+      material.normalmap = 0;
+
+      materialtable.push_back(material);
+    }
 
     Transform transform = Transform::identity();
 
-    PackModelPayload::Instance instance;
-    instance.mesh = 0;
-    instance.material = 0;
-    memcpy(&instance.transform, &transform, sizeof(Transform));
-    instance.childcount = 0;
+    for(size_t i = 0; i < meshes.size(); ++i)
+    {
+      PackModelPayload::Mesh mesh;
+      mesh.mesh = 1 + i;
+
+      meshtable.push_back(mesh);
+
+      PackModelPayload::Instance instance;
+      instance.mesh = i;
+      instance.material = meshes[i].material;
+      memcpy(&instance.transform, &transform, sizeof(Transform));
+      instance.childcount = 0;
 
-    write_modl_asset(fout, id, { texture }, { material }, { mesh }, { instance });
+      instancetable.push_back(instance);
+    }
+
+    write_modl_asset(fout, id, texturetable, materialtable, meshtable, instancetable);
 
-    write_mesh_asset(fout, id + 1, vertices, indices);
+    for(size_t i = 0; i < meshes.size(); ++i)
+    {
+      write_mesh_asset(fout, id + 1 + i, meshes[i].vertices, meshes[i].indices);
+    }
 
-    return id + 2;
+    return id + 1 + meshes.size();
   }
 }
 
@@ -9,6 +9,7 @@
 #include "oceanmaterial.h"
 #include "image.h"
 #include "assetfile.h"
+#include "trace.h"
 #include "ibl.h"
 #include <QPainter>
 #include <QJsonDocument>
@@ -59,7 +60,11 @@ namespace
 
     image_pack_watercolor(deepcolor, shallowcolor, depthscale, fresnelcolor, fresnelbias, fresnelpower, width, height, payload.data());
 
-    write_imag_asset(fout, id, width, height, layers, levels, PackImageHeader::rgbe, payload.data());
+    {
+      Studio::TraceScope trace("write");
+
+      write_imag_asset(fout, id, width, height, layers, levels, PackImageHeader::rgbe, payload.data());
+    }
 
     return id + 1;
   }
@@ -86,9 +91,17 @@ namespace
       }
     }
 
-    image_buildmips_rgb(width, height, layers, levels, payload.data());
+    {
+      Studio::TraceScope trace("mips");
 
-    write_imag_asset(fout, id, width, height, layers, levels, PackImageHeader::rgba, payload.data());
+      image_buildmips_rgb(width, height, layers, levels, payload.data());
+    }
+
+    {
+      Studio::TraceScope trace("write");
+
+      write_imag_asset(fout, id, width, height, layers, levels, PackImageHeader::rgba, payload.data());
+    }
 
     return id + 1;
   }
@@ -115,9 +128,17 @@ namespace
       }
     }
 
-    image_buildmips_rgb(width, height, layers, levels, payload.data());
+    {
+      Studio::TraceScope trace("mips");
 
-    write_imag_asset(fout, id, width, height, layers, levels, PackImageHeader::rgba, payload.data());
+      image_buildmips_rgb(width, height, layers, levels, payload.data());
+    }
+
+    {
+      Studio::TraceScope trace("write");
+
+      write_imag_asset(fout, id, width, height, layers, levels, PackImageHeader::rgba, payload.data());
+    }
 
     return id + 1;
   }
@@ -306,7 +327,11 @@ void OceanMaterialDocument::pack(Studio::PackerState &asset, ofstream &fout)
 
       read_asset_payload(fin, imag.dataoffset, payload.data(), payload.size());
 
-      image_compress_bc3(imag.width, imag.height, imag.layers, imag.levels, payload.data());
+      {
+        Studio::TraceScope trace("compress");
+
+        image_compress_bc3(imag.width, imag.height, imag.layers, imag.levels, payload.data());
+      }
 
       write_imag_asset(fout, asset.id, imag.width, imag.height, imag.layers, imag.levels, PackImageHeader::rgba_bc3, payload.data());
     }
@@ -322,7 +347,11 @@ void OceanMaterialDocument::pack(Studio::PackerState &asset, ofstream &fout)
 
       read_asset_payload(fin, imag.dataoffset, payload.data(), payload.size());
 
-      image_compress_bc3(imag.width, imag.height, imag.layers, imag.levels, payload.data());
+      {
+        Studio::TraceScope trace("compress");
+
+        image_compress_bc3(imag.width, imag.height, imag.layers, imag.levels, payload.data());
+      }
 
       write_imag_asset(fout, asset.id, imag.width, imag.height, imag.layers, imag.levels, PackImageHeader::rgba_bc3, payload.data());
     }
@@ -353,6 +382,7 @@ OceanMaterialDocument::OceanMaterialDocument()
   auto documentmanager = Studio::Core::instance()->find_object<Studio::DocumentManager>();
 
   connect(documentmanager, &Studio::DocumentManager::document_changed, this, &OceanMaterialDocument::touch);
+  connect(documentmanager, &Studio::DocumentManager::documents_changed, this, [=](QVector<Studio::DocumentManager::Change> const &changes) { for(auto &change : changes) { if (change.document && change.dst == change.src) touch(change.document, change.dst); } });
 }
 
 
@@ -7,9 +7,12 @@
 //
 
 #include "pack.h"
+#include "packreport.h"
 #include "buildapi.h"
 #include "assetfile.h"
+#include "trace.h"
 #include <QFileInfo>
+#include <QElapsedTimer>
 
 #include <QtDebug>
 
@@ -28,6 +31,8 @@ namespace
 
       enum { Pending, Building, Packing, Done, Failed } status;
 
+      QElapsedTimer timer;
+
       uint32_t add_dependant(Studio::Document *document, QString type) override
       {
         return buildstate->add_dependant(this, document, 0, type) - id + 1;
@@ -41,6 +46,7 @@ namespace
 
     uint32_t signature;
     uint32_t version;
+    QMap<QString, QString> parameters;
     vector<tuple<uint32_t, string>> catalog;
 
     vector<unique_ptr<Asset>> assets;
@@ -58,6 +64,7 @@ namespace
     asset->type = document->metadata("type", QString("Text"));
     asset->document = Studio::Core::instance()->find_object<Studio::DocumentManager>()->dup(document);
     asset->index = index;
+    asset->parameters = parameters;
     asset->buildstate = this;
     asset->status = Asset::Pending;
 
@@ -79,6 +86,7 @@ namespace
       asset->type = type;
       asset->document = Studio::Core::instance()->find_object<Studio::DocumentManager>()->dup(document);
       asset->index = index;
+      asset->parameters = parameters;
       asset->buildstate = this;
       asset->status = Asset::Pending;
 
@@ -97,6 +105,7 @@ namespace
 ///////////////////////// PackManager::Constructor //////////////////////////
 PackManager::PackManager()
 {
+  m_trace = false;
 }
 
 
@@ -107,28 +116,118 @@ void PackManager::register_packer(QString const &type, QObject *packer)
 }
 
 
+///////////////////////// PackManager::set_trace ////////////////////////////
+void PackManager::set_trace(bool enabled)
+{
+  m_trace = enabled;
+}
+
+
 ///////////////////////// PackManager::build ///////////////////////////////
-void PackManager::build(PackModel const *model, QString const &filename, Ui::Build *dlg)
+bool PackManager::build(QString const &projectfile, QString const &filename, QStringList const &groups)
 {
-  auto buildmanager = Studio::Core::instance()->find_object<Studio::BuildManager>();
+  PackModel model;
+
+  model.load(projectfile.toStdString());
+
+  // documents open on the work queue and are handed over on this thread
+
+  while (model.loading())
+    QCoreApplication::processEvents(QEventLoop::WaitForMoreEvents);
+
+  QString status;
+
+  return build(&model, groups, filename, [&](QString const &message, int progress) {
+
+    if (message != status)
+    {
+      qInfo().noquote() << QString("[%1%] %2").arg(progress, 3).arg(message);
+
+      status = message;
+    }
+
+    QCoreApplication::processEvents();
+
+    return true;
+  });
+}
+
 
+///////////////////////// PackManager::build ///////////////////////////////
+void PackManager::build(PackModel const *model, QString const &filename, Ui::Build *dlg)
+{
   dlg->Close->setText("Cancel");
   dlg->Message->setText("Preparing...");
 
+  QString summary;
+
   bool cancel = false;
   auto closesignal = QObject::connect(dlg->Close, &QPushButton::clicked, [&] { cancel = true; });
 
   qApp->processEvents();
 
+  auto result = build(model, QStringList(), filename, [&](QString const &message, int progress) {
+
+    dlg->Message->setText(message);
+    dlg->TotalProgress->setValue(progress);
+
+    qApp->processEvents();
+
+    return !cancel;
+  }, &summary);
+
+  if (result)
+  {
+    dlg->Report->setPlainText(summary);
+    dlg->Report->setVisible(!summary.isEmpty());
+
+    dlg->Export->setEnabled(true);
+  }
+
+  dlg->Close->setText("Close");
+
+  QObject::disconnect(closesignal);
+}
+
+
+///////////////////////// PackManager::build ///////////////////////////////
+bool PackManager::build(PackModel const *model, QStringList const &groups, QString const &filename, function<bool (QString const &message, int progress)> const &report)
+{
+  if (model->loading())
+    throw runtime_error("Pack documents are still loading");
+
+  auto buildmanager = Studio::Core::instance()->find_object<Studio::BuildManager>();
+
+  QElapsedTimer timer;
+
+  timer.start();
+
+  auto reportfile = filename + ".report";
+
+  PackReport previous;
+
+  previous.load(reportfile);
+
+  // spans are always captured for the build timings summary, the trace
+  // file is only written when asked for
+
+  Studio::TraceCapture capture(m_trace ? QFileInfo(filename).dir().filePath("trace.json") : QString());
+
+  Studio::TraceScope trace("pack build");
+
   BuildState pack;
 
   pack.signature = model->signature().toUInt(nullptr, 0);
   pack.version = model->version().toUInt(nullptr, 0);
+  pack.parameters = model->parameters();
 
   for(auto &node : model->nodes())
   {
     if (auto asset = node_cast<PackModel::Asset>(node))
     {
+      if (!groups.isEmpty() && !groups.contains(asset->fullname().section('/', 0, 0)))
+        continue;
+
       pack.add(asset->document());
 
       pack.catalog.emplace_back(pack.assets.back()->id, asset->fullname().toStdString());
@@ -144,17 +243,12 @@ void PackManager::build(PackModel const *model, QString const &filename, Ui::Bui
 
   write_catl_asset(fout, 0, pack.signature, pack.version, pack.catalog);
 
-  dlg->Message->setText("Building...");
-
   uint32_t head = 0;
 
   while (head < pack.assets.size())
   {
     auto &asset = *pack.assets[head];
 
-    dlg->Message->setText(QString("Building: %1").arg(asset.name));
-    dlg->TotalProgress->setValue(100 * head / pack.assets.size());
-
     for(size_t i = head; i < pack.assets.size(); ++i)
     {
       auto &asset = *pack.assets[i];
@@ -163,6 +257,8 @@ void PackManager::build(PackModel const *model, QString const &filename, Ui::Bui
       {
         asset.status = BuildState::Asset::Building;
 
+        asset.timer.start();
+
         buildmanager->request_build(asset.document, &pack, [&](Studio::Document *document, QString const &path) { asset.buildpath = path.toStdString(); asset.status = BuildState::Asset::Packing; }, [&](Studio::Document *document) { asset.status = BuildState::Asset::Packing; });
       }
     }
@@ -175,6 +271,10 @@ void PackManager::build(PackModel const *model, QString const &filename, Ui::Bui
       {
         try
         {
+          // keyed by document path, as the build spans are
+
+          Studio::TraceScope trace("pack", Studio::Core::instance()->find_object<Studio::DocumentManager>()->path(asset.document));
+
           QMetaObject::invokeMethod(packer, "pack", Qt::DirectConnection, Q_RETURN_ARG(bool, result), Q_ARG(Studio::PackerState&, asset), Q_ARG(std::ofstream&, fout));
         }
         catch(exception &e)
@@ -188,11 +288,16 @@ void PackManager::build(PackModel const *model, QString const &filename, Ui::Bui
       }
 
       asset.status = (result) ? BuildState::Asset::Done : BuildState::Asset::Failed;
+
+      if (result)
+      {
+        qInfo().noquote() << QString("Packed %1 (%2) in %3ms").arg(asset.name, asset.type).arg(asset.timer.elapsed());
+      }
     }
 
     if (asset.status == BuildState::Asset::Failed)
     {
-      dlg->Message->setText("Build Failed");
+      report("Build Failed", 100 * head / pack.assets.size());
       break;
     }
 
@@ -201,25 +306,50 @@ void PackManager::build(PackModel const *model, QString const &filename, Ui::Bui
       ++head;
     }
 
-    if (cancel)
+    if (!report(QString("Building: %1").arg(pack.assets[min<size_t>(head, pack.assets.size()-1)]->name), 100 * head / pack.assets.size()))
     {
-      dlg->Message->setText("Build Cancelled");
+      report("Build Cancelled", 100 * head / pack.assets.size());
       break;
     }
-
-    qApp->processEvents();
   }
 
   write_chunk(fout, "HEND", 0, nullptr);
 
-  if (head == pack.assets.size())
+  fout.close();
+
+  if (head != pack.assets.size())
+    return false;
+
+  qInfo().noquote() << QString("Packed %1 assets in %2ms").arg(pack.assets.size()).arg(timer.elapsed());
+
+  try
   {
-    dlg->Message->setText("Build Complete...");
-    dlg->TotalProgress->setValue(100);
-    dlg->Export->setEnabled(true);
+    QHash<uint32_t, PackReport::Entry> assets;
+
+    assets.insert(0, { 0, "Catalog", "Catalog", QString(), 0 });
+
+    for(auto &asset : pack.assets)
+      assets.insert(asset->id, { asset->id, asset->name, asset->type, QString(), 0 });
+
+    PackReport current;
+
+    current.analyse(filename, assets);
+
+    current.save(reportfile);
+
+    auto text = current.summary(previous);
+
+    qInfo().noquote() << text;
+
+    if (summary)
+      *summary = text;
+  }
+  catch(exception &e)
+  {
+    qWarning() << "Pack Report Error:" << e.what();
   }
 
-  dlg->Close->setText("Close");
+  report("Build Complete...", 100);
 
-  QObject::disconnect(closesignal);
+  return true;
 }
@@ -11,6 +11,7 @@
 #include "packapi.h"
 #include "packmodel.h"
 #include "ui_build.h"
+#include <functional>
 
 //-------------------------- PackManager ------------------------------------
 //---------------------------------------------------------------------------
@@ -24,11 +25,21 @@ class PackManager : public Studio::PackManager
 
     void register_packer(QString const &type, QObject *packer);
 
+    void set_trace(bool enabled);
+
+    bool build(QString const &projectfile, QString const &filename, QStringList const &groups);
+
     void build(PackModel const *model, QString const &filename, Ui::Build *dlg);
 
+  private:
+
+    bool build(PackModel const *model, QStringList const &groups, QString const &filename, std::function<bool (QString const &message, int progress)> const &report, QString *summary = nullptr);
+
   private:
 
     QMap<QString, QObject*> m_packers;
+
+    bool m_trace;
 };
 
 
@@ -31,6 +31,8 @@ namespace Studio
     uint32_t index;
     std::string buildpath;
 
+    QMap<QString, QString> parameters;
+
     virtual uint32_t add_dependant(Studio::Document *document, QString type) = 0;
     virtual uint32_t add_dependant(Studio::Document *document, uint32_t index, QString type) = 0;
   };
@@ -46,6 +48,8 @@ namespace Studio
 
       virtual void register_packer(QString const &type, QObject *packer) = 0;
 
+      virtual bool build(QString const &projectfile, QString const &filename, QStringList const &groups) = 0;
+
     protected:
       virtual ~PackManager() { }
   };
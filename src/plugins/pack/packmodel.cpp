@@ -7,6 +7,7 @@
 //
 
 #include "packmodel.h"
+#include "workqueue.h"
 #include <leap.h>
 #include <QDir>
 #include <fstream>
@@ -81,9 +82,16 @@ PackModel::Node *PackModel::Node::remove(Node *node)
 
 ///////////////////////// Asset::Constructor ////////////////////////
 PackModel::Asset::Asset(QString const &path)
+  : Asset(path, Studio::Core::instance()->find_object<Studio::DocumentManager>()->open(path))
+{
+}
+
+
+///////////////////////// Asset::Constructor ////////////////////////
+PackModel::Asset::Asset(QString const &path, Studio::Document *document)
 {
   m_path = path;
-  m_document = Studio::Core::instance()->find_object<Studio::DocumentManager>()->open(path);
+  m_document = document;
 }
 
 
@@ -153,12 +161,38 @@ PackModel::PackModel(QObject *parent)
   auto documentmanager = Studio::Core::instance()->find_object<Studio::DocumentManager>();
 
   connect(documentmanager, &Studio::DocumentManager::document_renamed, this, &PackModel::on_document_renamed);
+  connect(documentmanager, &Studio::DocumentManager::documents_changed, this, [=](QVector<Studio::DocumentManager::Change> const &changes) { for(auto &change : changes) { if (change.dst != "" && change.dst != change.src) on_document_renamed(change.document, change.src, change.dst); } });
+
+  connect(this, &PackModel::loaded, this, &PackModel::on_loaded, Qt::QueuedConnection);
+}
+
+
+///////////////////////// PackModel::Destructor /////////////////////////////
+PackModel::~PackModel()
+{
+  if (m_loading)
+  {
+    lock_guard<mutex> lock(m_loading->mutex);
+
+    m_loading->model = nullptr;
+  }
 }
 
 
 ///////////////////////// PackModel::clear //////////////////////////////////
 void PackModel::clear()
 {
+  // a load still in flight is orphaned, its documents close as it drains
+
+  if (m_loading)
+  {
+    lock_guard<mutex> lock(m_loading->mutex);
+
+    m_loading->model = nullptr;
+  }
+
+  m_loading = nullptr;
+
   m_root = unique_ptr<Group>(new Group("Root"));
 
   m_parameters.clear();
@@ -243,6 +277,18 @@ void PackModel::erase(Node *node)
 
   emit removed(node);
 
+  if (m_loading)
+  {
+    for(auto &asset : m_loading->assets)
+    {
+      for(Node *ancestor = asset; ancestor; ancestor = ancestor->parent())
+      {
+        if (ancestor == node)
+          asset = nullptr;
+      }
+    }
+  }
+
   delete node;
 
   m_modified = true;
@@ -309,6 +355,11 @@ void PackModel::load(string const &projectfile)
 
   QDir base = QFileInfo(projectfile.c_str()).dir();
 
+  // the tree is built quietly with documents opened in parallel on the
+  // work queue, views are populated once by the reset in on_loaded
+
+  vector<Asset*> assets;
+
   vector<Node*> groupstack = { root() };
 
   while (getline(fin, buffer))
@@ -335,7 +386,7 @@ void PackModel::load(string const &projectfile)
       {
         auto name = line.substr(13, line.size() - 15).to_string();
 
-        auto group = add_group(groupstack.back(), groupstack.back()->children(), name.c_str());
+        auto group = groupstack.back()->insert(groupstack.back()->children(), new Group(name.c_str()));
 
         groupstack.push_back(group);
       }
@@ -348,13 +399,74 @@ void PackModel::load(string const &projectfile)
       continue;
     }
 
-    add_asset(groupstack.back(), groupstack.back()->children(), base.filePath(QString::fromUtf8(line.data(), line.size())));
+    auto asset = new Asset(base.filePath(QString::fromUtf8(line.data(), line.size())), nullptr);
+
+    groupstack.back()->insert(groupstack.back()->children(), asset);
+
+    assets.push_back(asset);
+  }
+
+  auto loading = make_shared<Loading>();
+
+  loading->model = this;
+  loading->assets = assets;
+  loading->documents.resize(assets.size());
+  loading->remaining = assets.size();
+
+  m_loading = loading;
+
+  for(size_t i = 0; i < assets.size(); ++i)
+  {
+    Studio::WorkQueue::instance()->push([loading, i, path = assets[i]->path()]() {
+
+      unique_document document = Studio::Core::instance()->find_object<Studio::DocumentManager>()->open(path);
+
+      lock_guard<mutex> lock(loading->mutex);
+
+      loading->documents[i] = std::move(document);
+
+      if (--loading->remaining == 0 && loading->model)
+        emit loading->model->loaded();
+
+    }, Studio::WorkQueue::Priority::Interactive);
+  }
+
+  if (assets.empty())
+  {
+    on_loaded();
   }
 
   m_modified = false;
 }
 
 
+///////////////////////// PackModel::on_loaded //////////////////////////////
+void PackModel::on_loaded()
+{
+  if (!m_loading)
+    return;
+
+  {
+    lock_guard<mutex> lock(m_loading->mutex);
+
+    // a signal from a superseded load
+
+    if (m_loading->remaining != 0)
+      return;
+
+    for(size_t i = 0; i < m_loading->assets.size(); ++i)
+    {
+      if (auto asset = m_loading->assets[i])
+        asset->m_document = std::move(m_loading->documents[i]);
+    }
+  }
+
+  m_loading = nullptr;
+
+  emit reset();
+}
+
+
 ///////////////////////// PackModel::save ///////////////////////////////////
 void PackModel::save(string const &projectfile)
 {
@@ -11,6 +11,7 @@
 #include "documentapi.h"
 #include <vector>
 #include <memory>
+#include <mutex>
 #include <QObject>
 
 //-------------------------- PackModel --------------------------------------
@@ -82,6 +83,7 @@ class PackModel : public QObject
 
       protected:
         Asset(QString const &path);
+        Asset(QString const &path, Studio::Document *document);
 
         void set_data(DataRole role, QVariant const &value);
 
@@ -112,11 +114,14 @@ class PackModel : public QObject
 
   public:
     PackModel(QObject *parent = 0);
+    ~PackModel();
 
     void clear();
 
     bool modified() const { return m_modified; }
 
+    bool loading() const { return m_loading != nullptr; }
+
     Node *add_group(Node *parent, size_t index, QString const &name);
     Node *add_asset(Node *parent, size_t index, QString const &path);
 
@@ -200,6 +205,8 @@ class PackModel : public QObject
     QString signature() const { return m_parameters["signature"]; }
     QString version() const { return m_parameters["version"]; }
 
+    QMap<QString, QString> const &parameters() const { return m_parameters; }
+
     void set_parameter(QString const &name, QString const &value);
 
   public:
@@ -217,14 +224,35 @@ class PackModel : public QObject
     void adding(PackModel::Node *parent, size_t index);
     void removing(PackModel::Node *parent, size_t index);
 
+    void loaded();
+
   protected:
 
     void on_document_renamed(Studio::Document *document, QString const &src, QString const &dst);
 
+    void on_loaded();
+
   private:
 
     bool m_modified;
 
+    // load opens the asset documents on the work queue, the last to land
+    // signals the gui thread to hand them to their assets and reset
+
+    struct Loading
+    {
+      std::mutex mutex;
+
+      PackModel *model;
+
+      std::vector<Asset*> assets;
+      std::vector<unique_document> documents;
+
+      size_t remaining;
+    };
+
+    std::shared_ptr<Loading> m_loading;
+
     std::unique_ptr<Node> m_root;
 
     QMap<QString, QString> m_parameters;
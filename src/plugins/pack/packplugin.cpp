@@ -29,6 +29,7 @@ using namespace std;
 
 ///////////////////////// PackPlugin::Constructor ///////////////////////////
 PackPlugin::PackPlugin()
+  : m_container(nullptr)
 {
 }
 
@@ -47,6 +48,11 @@ bool PackPlugin::initialise(QStringList const &arguments, QString *errormsg)
 
   Studio::Core::instance()->add_object(m_manager);
 
+  m_manager->set_trace(arguments.contains("--trace") || QSettings().value("pack/trace", false).toBool());
+
+  if (arguments.contains("--headless"))
+    return true;
+
   auto mainwindow = Studio::Core::instance()->find_object<Studio::MainWindow>();
 
   auto actionmanager = Studio::Core::instance()->find_object<Studio::ActionManager>();
@@ -138,6 +144,9 @@ bool PackPlugin::initialise(QStringList const &arguments, QString *errormsg)
 ///////////////////////// PackPlugin::shutdown //////////////////////////////
 void PackPlugin::shutdown()
 {
+  if (!m_container)
+    return;
+
   QSettings settings;
 
   settings.setValue("packplugin/splitter", ui.Splitter->saveState());
@@ -463,10 +472,12 @@ void PackPlugin::on_PackProperties_triggered()
 
   dlg.ui.Signature->setText(m_pack->signature());
   dlg.ui.Version->setText(m_pack->version());
+  dlg.ui.Shaders->setCurrentIndex(max(dlg.ui.Shaders->findText(m_pack->parameters().value("shaders"), Qt::MatchFixedString), 0));
 
   if (dlg.exec() == QDialog::Accepted)
   {
     m_pack->set_parameter("signature", dlg.ui.Signature->text());
     m_pack->set_parameter("version", dlg.ui.Version->text());
+    m_pack->set_parameter("shaders", (dlg.ui.Shaders->currentIndex() != 0) ? dlg.ui.Shaders->currentText().toLower() : "");
   }
 }
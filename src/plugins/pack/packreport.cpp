@@ -0,0 +1,330 @@
+//
+// Pack Report
+//
+
+//
+// Copyright (C) 2016 Peter Niekamp
+//
+
+#include "packreport.h"
+#include "assetpacker.h"
+#include <QFile>
+#include <QSaveFile>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QJsonArray>
+#include <QTextStream>
+#include <QMap>
+#include <fstream>
+#include <algorithm>
+
+#include <QtDebug>
+
+using namespace std;
+
+namespace
+{
+  QString format_name(uint32_t format)
+  {
+    switch(format)
+    {
+      case PackImageHeader::rgba:
+        return "rgba";
+
+      case PackImageHeader::rgba_bc3:
+        return "rgba_bc3";
+
+      case PackImageHeader::rgbe:
+        return "rgbe";
+
+      default:
+        return QString("format %1").arg(format);
+    }
+  }
+
+  QString size_string(qint64 bytes)
+  {
+    if (qAbs(bytes) < 1024)
+      return QString("%1 B").arg(bytes);
+
+    if (qAbs(bytes) < 1024*1024)
+      return QString("%1 KB").arg(bytes / 1024.0, 0, 'f', 1);
+
+    return QString("%1 MB").arg(bytes / (1024.0*1024.0), 0, 'f', 2);
+  }
+
+  QString delta_string(qint64 bytes)
+  {
+    return ((bytes < 0) ? "-" : "+") + size_string(qAbs(bytes));
+  }
+
+  template<typename Key>
+  QMap<QString, qint64> tally(QVector<PackReport::Entry> const &entries, Key key)
+  {
+    QMap<QString, qint64> result;
+
+    for(auto &entry : entries)
+      result[key(entry)] += entry.bytes;
+
+    return result;
+  }
+
+  void write_breakdown(QTextStream &out, QString const &title, QMap<QString, qint64> const &current, QMap<QString, qint64> const &previous)
+  {
+    out << title << "\n";
+
+    auto keys = current.keys();
+
+    for(auto &key : previous.keys())
+    {
+      if (!current.contains(key))
+        keys.append(key);
+    }
+
+    for(auto &key : keys)
+    {
+      auto bytes = current.value(key);
+      auto delta = bytes - previous.value(key);
+
+      out << QString("  %1 %2").arg(key, -24).arg(size_string(bytes), 12);
+
+      if (delta != 0)
+        out << QString(" (%1)").arg(delta_string(delta));
+
+      out << "\n";
+    }
+  }
+}
+
+
+//|---------------------- PackReport ----------------------------------------
+//|--------------------------------------------------------------------------
+
+///////////////////////// PackReport::analyse ///////////////////////////////
+void PackReport::analyse(QString const &packfile, QHash<uint32_t, Entry> const &assets)
+{
+  m_entries.clear();
+
+  ifstream fin(packfile.toUtf8(), ios::binary);
+
+  if (!fin)
+    throw runtime_error("Unable to open pack for analysis");
+
+  PackHeader header;
+  fin.read((char*)&header, sizeof(header));
+
+  if (header.signature[0] != 0xD9 || header.signature[1] != 'S' || header.signature[2] != 'V' || header.signature[3] != 'A')
+    throw runtime_error("Invalid pack file");
+
+  Entry *current = nullptr;
+
+  uint64_t position = sizeof(PackHeader);
+
+  while (fin)
+  {
+    PackChunk chunk;
+
+    fin.seekg(position);
+    fin.read((char*)&chunk, sizeof(chunk));
+
+    if (!fin || chunk.type == "HEND"_packchunktype)
+      break;
+
+    if (chunk.type == "ASET"_packchunktype)
+    {
+      PackAssetHeader aset;
+
+      fin.read((char*)&aset, sizeof(aset));
+
+      m_entries.push_back(assets.value(aset.id, { aset.id, QString("Asset %1").arg(aset.id), QString(), QString(), 0 }));
+
+      current = &m_entries.back();
+
+      current->id = aset.id;
+      current->format.clear();
+      current->bytes = 0;
+    }
+
+    if (current)
+    {
+      if (current->format.isEmpty() && chunk.type != "ASET"_packchunktype)
+      {
+        // the first chunk after ASET is the asset header, name its format
+
+        if (chunk.type == "IMAG"_packchunktype)
+        {
+          PackImageHeader imag;
+
+          fin.read((char*)&imag, sizeof(imag));
+
+          current->format = format_name(imag.format);
+        }
+        else
+        {
+          current->format = QString::fromLatin1((char const *)&chunk.type, sizeof(chunk.type)).toLower();
+        }
+
+        if (current->type.isEmpty())
+          current->type = current->format;
+      }
+
+      current->bytes += chunk.length + sizeof(chunk) + sizeof(uint32_t);
+
+      if (chunk.type == "AEND"_packchunktype)
+        current = nullptr;
+    }
+
+    position += chunk.length + sizeof(chunk) + sizeof(uint32_t);
+  }
+}
+
+
+///////////////////////// PackReport::load //////////////////////////////////
+bool PackReport::load(QString const &file)
+{
+  m_entries.clear();
+
+  QFile fin(file);
+
+  if (!fin.open(QIODevice::ReadOnly))
+    return false;
+
+  auto report = QJsonDocument::fromJson(fin.readAll()).object();
+
+  for(auto const &value : report["assets"].toArray())
+  {
+    auto asset = value.toObject();
+
+    m_entries.push_back({ (uint32_t)asset["id"].toDouble(), asset["name"].toString(), asset["type"].toString(), asset["format"].toString(), (qint64)asset["bytes"].toDouble() });
+  }
+
+  return true;
+}
+
+
+///////////////////////// PackReport::save //////////////////////////////////
+void PackReport::save(QString const &file) const
+{
+  QJsonArray assets;
+
+  for(auto &entry : m_entries)
+  {
+    QJsonObject asset;
+
+    asset["id"] = (double)entry.id;
+    asset["name"] = entry.name;
+    asset["type"] = entry.type;
+    asset["format"] = entry.format;
+    asset["bytes"] = (double)entry.bytes;
+
+    assets.append(asset);
+  }
+
+  QJsonObject report;
+
+  report["total"] = (double)total();
+  report["assets"] = assets;
+
+  QSaveFile fout(file);
+
+  if (!fout.open(QIODevice::WriteOnly))
+  {
+    qWarning() << "Unable to write pack report" << file;
+    return;
+  }
+
+  fout.write(QJsonDocument(report).toJson());
+
+  fout.commit();
+}
+
+
+///////////////////////// PackReport::total /////////////////////////////////
+qint64 PackReport::total() const
+{
+  qint64 result = 0;
+
+  for(auto &entry : m_entries)
+    result += entry.bytes;
+
+  return result;
+}
+
+
+///////////////////////// PackReport::summary ///////////////////////////////
+QString PackReport::summary(PackReport const &previous) const
+{
+  QString result;
+  QTextStream out(&result);
+
+  out << QString("Pack Size: %1 in %2 assets").arg(size_string(total())).arg(m_entries.size());
+
+  if (!previous.m_entries.isEmpty())
+    out << QString(" (%1)").arg(delta_string(total() - previous.total()));
+
+  out << "\n\n";
+
+  write_breakdown(out, "By Type:", tally(m_entries, [](Entry const &entry) { return entry.type; }), tally(previous.m_entries, [](Entry const &entry) { return entry.type; }));
+
+  out << "\n";
+
+  write_breakdown(out, "By Format:", tally(m_entries, [](Entry const &entry) { return entry.format; }), tally(previous.m_entries, [](Entry const &entry) { return entry.format; }));
+
+  // asset ids shift between builds, so diff by name and type
+
+  auto key = [](Entry const &entry) { return QString("%1 (%2)").arg(entry.name, entry.type); };
+
+  auto current = tally(m_entries, key);
+  auto before = tally(previous.m_entries, key);
+
+  vector<pair<QString, qint64>> changes;
+
+  for(auto i = current.begin(); i != current.end(); ++i)
+  {
+    if (i.value() != before.value(i.key(), -1))
+      changes.emplace_back(i.key(), i.value() - before.value(i.key()));
+  }
+
+  for(auto i = before.begin(); i != before.end(); ++i)
+  {
+    if (!current.contains(i.key()))
+      changes.emplace_back(i.key(), -i.value());
+  }
+
+  if (!previous.m_entries.isEmpty() && !changes.empty())
+  {
+    sort(changes.begin(), changes.end(), [](auto &lhs, auto &rhs) { return qAbs(lhs.second) > qAbs(rhs.second); });
+
+    out << "\nLargest Changes:\n";
+
+    for(size_t i = 0; i < min<size_t>(changes.size(), 10); ++i)
+    {
+      auto &change = changes[i];
+
+      out << QString("  %1 %2").arg(delta_string(change.second), 12).arg(change.first);
+
+      if (!before.contains(change.first))
+        out << " [new]";
+
+      if (!current.contains(change.first))
+        out << " [removed]";
+
+      out << "\n";
+    }
+  }
+
+  out << "\nLargest Assets:\n";
+
+  auto largest = m_entries;
+
+  sort(largest.begin(), largest.end(), [](auto &lhs, auto &rhs) { return lhs.bytes > rhs.bytes; });
+
+  for(int i = 0; i < min(largest.size(), 10); ++i)
+  {
+    out << QString("  %1 %2 %3").arg(size_string(largest[i].bytes), 12).arg(key(largest[i])).arg(largest[i].format) << "\n";
+  }
+
+  out.flush();
+
+  return result;
+}
@@ -0,0 +1,50 @@
+//
+// Pack Report
+//
+
+//
+// Copyright (C) 2016 Peter Niekamp
+//
+
+#pragma once
+
+#include <QString>
+#include <QHash>
+#include <QVector>
+
+//-------------------------- PackReport -------------------------------------
+//---------------------------------------------------------------------------
+
+// bytes per asset of a built pack, gathered by walking the pack chunks.
+// saved beside the pack so the next build can be diffed against it
+
+class PackReport
+{
+  public:
+
+    struct Entry
+    {
+      uint32_t id;
+      QString name;
+      QString type;
+      QString format;
+      qint64 bytes;
+    };
+
+  public:
+
+    void analyse(QString const &packfile, QHash<uint32_t, Entry> const &assets);
+
+    bool load(QString const &file);
+    void save(QString const &file) const;
+
+    qint64 total() const;
+
+    QString summary(PackReport const &previous) const;
+
+    QVector<Entry> const &entries() const { return m_entries; }
+
+  private:
+
+    QVector<Entry> m_entries;
+};
@@ -9,6 +9,7 @@
 #include "particlesystem.h"
 #include "spritesheet.h"
 #include "assetfile.h"
+#include "definition.h"
 #include "atlaspacker.h"
 #include <leap/lml/interpolation.h>
 #include <functional>
@@ -309,22 +310,7 @@ void ParticleSystemDocument::create(string const &path)
 ///////////////////////// hash //////////////////////////////////////////////
 void ParticleSystemDocument::hash(Studio::Document *document, size_t *key)
 {
-  QJsonObject definition;
-
-  document->lock();
-
-  PackTextHeader text;
-
-  if (read_asset_header(document, 1, &text))
-  {
-    QByteArray payload(pack_payload_size(text), 0);
-
-    read_asset_payload(document, text.dataoffset, payload.data(), payload.size());
-
-    definition = QJsonDocument::fromBinaryData(payload).object();
-  }
-
-  document->unlock();
+  auto definition = DefinitionCache::instance()->read(document);
 
   *key = std::hash<double>{}(document->metadata("build", 0.0));
 
@@ -361,6 +347,7 @@ ParticleSystemDocument::ParticleSystemDocument()
   auto documentmanager = Studio::Core::instance()->find_object<Studio::DocumentManager>();
 
   connect(documentmanager, &Studio::DocumentManager::document_changed, this, &ParticleSystemDocument::touch);
+  connect(documentmanager, &Studio::DocumentManager::documents_changed, this, [=](QVector<Studio::DocumentManager::Change> const &changes) { for(auto &change : changes) { if (change.document && change.dst == change.src) touch(change.document, change.dst); } });
 }
 
 
@@ -582,20 +569,7 @@ void ParticleSystemDocument::touch(Studio::Document *document, QString const &pa
 ///////////////////////// ParticleSystemDocument::refresh ///////////////////
 void ParticleSystemDocument::refresh()
 {
-  m_document->lock();
-
-  PackTextHeader text;
-
-  if (read_asset_header(m_document, 1, &text))
-  {
-    QByteArray payload(pack_payload_size(text), 0);
-
-    read_asset_payload(m_document, text.dataoffset, payload.data(), payload.size());
-
-    m_definition = QJsonDocument::fromBinaryData(payload).object();
-  }
-
-  m_document->unlock();
+  m_definition = DefinitionCache::instance()->read(m_document);
 
   auto bound = m_definition["bound"].toObject();
 
@@ -688,20 +662,5 @@ void ParticleSystemDocument::refresh()
 ///////////////////////// ParticleSystemDocument::update ////////////////////
 void ParticleSystemDocument::update()
 {
-  QByteArray data = QJsonDocument(m_definition).toBinaryData();
-
-  m_document->lock_exclusive();
-
-  PackTextHeader text;
-
-  if (auto position = read_asset_header(m_document, 1, &text))
-  {
-    position += write_text_asset(m_document, position, 1, data.size(), data.data());
-
-    position += write_footer(m_document, position);
-
-    m_document->set_metadata("build", buildtime());
-  }
-
-  m_document->unlock_exclusive();
+  DefinitionCache::instance()->write(m_document, m_definition);
 }
@@ -107,7 +107,7 @@ void ParticleView::refresh()
     {
       auto buildmanager = Studio::Core::instance()->find_object<Studio::BuildManager>();
 
-      buildmanager->request_build(m_spritesheetdocument, this, &ParticleView::on_spritesheet_build_complete);
+      buildmanager->request_preview(m_spritesheetdocument, this, &ParticleView::on_spritesheet_build_complete);
     }
   }
 
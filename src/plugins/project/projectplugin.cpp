@@ -41,6 +41,9 @@ bool ProjectPlugin::initialise(QStringList const &arguments, QString *errormsg)
 {
   Studio::Core::instance()->add_object(new ProjectManager);
 
+  if (arguments.contains("--headless"))
+    return true;
+
   auto actionmanager = Studio::Core::instance()->find_object<Studio::ActionManager>();
 
   auto saveproject = new QAction(QIcon(":/projectplugin/filesave.png"), "Save Project", this);
@@ -10,11 +10,22 @@
 #include "contentapi.h"
 #include "buildapi.h"
 #include "assetfile.h"
+#include "hashcache.h"
+#include "trace.h"
 #include "glslang/Public/ShaderLang.h"
 #include "SPIRV/GlslangToSpv.h"
 #include "resourcelimits.h"
+#if defined(HAVE_SPIRVTOOLS)
+#include "spirv-tools/optimizer.hpp"
+#endif
 #include <QFileInfo>
+#include <QDir>
+#include <QSaveFile>
+#include <QCryptographicHash>
+#include <QHash>
+#include <QElapsedTimer>
 #include <QtPlugin>
+#include <mutex>
 
 #include <QDebug>
 
@@ -27,9 +38,9 @@ namespace
     seed ^= key + 0x9e3779b9 + (seed<<6) + (seed>>2);
   }
 
-  size_t hash_shader(Studio::Document *document)
+  string read_source(Studio::Document *document)
   {
-    size_t key = std::hash<double>{}(document->metadata("build", 0.0));
+    string payload;
 
     document->lock();
 
@@ -37,95 +48,260 @@ namespace
 
     if (read_asset_header(document, 1, &text))
     {
-      string payload(pack_payload_size(text), 0);
+      payload.resize(pack_payload_size(text));
 
       read_asset_payload(document, text.dataoffset, &payload[0], payload.size());
+    }
+
+    document->unlock();
 
-      stringstream stream(payload);
+    return payload;
+  }
 
-      string buffer;
+  template<typename Func>
+  void for_each_line(string const &source, Func &&func)
+  {
+    size_t beg = 0;
 
-      while (getline(stream, buffer))
-      {
-        if (buffer.substr(0, 8) == "#include")
-        {
-          auto path = string(buffer.begin() + buffer.find_first_of('"') + 1, buffer.begin() + buffer.find_last_of('"')) + ".asset";
+    while (beg < source.size())
+    {
+      auto end = source.find('\n', beg);
+
+      if (end == string::npos)
+        end = source.size();
+
+      func(source.substr(beg, end - beg));
+
+      beg = end + 1;
+    }
+  }
+
+  QString include_path(Studio::Document *document, string const &line)
+  {
+    auto path = string(line.begin() + line.find_first_of('"') + 1, line.begin() + line.find_last_of('"')) + ".asset";
 
+    return fullpath(document, path.c_str());
+  }
+
+  size_t hash_shader(Studio::Document *document)
+  {
+    // memoised, an include change invalidates only the shaders that use it
+
+    return HashCache::instance()->hash(document, "hash", [&](QStringList &dependencies) {
+
+      size_t key = std::hash<double>{}(document->metadata("build", 0.0));
+
+      for_each_line(read_source(document), [&](string const &line) {
+
+        if (line.compare(0, 8, "#include") == 0)
+        {
           auto documentmanager = Studio::Core::instance()->find_object<Studio::DocumentManager>();
 
-          if (auto includedocument = documentmanager->open(fullpath(document, path.c_str())))
+          dependencies.push_back(include_path(document, line));
+
+          if (auto includedocument = documentmanager->open(dependencies.back()))
           {
             hash_combine(key, hash_shader(includedocument));
 
             documentmanager->close(includedocument);
           }
         }
-      }
-    }
+      });
 
-    document->unlock();
-
-    return key;
+      return key;
+    });
   }
 
+  //|---------------------- SourceCache -------------------------------------
+  //|------------------------------------------------------------------------
+
+  // preprocessed (include expanded) source by document path, valid while
+  // the document hash matches
+
+  struct SourceEntry
+  {
+    size_t key;
+    string source;
+  };
+
+  mutex sourcemutex;
+
+  QHash<QString, SourceEntry> sourcecache;
+
   string load_shader(Studio::Document *document)
   {
     auto documentmanager = Studio::Core::instance()->find_object<Studio::DocumentManager>();
 
-    int line = 1;
+    auto key = hash_shader(document);
 
-    auto name = QFileInfo(documentmanager->path(document)).completeBaseName().toStdString();
+    auto path = documentmanager->path(document);
 
-    string shader = "#line " + to_string(line) + " \"" + name + "\"\n";
+    {
+      lock_guard<mutex> lock(sourcemutex);
 
-    document->lock();
+      auto entry = sourcecache.find(path);
 
-    PackTextHeader text;
+      if (entry != sourcecache.end() && entry->key == key)
+        return entry->source;
+    }
 
-    if (read_asset_header(document, 1, &text))
-    {
-      string payload(pack_payload_size(text), 0);
+    int line = 1;
 
-      read_asset_payload(document, text.dataoffset, &payload[0], payload.size());
+    auto name = QFileInfo(path).completeBaseName().toStdString();
+
+    string shader = "#line " + to_string(line) + " \"" + name + "\"\n";
 
-      stringstream stream(payload);
+    for_each_line(read_source(document), [&](string buffer) {
 
-      string buffer;
+      ++line;
 
-      while (getline(stream, buffer))
+      if (buffer.compare(0, 8, "#version") == 0)
       {
-        ++line;
+        shader = "";
+        buffer += "\n#extension GL_GOOGLE_cpp_style_line_directive : enable\n";
+        buffer += "\n#line " + to_string(line) + " \"" + name + "\"";
+      }
 
-        if (buffer.substr(0, 8) == "#version")
+      if (buffer.compare(0, 8, "#include") == 0)
+      {
+        if (auto includedocument = documentmanager->open(include_path(document, buffer)))
         {
-          shader = "";
-          buffer += "\n#extension GL_GOOGLE_cpp_style_line_directive : enable\n";
+          buffer = load_shader(includedocument);
+
           buffer += "\n#line " + to_string(line) + " \"" + name + "\"";
+
+          documentmanager->close(includedocument);
         }
+      }
 
-        if (buffer.substr(0, 8) == "#include")
-        {
-          auto path = string(buffer.begin() + buffer.find_first_of('"') + 1, buffer.begin() + buffer.find_last_of('"')) + ".asset";
+      shader += buffer + '\n';
+    });
 
-          auto documentmanager = Studio::Core::instance()->find_object<Studio::DocumentManager>();
+    lock_guard<mutex> lock(sourcemutex);
 
-          if (auto includedocument = documentmanager->open(fullpath(document, path.c_str())))
-          {
-            buffer = load_shader(includedocument);
+    sourcecache[path] = { key, shader };
 
-            buffer += "\n#line " + to_string(line) + " \"" + name + "\"";
+    return shader;
+  }
 
-            documentmanager->close(includedocument);
-          }
-        }
+  //|---------------------- spirv cache -------------------------------------
+  //|------------------------------------------------------------------------
+
+  // compiled spirv by digest of the preprocessed source, shared by every
+  // shader (and every rebuild) that expands to the same text
+
+  QString spirv_cache_path(string const &source, EShLanguage stage)
+  {
+    auto buildmanager = Studio::Core::instance()->find_object<Studio::BuildManager>();
 
-        shader += buffer + '\n';
+    QCryptographicHash digest(QCryptographicHash::Sha1);
+
+    digest.addData(source.data(), source.size());
+    digest.addData(reinterpret_cast<const char*>(&stage), sizeof(stage));
+
+    return buildmanager->basepath() + "/spirv/" + digest.result().toHex() + ".spv";
+  }
+
+  bool read_spirv_cache(QString const &path, vector<unsigned int> &spirv)
+  {
+    QFile fin(path);
+
+    if (!fin.open(QIODevice::ReadOnly) || fin.size() == 0 || fin.size() % sizeof(unsigned int) != 0)
+      return false;
+
+    spirv.resize(fin.size() / sizeof(unsigned int));
+
+    return fin.read(reinterpret_cast<char*>(spirv.data()), fin.size()) == fin.size();
+  }
+
+  void write_spirv_cache(QString const &path, vector<unsigned int> const &spirv)
+  {
+    QDir().mkpath(QFileInfo(path).path());
+
+    QSaveFile fout(path);
+
+    if (fout.open(QIODevice::WriteOnly))
+    {
+      fout.write(reinterpret_cast<const char*>(spirv.data()), spirv.size()*sizeof(unsigned int));
+
+      fout.commit();
+    }
+  }
+
+  //|---------------------- spirv passes ------------------------------------
+  //|------------------------------------------------------------------------
+
+  // drop debug instructions (names, source text, line info), the module
+  // stays valid as nothing semantic refers to them
+
+  void strip_spirv(vector<unsigned int> &spirv)
+  {
+    const unsigned int OpSourceContinued = 2;
+    const unsigned int OpSource = 3;
+    const unsigned int OpSourceExtension = 4;
+    const unsigned int OpName = 5;
+    const unsigned int OpMemberName = 6;
+    const unsigned int OpString = 7;
+    const unsigned int OpLine = 8;
+    const unsigned int OpNoLine = 317;
+    const unsigned int OpModuleProcessed = 330;
+
+    if (spirv.size() < 5)
+      return;
+
+    size_t head = 5;
+
+    for(size_t i = 5; i < spirv.size(); )
+    {
+      auto opcode = spirv[i] & 0xffff;
+      auto count = spirv[i] >> 16;
+
+      if (count == 0 || i + count > spirv.size())
+        throw runtime_error("Shader pack failed - invalid spirv");
+
+      switch (opcode)
+      {
+        case OpSourceContinued:
+        case OpSource:
+        case OpSourceExtension:
+        case OpName:
+        case OpMemberName:
+        case OpString:
+        case OpLine:
+        case OpNoLine:
+        case OpModuleProcessed:
+          break;
+
+        default:
+          move(spirv.begin() + i, spirv.begin() + i + count, spirv.begin() + head);
+          head += count;
       }
+
+      i += count;
     }
 
-    document->unlock();
+    spirv.resize(head);
+  }
 
-    return shader;
+  // dead code elimination, constant folding and inlining, needs SPIRV-Tools,
+  // without it an optimise request degrades to a strip
+
+  void optimise_spirv(vector<unsigned int> &spirv)
+  {
+#if defined(HAVE_SPIRVTOOLS)
+    spvtools::Optimizer optimizer(SPV_ENV_VULKAN_1_0);
+
+    optimizer.RegisterPerformancePasses();
+
+    vector<uint32_t> result;
+
+    if (!optimizer.Run(spirv.data(), spirv.size(), &result))
+      throw runtime_error("Shader pack failed - optimiser error");
+
+    spirv.assign(result.begin(), result.end());
+#endif
+
+    strip_spirv(spirv);
   }
 }
 
@@ -249,37 +425,44 @@ bool ShaderPlugin::build(Studio::Document *document, QString const &path)
   else
     throw runtime_error("Invalid Shader Stage");
 
-  glslang::TShader shader(stage);
+  vector<unsigned int> spirv;
 
-  const char *strings[] = { payload.c_str() };
-  int lengths[] = { (int)payload.size() };
-  const char *names[] = { name.c_str() };
+  auto cachepath = spirv_cache_path(payload, stage);
 
-  shader.setStringsWithLengthsAndNames(strings, lengths, names, 1);
+  if (!read_spirv_cache(cachepath, spirv))
+  {
+    glslang::TShader shader(stage);
 
-  EShMessages messages = (EShMessages)(EShMsgDefault | EShMsgSpvRules | EShMsgVulkanRules);
+    const char *strings[] = { payload.c_str() };
+    int lengths[] = { (int)payload.size() };
+    const char *names[] = { name.c_str() };
 
-  if (!shader.parse(&DefaultTBuiltInResource, 110, false, messages))
-  {
-    qCritical() << shader.getInfoLog();
+    shader.setStringsWithLengthsAndNames(strings, lengths, names, 1);
 
-    throw runtime_error("Shader build failed - compile error");
-  }
+    EShMessages messages = (EShMessages)(EShMsgDefault | EShMsgSpvRules | EShMsgVulkanRules);
 
-  glslang::TProgram program;
+    if (!shader.parse(&DefaultTBuiltInResource, 110, false, messages))
+    {
+      qCritical() << shader.getInfoLog();
 
-  program.addShader(&shader);
+      throw runtime_error("Shader build failed - compile error");
+    }
 
-  if (!program.link(messages) || !program.getIntermediate(stage))
-  {
-    qCritical() << program.getInfoLog();
+    glslang::TProgram program;
 
-    throw runtime_error("Shader build failed - link error");
-  }
+    program.addShader(&shader);
 
-  vector<unsigned int> spirv;
+    if (!program.link(messages) || !program.getIntermediate(stage))
+    {
+      qCritical() << program.getInfoLog();
+
+      throw runtime_error("Shader build failed - link error");
+    }
 
-  glslang::GlslangToSpv(*program.getIntermediate(stage), spirv);
+    glslang::GlslangToSpv(*program.getIntermediate(stage), spirv);
+
+    write_spirv_cache(cachepath, spirv);
+  }
 
   ofstream fout(path.toStdString(), ios::binary | ios::trunc);
 
@@ -305,15 +488,44 @@ bool ShaderPlugin::pack(Studio::PackerState &asset, ofstream &fout)
   if (!fin)
     throw runtime_error("Shader Pack failed - no build file");
 
-  PackTextHeader text;;
+  PackTextHeader text;
 
   if (read_asset_header(fin, 1, &text))
   {
-    vector<char> payload(pack_payload_size(text));
+    vector<unsigned int> spirv(pack_payload_size(text) / sizeof(unsigned int));
+
+    read_asset_payload(fin, text.dataoffset, spirv.data(), spirv.size()*sizeof(unsigned int));
+
+    auto mode = asset.parameters.value("shaders");
+
+    if (mode == "strip" || mode == "optimise")
+    {
+      // processed output lives beside the build file, reused until rebuilt
+
+      auto cachepath = QString::fromStdString(asset.buildpath) + "." + mode;
+
+      if (QFileInfo(cachepath).lastModified() < QFileInfo(QString::fromStdString(asset.buildpath)).lastModified() || !read_spirv_cache(cachepath, spirv))
+      {
+        Studio::TraceScope trace("optimise");
+
+        QElapsedTimer timer;
+
+        timer.start();
+
+        auto size = spirv.size()*sizeof(unsigned int);
 
-    read_asset_payload(fin, text.dataoffset, payload.data(), payload.size());
+        if (mode == "optimise")
+          optimise_spirv(spirv);
+        else
+          strip_spirv(spirv);
+
+        write_spirv_cache(cachepath, spirv);
+
+        qInfo().noquote() << QString("Shader %1 (%2) %3 -> %4 bytes in %5ms").arg(asset.name, mode).arg(size).arg(spirv.size()*sizeof(unsigned int)).arg(timer.elapsed());
+      }
+    }
 
-    write_text_asset(fout, asset.id, payload.size(), payload.data());
+    write_text_asset(fout, asset.id, spirv.size()*sizeof(unsigned int), spirv.data());
   }
 
   return true;
@@ -9,6 +9,8 @@
 #include "skybox.h"
 #include "image.h"
 #include "assetfile.h"
+#include "definition.h"
+#include "trace.h"
 #include "ibl.h"
 #include <QPainter>
 #include <QJsonDocument>
@@ -73,9 +75,17 @@ namespace
       }
     }
 
-    image_buildmips_cube_ibl(width, height, levels, payload.data());
+    {
+      Studio::TraceScope trace("mips");
 
-    write_imag_asset(fout, id, width, height, layers, levels, PackImageHeader::rgbe, payload.data());
+      image_buildmips_cube_ibl(width, height, levels, payload.data());
+    }
+
+    {
+      Studio::TraceScope trace("write");
+
+      write_imag_asset(fout, id, width, height, layers, levels, PackImageHeader::rgbe, payload.data());
+    }
 
     return id + 1;
   }
@@ -92,7 +102,11 @@ namespace
 
     image_pack_cube_ibl(image, width, height, levels, payload.data());
 
-    write_imag_asset(fout, id, width, height, layers, levels, PackImageHeader::rgbe, payload.data());
+    {
+      Studio::TraceScope trace("write");
+
+      write_imag_asset(fout, id, width, height, layers, levels, PackImageHeader::rgbe, payload.data());
+    }
 
     return id + 1;
   }
@@ -126,22 +140,7 @@ void SkyboxDocument::create(string const &path)
 ///////////////////////// hash //////////////////////////////////////////////
 void SkyboxDocument::hash(Studio::Document *document, size_t *key)
 {
-  QJsonObject definition;
-
-  document->lock();
-
-  PackTextHeader text;
-
-  if (read_asset_header(document, 1, &text))
-  {
-    QByteArray payload(pack_payload_size(text), 0);
-
-    read_asset_payload(document, text.dataoffset, payload.data(), payload.size());
-
-    definition = QJsonDocument::fromBinaryData(payload).object();
-  }
-
-  document->unlock();
+  auto definition = DefinitionCache::instance()->read(document);
 
   *key = std::hash<double>{}(document->metadata("build", 0.0));
 
@@ -231,6 +230,7 @@ SkyboxDocument::SkyboxDocument()
   auto documentmanager = Studio::Core::instance()->find_object<Studio::DocumentManager>();
 
   connect(documentmanager, &Studio::DocumentManager::document_changed, this, &SkyboxDocument::touch);
+  connect(documentmanager, &Studio::DocumentManager::documents_changed, this, [=](QVector<Studio::DocumentManager::Change> const &changes) { for(auto &change : changes) { if (change.document && change.dst == change.src) touch(change.document, change.dst); } });
 }
 
 
@@ -345,20 +345,7 @@ void SkyboxDocument::set_image(Image image, QString const &path)
 ///////////////////////// SkyboxDocument::refresh ///////////////////////////
 void SkyboxDocument::refresh()
 {
-  m_document->lock();
-
-  PackTextHeader text;
-
-  if (read_asset_header(m_document, 1, &text))
-  {
-    QByteArray payload(pack_payload_size(text), 0);
-
-    read_asset_payload(m_document, text.dataoffset, payload.data(), payload.size());
-
-    m_definition = QJsonDocument::fromBinaryData(payload).object();
-  }
-
-  m_document->unlock();
+  m_definition = DefinitionCache::instance()->read(m_document);
 
   auto documentmanager = Studio::Core::instance()->find_object<Studio::DocumentManager>();
 
@@ -378,20 +365,5 @@ void SkyboxDocument::refresh()
 ///////////////////////// SkyboxDocument::update ////////////////////////////
 void SkyboxDocument::update()
 {
-  QByteArray data = QJsonDocument(m_definition).toBinaryData();
-
-  m_document->lock_exclusive();
-
-  PackTextHeader text;
-
-  if (auto position = read_asset_header(m_document, 1, &text))
-  {
-    position += write_text_asset(m_document, position, 1, data.size(), data.data());
-
-    position += write_footer(m_document, position);
-
-    m_document->set_metadata("build", buildtime());
-  }
-
-  m_document->unlock_exclusive();
+  DefinitionCache::instance()->write(m_document, m_definition);
 }
@@ -104,6 +104,15 @@ bool SpritePlugin::build(Studio::Document *document, QString const &path)
 }
 
 
+///////////////////////// SpritePlugin::preview /////////////////////////////
+bool SpritePlugin::preview(Studio::Document *document, QString const &path)
+{
+  SpriteSheetDocument::build(document, path.toStdString(), Studio::BuildManager::PreviewSize);
+
+  return true;
+}
+
+
 ///////////////////////// SpritePlugin::pack /////////////////////////////////
 bool SpritePlugin::pack(Studio::PackerState &asset, ofstream &fout)
 {
@@ -9,6 +9,8 @@
 #include "spritesheet.h"
 #include "image.h"
 #include "assetfile.h"
+#include "definition.h"
+#include "trace.h"
 #include "atlaspacker.h"
 #include <functional>
 #include <cassert>
@@ -75,9 +77,17 @@ namespace
 
     image_premultiply_srgb(width, height, layers, levels, payload.data());
 
-    image_buildmips_srgb(width, height, layers, levels, payload.data());
+    {
+      Studio::TraceScope trace("mips");
+
+      image_buildmips_srgb(width, height, layers, levels, payload.data());
+    }
+
+    {
+      Studio::TraceScope trace("write");
 
-    write_imag_asset(fout, id, width, height, layers, levels, PackImageHeader::rgba, payload.data());
+      write_imag_asset(fout, id, width, height, layers, levels, PackImageHeader::rgba, payload.data());
+    }
 
     return id + 1;
   }
@@ -108,22 +118,7 @@ void SpriteSheetDocument::create(string const &path)
 ///////////////////////// hash //////////////////////////////////////////////
 void SpriteSheetDocument::hash(Studio::Document *document, size_t *key)
 {
-  QJsonObject definition;
-
-  document->lock();
-
-  PackTextHeader text;
-
-  if (read_asset_header(document, 1, &text))
-  {
-    QByteArray payload(pack_payload_size(text), 0);
-
-    read_asset_payload(document, text.dataoffset, payload.data(), payload.size());
-
-    definition = QJsonDocument::fromBinaryData(payload).object();
-  }
-
-  document->unlock();
+  auto definition = DefinitionCache::instance()->read(document);
 
   *key = std::hash<double>{}(document->metadata("build", 0.0));
 
@@ -139,22 +134,7 @@ void SpriteSheetDocument::hash(Studio::Document *document, size_t *key)
 ///////////////////////// hash //////////////////////////////////////////////
 void SpriteSheetDocument::build_hash(Studio::Document *document, size_t *key)
 {
-  QJsonObject definition;
-
-  document->lock();
-
-  PackTextHeader text;
-
-  if (read_asset_header(document, 1, &text))
-  {
-    QByteArray payload(pack_payload_size(text), 0);
-
-    read_asset_payload(document, text.dataoffset, payload.data(), payload.size());
-
-    definition = QJsonDocument::fromBinaryData(payload).object();
-  }
-
-  document->unlock();
+  auto definition = DefinitionCache::instance()->read(document);
 
   *key = 0;
 
@@ -168,7 +148,7 @@ void SpriteSheetDocument::build_hash(Studio::Document *document, size_t *key)
 
 
 ///////////////////////// build /////////////////////////////////////////////
-void SpriteSheetDocument::build(Studio::Document *document, string const &path)
+void SpriteSheetDocument::build(Studio::Document *document, string const &path, int maxsize)
 {
   auto spritesheetdocument = SpriteSheetDocument(document);
 
@@ -179,7 +159,7 @@ void SpriteSheetDocument::build(Studio::Document *document, string const &path)
 
   for(int i = 0; i < spritesheetdocument.layers(); ++i)
   {
-    images.push_back(ImageDocument(spritesheetdocument.layer(i)).data());
+    images.push_back(ImageDocument(spritesheetdocument.layer(i)).data(ImageDocument::srgb, maxsize));
   }
 
   ofstream fout(path, ios::binary | ios::trunc);
@@ -226,6 +206,7 @@ SpriteSheetDocument::SpriteSheetDocument()
   auto documentmanager = Studio::Core::instance()->find_object<Studio::DocumentManager>();
 
   connect(documentmanager, &Studio::DocumentManager::document_changed, this, &SpriteSheetDocument::touch);
+  connect(documentmanager, &Studio::DocumentManager::documents_changed, this, [=](QVector<Studio::DocumentManager::Change> const &changes) { for(auto &change : changes) { if (change.document && change.dst == change.src) touch(change.document, change.dst); } });
 }
 
 
@@ -346,20 +327,7 @@ void SpriteSheetDocument::touch(Studio::Document *document, QString const &path)
 ///////////////////////// SpriteSheetDocument::refresh //////////////////////
 void SpriteSheetDocument::refresh()
 {
-  m_document->lock();
-
-  PackTextHeader text;
-
-  if (read_asset_header(m_document, 1, &text))
-  {
-    QByteArray payload(pack_payload_size(text), 0);
-
-    read_asset_payload(m_document, text.dataoffset, payload.data(), payload.size());
-
-    m_definition = QJsonDocument::fromBinaryData(payload).object();
-  }
-
-  m_document->unlock();
+  m_definition = DefinitionCache::instance()->read(m_document);
 
   auto documentmanager = Studio::Core::instance()->find_object<Studio::DocumentManager>();
 
@@ -380,20 +348,5 @@ void SpriteSheetDocument::refresh()
 ///////////////////////// SpriteSheetDocument::update ///////////////////////
 void SpriteSheetDocument::update()
 {
-  QByteArray data = QJsonDocument(m_definition).toBinaryData();
-
-  m_document->lock_exclusive();
-
-  PackTextHeader text;
-
-  if (auto position = read_asset_header(m_document, 1, &text))
-  {
-    position += write_text_asset(m_document, position, 1, data.size(), data.data());
-
-    position += write_footer(m_document, position);
-
-    m_document->set_metadata("build", buildtime());
-  }
-
-  m_document->unlock_exclusive();
+  DefinitionCache::instance()->write(m_document, m_definition);
 }
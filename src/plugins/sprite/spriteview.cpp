@@ -71,7 +71,7 @@ void SpriteView::refresh()
 { 
   auto buildmanager = Studio::Core::instance()->find_object<Studio::BuildManager>();
 
-  buildmanager->request_build(m_document, this, &SpriteView::on_sprite_build_complete);
+  buildmanager->request_preview(m_document, this, &SpriteView::on_sprite_build_complete);
 }
 
 
@@ -88,6 +88,26 @@ void SpriteView::on_sprite_build_complete(Studio::Document *document, QString co
     m_height = imag.height;
     m_layers = imag.layers;
 
+    // preview builds are downsampled, keep the view at the source size
+
+    for(int i = 0; i < m_document.layers(); ++i)
+    {
+      if (auto layer = m_document.layer(i))
+      {
+        layer->lock();
+
+        PackImageHeader source;
+
+        if (read_asset_header(layer, 1, &source))
+        {
+          m_width = max(m_width, (int)source.width);
+          m_height = max(m_height, (int)source.height);
+        }
+
+        layer->unlock();
+      }
+    }
+
     m_image = viewport()->resources.create<Texture>(imag.width, imag.height, imag.layers, imag.levels, Texture::Format::SRGBA);
 
     if (auto lump = viewport()->resources.acquire_lump(imag.datasize))
@@ -7,6 +7,7 @@
 //
 
 #include "layerlistwidget.h"
+#include "definition.h"
 #include <QDragMoveEvent>
 #include <QMimeData>
 #include <QFileInfo>
@@ -160,6 +161,8 @@ void LayerListWidget::dropEvent(QDropEvent *event)
       break;
   }
 
+  DefinitionBatch batch(m_document);
+
   if (event->mimeData()->hasFormat("datumstudio/terrainlayermodelitem"))
   {
     QByteArray encoded = event->mimeData()->data("datumstudio/terrainlayermodelitem");
@@ -133,7 +133,7 @@ void MaterialView::refresh()
   {
     auto buildmanager = Studio::Core::instance()->find_object<Studio::BuildManager>();
 
-    buildmanager->request_build(m_document, this, &MaterialView::on_material_build_complete);
+    buildmanager->request_preview(m_document, this, &MaterialView::on_material_build_complete);
 
     m_buildhash = hash;
   }
@@ -155,9 +155,32 @@ void MaterialView::on_material_build_complete(Studio::Document *document, QStrin
     auto reflectivity = m_document.reflectivity();
     auto emissive = m_document.emissive();
 
-    m_albedomap = resources.load<Texture>(fin, 1, Texture::Format::SRGBA);
-    m_surfacemap = resources.load<Texture>(fin, 2, Texture::Format::RGBA);
-    m_normalmap = resources.load<Texture>(fin, 3, Texture::Format::RGBA);
+    // only arrays whose key changed are uploaded again, a layer tint leaves
+    // the normal array alone (keys are written by the builder)
+
+    auto keys = read_asset_json(fin, 4);
+
+    auto albedokey = keys["albedokey"].toString();
+    auto surfacekey = keys["surfacekey"].toString();
+    auto normalkey = keys["normalkey"].toString();
+
+    if (!m_albedomap || albedokey.isEmpty() || albedokey != m_albedokey)
+    {
+      m_albedomap = resources.load<Texture>(fin, 1, Texture::Format::SRGBA);
+      m_albedokey = albedokey;
+    }
+
+    if (!m_surfacemap || surfacekey.isEmpty() || surfacekey != m_surfacekey)
+    {
+      m_surfacemap = resources.load<Texture>(fin, 2, Texture::Format::RGBA);
+      m_surfacekey = surfacekey;
+    }
+
+    if (!m_normalmap || normalkey.isEmpty() || normalkey != m_normalkey)
+    {
+      m_normalmap = resources.load<Texture>(fin, 3, Texture::Format::RGBA);
+      m_normalkey = normalkey;
+    }
 
     resources.update(m_material, color, metalness, roughness, reflectivity, emissive, *m_albedomap, *m_surfacemap, *m_normalmap);
 
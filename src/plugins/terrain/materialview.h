@@ -90,5 +90,9 @@ class MaterialView : public Viewport
     unique_resource<Texture> m_normalmap;
     unique_resource<Material> m_material;
 
+    QString m_albedokey;
+    QString m_surfacekey;
+    QString m_normalkey;
+
     TerrainMaterialDocument m_document;
 };
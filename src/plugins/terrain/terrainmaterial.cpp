@@ -11,11 +11,16 @@
 #include "material.h"
 #include "buildapi.h"
 #include "assetfile.h"
+#include "definition.h"
+#include "hashcache.h"
+#include "trace.h"
 #include <QPainter>
 #include <QJsonDocument>
 #include <QJsonArray>
 #include <QThread>
 #include <functional>
+#include <mutex>
+#include <map>
 #include <cassert>
 
 #include <QDebug>
@@ -94,10 +99,17 @@ namespace
     return id + 1;
   }
 
-  uint32_t write_imagemap(ostream &fout, uint32_t id, vector<HDRImage> const &images)
+  uint32_t write_imagemap(ostream &fout, uint32_t id, vector<HDRImage> const &images, int maxsize)
   {
     int width = max_element(images.begin(), images.end(), [](auto &lhs, auto &rhs) { return lhs.width < rhs.width; })->width;
     int height = max_element(images.begin(), images.end(), [](auto &lhs, auto &rhs) { return lhs.height < rhs.height; })->height;
+
+    if (maxsize > 0)
+    {
+      width = min(width, maxsize);
+      height = min(height, maxsize);
+    }
+
     int layers = images.size();
     int levels = image_maxlevels(width, height);
 
@@ -121,12 +133,42 @@ namespace
       }
     }
 
-    image_buildmips_rgb(width, height, layers, levels, payload.data());
+    {
+      Studio::TraceScope trace("mips");
+
+      image_buildmips_rgb(width, height, layers, levels, payload.data());
+    }
 
-    write_imag_asset(fout, id, width, height, layers, levels, PackImageHeader::rgba, payload.data());
+    {
+      Studio::TraceScope trace("write");
+
+      write_imag_asset(fout, id, width, height, layers, levels, PackImageHeader::rgba, payload.data());
+    }
 
     return id + 1;
   }
+
+  bool copy_imagemap(ostream &fout, istream &fin, uint32_t id)
+  {
+    PackImageHeader imag;
+
+    if (!read_asset_header(fin, id, &imag))
+      return false;
+
+    vector<char> payload(pack_payload_size(imag));
+
+    read_asset_payload(fin, imag.dataoffset, payload.data(), payload.size());
+
+    write_imag_asset(fout, id, imag.width, imag.height, imag.layers, imag.levels, imag.format, payload.data());
+
+    return true;
+  }
+
+  // the last output per document and size, arrays whose key is unchanged
+  // are copied from it rather than sampled and mipped again
+
+  mutex g_lastbuildmutex;
+  map<pair<QString, int>, string> g_lastbuild;
 }
 
 
@@ -158,124 +200,221 @@ void TerrainMaterialDocument::create(string const &path, Color4 const &color)
 ///////////////////////// hash //////////////////////////////////////////////
 void TerrainMaterialDocument::hash(Studio::Document *document, size_t *key)
 {
-  QJsonObject definition;
+  *key = HashCache::instance()->hash(document, "hash", [&](QStringList &dependencies) {
 
-  document->lock();
+    auto definition = DefinitionCache::instance()->read(document);
 
-  PackTextHeader text;
+    size_t seed = std::hash<double>{}(document->metadata("build", 0.0));
 
-  if (read_asset_header(document, 1, &text))
-  {
-    QByteArray payload(pack_payload_size(text), 0);
-
-    read_asset_payload(document, text.dataoffset, payload.data(), payload.size());
-
-    definition = QJsonDocument::fromBinaryData(payload).object();
-  }
-
-  document->unlock();
+    for(auto i : definition["layers"].toArray())
+    {
+      auto layer = i.toObject();
 
-  *key = std::hash<double>{}(document->metadata("build", 0.0));
+      dependencies.push_back(fullpath(document, layer["path"].toString()));
 
-  for(auto i : definition["layers"].toArray())
-  {
-    auto layer = i.toObject();
+      hash_combine(seed, material_hash(dependencies.back()));
+    }
 
-    hash_combine(*key, material_hash(fullpath(document, layer["path"].toString())));
-  }
+    return seed;
+  });
 }
 
 
 ///////////////////////// hash //////////////////////////////////////////////
 void TerrainMaterialDocument::build_hash(Studio::Document *document, size_t *key)
 {
-  QJsonObject definition;
-
-  document->lock();
+  *key = HashCache::instance()->hash(document, "build_hash", [&](QStringList &dependencies) {
 
-  PackTextHeader text;
+    auto definition = DefinitionCache::instance()->read(document);
 
-  if (read_asset_header(document, 1, &text))
-  {
-    QByteArray payload(pack_payload_size(text), 0);
-
-    read_asset_payload(document, text.dataoffset, payload.data(), payload.size());
-
-    definition = QJsonDocument::fromBinaryData(payload).object();
-  }
+    size_t seed = 0;
 
-  document->unlock();
+    for(auto i : definition["layers"].toArray())
+    {
+      auto layer = i.toObject();
 
-  *key = 0;
+      dependencies.push_back(fullpath(document, layer["path"].toString()));
 
-  for(auto i : definition["layers"].toArray())
-  {
-    auto layer = i.toObject();
+      hash_combine(seed, material_hash(dependencies.back()));
+    }
 
-    hash_combine(*key, material_hash(fullpath(document, layer["path"].toString())));
-  }
+    return seed;
+  });
 }
 
 
 ///////////////////////// build /////////////////////////////////////////////
-void TerrainMaterialDocument::build(Studio::Document *document, string const &path)
+void TerrainMaterialDocument::build(Studio::Document *document, string const &path, int maxsize)
 {
   auto materialdocument = TerrainMaterialDocument(document);
 
   if (materialdocument.layers() == 0)
     throw runtime_error("Terrain Material build failed - no layers");
 
-  vector<HDRImage> albedomaps;
-  vector<HDRImage> surfacemaps;
-  vector<HDRImage> normalmaps;
+  struct Layer
+  {
+    QString buildpath;
+
+    bool albedomap = false;
+    bool surfacemap = false;
+    bool normalmap = false;
+
+    Color4 albedotint = Color4(1, 1, 1, 1);
+    Color4 surfacetint = Color4(1, 1, 1, 1);
+  };
+
+  vector<Layer> layers;
 
   auto buildmanager = Studio::Core::instance()->find_object<Studio::BuildManager>();
 
   for(int i = 0; i < materialdocument.layers(); ++i)
   {
-    HDRImage albedomap(4, 4, Color4(1, 1, 1, 1));
-    HDRImage surfacemap(4, 4, Color4(1, 1, 1, 1));
-    HDRImage normalmap(4, 4, Color4(0.5, 0.5, 1, 1));
+    Layer layer;
 
     if (auto layerdocument = MaterialDocument(materialdocument.layer(i)))
     {
-      QString buildpath;
+      // a reduced size build takes the layer previews where available
 
-      if (!buildmanager->build(layerdocument, &buildpath))
+      bool built = (maxsize > 0 && buildmanager->build_preview(layerdocument, &layer.buildpath)) || buildmanager->build(layerdocument, &layer.buildpath);
+
+      if (!built)
         throw runtime_error("Terrain Material build failed - material sub-build error");
 
-      if (layerdocument.image(MaterialDocument::Image::AlbedoMap))
-        albedomap = read_image(buildpath, 1);
+      layer.albedomap = layerdocument.image(MaterialDocument::Image::AlbedoMap);
+      layer.surfacemap = layerdocument.image(MaterialDocument::Image::MetalnessMap) || layerdocument.image(MaterialDocument::Image::RoughnessMap) || layerdocument.image(MaterialDocument::Image::ReflectivityMap);
+      layer.normalmap = layerdocument.image(MaterialDocument::Image::NormalMap);
+
+      layer.albedotint = layerdocument.color();
+      layer.surfacetint = Color4(layerdocument.metalness(), layerdocument.reflectivity(), 1, layerdocument.roughness());
+    }
+
+    layers.push_back(layer);
+  }
 
-      if (layerdocument.image(MaterialDocument::Image::MetalnessMap) || layerdocument.image(MaterialDocument::Image::RoughnessMap) || layerdocument.image(MaterialDocument::Image::ReflectivityMap))
-        surfacemap = read_image(buildpath, 2);
+  //
+  // Array Keys
+  //
 
-      if (layerdocument.image(MaterialDocument::Image::NormalMap))
-        normalmap = read_image(buildpath, 3);
+  // layer build paths are keyed by content, so together with the tints they
+  // identify each array without reading any image data
 
-      albedomap = tint_image(albedomap, layerdocument.color());
+  size_t albedokey = std::hash<int>{}(maxsize);
+  size_t surfacekey = std::hash<int>{}(maxsize);
+  size_t normalkey = std::hash<int>{}(maxsize);
 
-      surfacemap = tint_image(surfacemap, Color4(layerdocument.metalness(), layerdocument.reflectivity(), 1, layerdocument.roughness()));
-    }
+  for(auto &layer : layers)
+  {
+    auto pathkey = qHash(layer.buildpath);
+
+    hash_combine(albedokey, pathkey);
+    hash_combine(albedokey, layer.albedomap);
+
+    hash_combine(albedokey, std::hash<float>{}(layer.albedotint.r));
+    hash_combine(albedokey, std::hash<float>{}(layer.albedotint.g));
+    hash_combine(albedokey, std::hash<float>{}(layer.albedotint.b));
+    hash_combine(albedokey, std::hash<float>{}(layer.albedotint.a));
+
+    hash_combine(surfacekey, pathkey);
+    hash_combine(surfacekey, layer.surfacemap);
+
+    hash_combine(surfacekey, std::hash<float>{}(layer.surfacetint.r));
+    hash_combine(surfacekey, std::hash<float>{}(layer.surfacetint.g));
+    hash_combine(surfacekey, std::hash<float>{}(layer.surfacetint.b));
+    hash_combine(surfacekey, std::hash<float>{}(layer.surfacetint.a));
+
+    hash_combine(normalkey, pathkey);
+    hash_combine(normalkey, layer.normalmap);
+  }
 
-    albedomaps.push_back(albedomap);
-    surfacemaps.push_back(surfacemap);
-    normalmaps.push_back(normalmap);
+  QJsonObject keys;
+  keys["albedokey"] = QString::number(albedokey, 16);
+  keys["surfacekey"] = QString::number(surfacekey, 16);
+  keys["normalkey"] = QString::number(normalkey, 16);
+
+  auto lastkey = make_pair(Studio::Core::instance()->find_object<Studio::DocumentManager>()->path(document), maxsize);
+
+  string lastpath;
+
+  {
+    lock_guard<mutex> lock(g_lastbuildmutex);
+
+    lastpath = g_lastbuild[lastkey];
   }
 
+  ifstream fin(lastpath, ios::binary);
+
+  auto lastkeys = fin ? read_asset_json(fin, 4) : QJsonObject();
+
   ofstream fout(path, ios::binary | ios::trunc);
 
   write_header(fout);
 
   write_catalog(fout, 0);
 
-  write_imagemap(fout, 1, albedomaps);
-  write_imagemap(fout, 2, surfacemaps);
-  write_imagemap(fout, 3, normalmaps);
+  if (lastkeys.value("albedokey") != keys.value("albedokey") || !copy_imagemap(fout, fin, 1))
+  {
+    vector<HDRImage> albedomaps;
+
+    for(auto &layer : layers)
+    {
+      HDRImage albedomap(4, 4, Color4(1, 1, 1, 1));
+
+      if (layer.albedomap)
+        albedomap = read_image(layer.buildpath, 1);
+
+      albedomaps.push_back(tint_image(albedomap, layer.albedotint));
+    }
+
+    write_imagemap(fout, 1, albedomaps, maxsize);
+  }
+
+  if (lastkeys.value("surfacekey") != keys.value("surfacekey") || !copy_imagemap(fout, fin, 2))
+  {
+    vector<HDRImage> surfacemaps;
+
+    for(auto &layer : layers)
+    {
+      HDRImage surfacemap(4, 4, Color4(1, 1, 1, 1));
+
+      if (layer.surfacemap)
+        surfacemap = read_image(layer.buildpath, 2);
+
+      surfacemaps.push_back(tint_image(surfacemap, layer.surfacetint));
+    }
+
+    write_imagemap(fout, 2, surfacemaps, maxsize);
+  }
+
+  if (lastkeys.value("normalkey") != keys.value("normalkey") || !copy_imagemap(fout, fin, 3))
+  {
+    vector<HDRImage> normalmaps;
+
+    for(auto &layer : layers)
+    {
+      HDRImage normalmap(4, 4, Color4(0.5, 0.5, 1, 1));
+
+      if (layer.normalmap)
+        normalmap = read_image(layer.buildpath, 3);
+
+      normalmaps.push_back(normalmap);
+    }
+
+    write_imagemap(fout, 3, normalmaps, maxsize);
+  }
+
+  write_asset_json(fout, 4, keys);
 
   write_chunk(fout, "HEND", 0, nullptr);
 
   fout.close();
+
+  {
+    lock_guard<mutex> lock(g_lastbuildmutex);
+
+    // the build manager renames the output into place once this returns
+
+    g_lastbuild[lastkey] = (path.size() > 4 && path.compare(path.size() - 4, 4, ".tmp") == 0) ? path.substr(0, path.size() - 4) : path;
+  }
 }
 
 
@@ -314,7 +453,11 @@ void TerrainMaterialDocument::pack(Studio::PackerState &asset, ofstream &fout)
 
       read_asset_payload(fin, imag.dataoffset, payload.data(), payload.size());
 
-      image_compress_bc3(imag.width, imag.height, imag.layers, imag.levels, payload.data());
+      {
+        Studio::TraceScope trace("compress");
+
+        image_compress_bc3(imag.width, imag.height, imag.layers, imag.levels, payload.data());
+      }
 
       write_imag_asset(fout, asset.id, imag.width, imag.height, imag.layers, imag.levels, PackImageHeader::rgba_bc3, payload.data());
     }
@@ -330,7 +473,11 @@ void TerrainMaterialDocument::pack(Studio::PackerState &asset, ofstream &fout)
 
       read_asset_payload(fin, imag.dataoffset, payload.data(), payload.size());
 
-      image_compress_bc3(imag.width, imag.height, imag.layers, imag.levels, payload.data());
+      {
+        Studio::TraceScope trace("compress");
+
+        image_compress_bc3(imag.width, imag.height, imag.layers, imag.levels, payload.data());
+      }
 
       write_imag_asset(fout, asset.id, imag.width, imag.height, imag.layers, imag.levels, PackImageHeader::rgba_bc3, payload.data());
     }
@@ -361,6 +508,7 @@ TerrainMaterialDocument::TerrainMaterialDocument()
   auto documentmanager = Studio::Core::instance()->find_object<Studio::DocumentManager>();
 
   connect(documentmanager, &Studio::DocumentManager::document_changed, this, &TerrainMaterialDocument::touch);
+  connect(documentmanager, &Studio::DocumentManager::documents_changed, this, [=](QVector<Studio::DocumentManager::Change> const &changes) { for(auto &change : changes) { if (change.document && change.dst == change.src) touch(change.document, change.dst); } });
 }
 
 
@@ -529,20 +677,7 @@ void TerrainMaterialDocument::erase_layer(int index)
 ///////////////////////// TerrainMaterialDocument::refresh ////////////////////
 void TerrainMaterialDocument::refresh()
 {
-  m_document->lock();
-
-  PackTextHeader text;
-
-  if (read_asset_header(m_document, 1, &text))
-  {
-    QByteArray payload(pack_payload_size(text), 0);
-
-    read_asset_payload(m_document, text.dataoffset, payload.data(), payload.size());
-
-    m_definition = QJsonDocument::fromBinaryData(payload).object();
-  }
-
-  m_document->unlock();
+  m_definition = DefinitionCache::instance()->read(m_document);
 
   auto documentmanager = Studio::Core::instance()->find_object<Studio::DocumentManager>();
 
@@ -563,20 +698,5 @@ void TerrainMaterialDocument::refresh()
 ///////////////////////// TerrainMaterialDocument::update /////////////////////
 void TerrainMaterialDocument::update()
 {
-  QByteArray data = QJsonDocument(m_definition).toBinaryData();
-
-  m_document->lock_exclusive();
-
-  PackTextHeader text;
-
-  if (auto position = read_asset_header(m_document, 1, &text))
-  {
-    position += write_text_asset(m_document, position, 1, data.size(), data.data());
-
-    position += write_footer(m_document, position);
-
-    m_document->set_metadata("build", buildtime());
-  }
-
-  m_document->unlock_exclusive();
+  DefinitionCache::instance()->write(m_document, m_definition);
 }
@@ -108,6 +108,15 @@ bool TerrainPlugin::build(Studio::Document *document, QString const &path)
 }
 
 
+///////////////////////// TerrainPlugin::preview ////////////////////////////
+bool TerrainPlugin::preview(Studio::Document *document, QString const &path)
+{
+  TerrainMaterialDocument::build(document, path.toStdString(), Studio::BuildManager::PreviewSize);
+
+  return true;
+}
+
+
 ///////////////////////// TerrainPlugin::pack ///////////////////////////////
 bool TerrainPlugin::pack(Studio::PackerState &asset, ofstream &fout)
 {
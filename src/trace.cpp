@@ -0,0 +1,188 @@
+//
+// Datum Studio Trace
+//
+
+//
+// Copyright (C) 2016 Peter Niekamp
+//
+
+#include "trace.h"
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonObject>
+#include <QJsonDocument>
+
+#include <QtDebug>
+
+using namespace std;
+
+namespace
+{
+  atomic<int> g_threadcount(0);
+
+  thread_local int g_thread = ++g_threadcount;
+
+  thread_local QString g_asset;
+}
+
+
+//|---------------------- Trace ---------------------------------------------
+//|--------------------------------------------------------------------------
+//| Trace
+//|
+
+///////////////////////// Trace::instance ///////////////////////////////////
+Studio::Trace *Studio::Trace::instance()
+{
+  static Trace g_trace;
+
+  return &g_trace;
+}
+
+
+///////////////////////// Trace::Constructor ////////////////////////////////
+Studio::Trace::Trace()
+  : m_depth(0)
+{
+  m_clock.start();
+}
+
+
+///////////////////////// Trace::now ////////////////////////////////////////
+qint64 Studio::Trace::now() const
+{
+  return m_clock.nsecsElapsed() / 1000;
+}
+
+
+///////////////////////// Trace::begin_capture //////////////////////////////
+void Studio::Trace::begin_capture()
+{
+  lock_guard<mutex> lock(m_mutex);
+
+  if (m_depth++ == 0)
+  {
+    m_spans.clear();
+  }
+}
+
+
+///////////////////////// Trace::end_capture ////////////////////////////////
+void Studio::Trace::end_capture(QString const &path)
+{
+  {
+    lock_guard<mutex> lock(m_mutex);
+
+    if (--m_depth != 0)
+      return;
+  }
+
+  // without a path only the spans are kept, for the timing summary
+
+  if (path.isEmpty())
+  {
+    emit capture_complete();
+
+    return;
+  }
+
+  QJsonArray events;
+
+  for(auto &span : spans())
+  {
+    QJsonObject event;
+    event["name"] = span.name;
+    event["cat"] = "build";
+    event["ph"] = "X";
+    event["ts"] = span.start;
+    event["dur"] = span.duration;
+    event["pid"] = 1;
+    event["tid"] = span.thread;
+
+    if (span.asset != "")
+    {
+      QJsonObject args;
+      args["asset"] = span.asset;
+
+      event["args"] = args;
+    }
+
+    events.append(event);
+  }
+
+  QJsonObject trace;
+  trace["traceEvents"] = events;
+  trace["displayTimeUnit"] = "ms";
+
+  QFile fout(path);
+
+  if (fout.open(QIODevice::WriteOnly | QIODevice::Truncate))
+  {
+    fout.write(QJsonDocument(trace).toJson(QJsonDocument::Compact));
+  }
+  else
+  {
+    qWarning() << "Unable to write trace" << path;
+  }
+
+  emit capture_complete();
+}
+
+
+///////////////////////// Trace::spans //////////////////////////////////////
+vector<Studio::Trace::Span> Studio::Trace::spans() const
+{
+  lock_guard<mutex> lock(m_mutex);
+
+  return m_spans;
+}
+
+
+///////////////////////// Trace::record /////////////////////////////////////
+void Studio::Trace::record(const char *name, QString const &asset, qint64 start, qint64 duration)
+{
+  lock_guard<mutex> lock(m_mutex);
+
+  if (m_depth != 0)
+  {
+    m_spans.push_back({ name, asset, g_thread, start, duration });
+  }
+}
+
+
+//|---------------------- TraceScope ----------------------------------------
+//|--------------------------------------------------------------------------
+//| TraceScope
+//|
+
+///////////////////////// TraceScope::Constructor ///////////////////////////
+Studio::TraceScope::TraceScope(const char *name)
+  : TraceScope(name, g_asset)
+{
+}
+
+
+///////////////////////// TraceScope::Constructor ///////////////////////////
+Studio::TraceScope::TraceScope(const char *name, QString const &asset)
+  : m_name(name),
+    m_asset(asset),
+    m_parent(g_asset)
+{
+  g_asset = m_asset;
+
+  m_start = Trace::instance()->capturing() ? Trace::instance()->now() : -1;
+}
+
+
+///////////////////////// TraceScope::Destructor ////////////////////////////
+Studio::TraceScope::~TraceScope()
+{
+  if (m_start >= 0)
+  {
+    auto trace = Trace::instance();
+
+    trace->record(m_name, m_asset, m_start, trace->now() - m_start);
+  }
+
+  g_asset = m_parent;
+}
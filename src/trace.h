@@ -0,0 +1,121 @@
+//
+// Datum Studio Trace
+//
+
+//
+// Copyright (C) 2016 Peter Niekamp
+//
+
+#pragma once
+
+#include "api.h"
+#include <QElapsedTimer>
+#include <vector>
+#include <mutex>
+#include <atomic>
+
+namespace Studio
+{
+  //-------------------------- Trace ------------------------------------------
+  //---------------------------------------------------------------------------
+
+  class STUDIO_EXPORT Trace : public QObject
+  {
+    Q_OBJECT
+
+    public:
+
+      struct Span
+      {
+        QString name;
+        QString asset;
+        int thread;
+        qint64 start;
+        qint64 duration;
+      };
+
+      static Trace *instance();
+
+    public:
+
+      bool capturing() const { return m_depth != 0; }
+
+      void begin_capture();
+      void end_capture(QString const &path);
+
+      std::vector<Span> spans() const;
+
+    public:
+
+      qint64 now() const;
+
+      void record(const char *name, QString const &asset, qint64 start, qint64 duration);
+
+    signals:
+
+      void capture_complete();
+
+    private:
+      Trace();
+
+      QElapsedTimer m_clock;
+
+      std::atomic<int> m_depth;
+
+      std::vector<Span> m_spans;
+
+      mutable std::mutex m_mutex;
+  };
+
+
+  //-------------------------- TraceScope -------------------------------------
+  //---------------------------------------------------------------------------
+
+  // scoped span, nested scopes inherit the asset of their enclosing scope
+
+  class STUDIO_EXPORT TraceScope
+  {
+    public:
+      TraceScope(const char *name);
+      TraceScope(const char *name, QString const &asset);
+      ~TraceScope();
+
+      TraceScope(TraceScope const &) = delete;
+      TraceScope &operator=(TraceScope const &) = delete;
+
+    private:
+
+      const char *m_name;
+
+      QString m_asset;
+      QString m_parent;
+
+      qint64 m_start;
+  };
+
+
+  //-------------------------- TraceCapture -----------------------------------
+  //---------------------------------------------------------------------------
+
+  class TraceCapture
+  {
+    public:
+      TraceCapture(QString const &path)
+        : m_path(path)
+      {
+        Trace::instance()->begin_capture();
+      }
+
+      ~TraceCapture()
+      {
+        Trace::instance()->end_capture(m_path);
+      }
+
+      TraceCapture(TraceCapture const &) = delete;
+      TraceCapture &operator=(TraceCapture const &) = delete;
+
+    private:
+
+      QString m_path;
+  };
+}
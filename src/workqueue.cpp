@@ -0,0 +1,433 @@
+//
+// Datum Studio Work Queue
+//
+
+//
+// Copyright (C) 2016 Peter Niekamp
+//
+
+#include "workqueue.h"
+#include <algorithm>
+
+#include <QtDebug>
+
+using namespace std;
+
+namespace
+{
+  thread_local Studio::WorkQueue *g_queue = nullptr;
+
+  thread_local size_t g_index = 0;
+
+  //|---------------------- TaskCache ---------------------------------------
+  //|------------------------------------------------------------------------
+
+  // retired tasks are kept per thread for reuse. work pushed by a worker
+  // mostly retires on a worker, so their caches stay warm
+
+  struct TaskCache
+  {
+    static constexpr size_t Capacity = 256;
+
+    ~TaskCache()
+    {
+      while (head)
+      {
+        auto task = head;
+
+        head = head->next;
+
+        delete task;
+      }
+    }
+
+    Studio::Task *head = nullptr;
+
+    size_t count = 0;
+  };
+
+  thread_local TaskCache g_taskcache;
+
+  //|---------------------- SharedCache -------------------------------------
+  //|------------------------------------------------------------------------
+
+  // work pushed from outside the pool always retires on a worker, so those
+  // tasks go back through a shared lock free list instead. an outside
+  // thread whose own cache runs dry takes the whole list with one exchange,
+  // which keeps the pop clear of the ABA problem of a single node pop
+
+  struct SharedCache
+  {
+    static constexpr size_t Capacity = 256;
+
+    ~SharedCache()
+    {
+      auto task = head.exchange(nullptr);
+
+      while (task)
+      {
+        auto next = task->next;
+
+        delete task;
+
+        task = next;
+      }
+    }
+
+    atomic<Studio::Task*> head{nullptr};
+
+    atomic<size_t> count{0};
+  };
+
+  SharedCache g_sharedcache;
+}
+
+
+//|---------------------- Deque ---------------------------------------------
+//|--------------------------------------------------------------------------
+//| Chase-Lev deque, push and pop from the owning worker only, steal from any
+//|
+
+///////////////////////// Deque::Constructor ////////////////////////////////
+Studio::WorkQueue::Deque::Deque()
+  : m_top(0),
+    m_bottom(0)
+{
+  m_rings.push_back(make_unique<Ring>(64));
+
+  m_ring = m_rings.back().get();
+}
+
+
+///////////////////////// Deque::Destructor /////////////////////////////////
+Studio::WorkQueue::Deque::~Deque()
+{
+  while (auto task = pop())
+    delete task;
+}
+
+
+///////////////////////// Deque::push ///////////////////////////////////////
+void Studio::WorkQueue::Deque::push(Task *task)
+{
+  auto bottom = m_bottom.load(memory_order_relaxed);
+  auto top = m_top.load(memory_order_acquire);
+  auto ring = m_ring.load(memory_order_relaxed);
+
+  if (bottom - top > ring->capacity - 1)
+  {
+    // grow, the old ring stays alive for any thief still reading it
+
+    m_rings.push_back(make_unique<Ring>(2 * ring->capacity));
+
+    for(auto i = top; i < bottom; ++i)
+      m_rings.back()->put(i, ring->get(i));
+
+    ring = m_rings.back().get();
+
+    m_ring.store(ring, memory_order_release);
+  }
+
+  ring->put(bottom, task);
+
+  atomic_thread_fence(memory_order_release);
+
+  m_bottom.store(bottom + 1, memory_order_relaxed);
+}
+
+
+///////////////////////// Deque::pop ////////////////////////////////////////
+Studio::Task *Studio::WorkQueue::Deque::pop()
+{
+  auto bottom = m_bottom.load(memory_order_relaxed) - 1;
+  auto ring = m_ring.load(memory_order_relaxed);
+
+  m_bottom.store(bottom, memory_order_relaxed);
+
+  atomic_thread_fence(memory_order_seq_cst);
+
+  auto top = m_top.load(memory_order_relaxed);
+
+  if (top > bottom)
+  {
+    m_bottom.store(bottom + 1, memory_order_relaxed);
+
+    return nullptr;
+  }
+
+  auto task = ring->get(bottom);
+
+  if (top == bottom)
+  {
+    // last entry, race any thief for it
+
+    if (!m_top.compare_exchange_strong(top, top + 1, memory_order_seq_cst, memory_order_relaxed))
+      task = nullptr;
+
+    m_bottom.store(bottom + 1, memory_order_relaxed);
+  }
+
+  return task;
+}
+
+
+///////////////////////// Deque::steal //////////////////////////////////////
+Studio::Task *Studio::WorkQueue::Deque::steal()
+{
+  auto top = m_top.load(memory_order_acquire);
+
+  atomic_thread_fence(memory_order_seq_cst);
+
+  auto bottom = m_bottom.load(memory_order_acquire);
+
+  if (top >= bottom)
+    return nullptr;
+
+  auto task = m_ring.load(memory_order_acquire)->get(top);
+
+  if (!m_top.compare_exchange_strong(top, top + 1, memory_order_seq_cst, memory_order_relaxed))
+    return nullptr;
+
+  return task;
+}
+
+
+//|---------------------- WorkQueue -----------------------------------------
+//|--------------------------------------------------------------------------
+//| WorkQueue
+//|
+
+///////////////////////// WorkQueue::instance ///////////////////////////////
+Studio::WorkQueue *Studio::WorkQueue::instance()
+{
+  static WorkQueue g_workqueue;
+
+  return &g_workqueue;
+}
+
+
+///////////////////////// WorkQueue::Constructor ////////////////////////////
+Studio::WorkQueue::WorkQueue(int threads)
+{
+  m_done = false;
+  m_sleeping = 0;
+
+  for(auto &pending : m_pending)
+    pending = 0;
+
+  for(int i = 0; i < max(threads, 2); ++i)
+    m_workers.push_back(make_unique<Worker>());
+
+  for(size_t i = 0; i < m_workers.size(); ++i)
+    m_workers[i]->thread = thread([=]() { run(i); });
+}
+
+
+///////////////////////// WorkQueue::Destructor /////////////////////////////
+Studio::WorkQueue::~WorkQueue()
+{
+  {
+    lock_guard<mutex> lock(m_mutex);
+
+    m_done = true;
+
+    m_signal.notify_all();
+  }
+
+  for(auto &worker : m_workers)
+    worker->thread.join();
+
+  for(auto &queue : m_shared)
+  {
+    for(auto &task : queue)
+      delete task;
+  }
+}
+
+
+///////////////////////// WorkQueue::acquire ////////////////////////////////
+Studio::Task *Studio::WorkQueue::acquire()
+{
+  if (!g_taskcache.head && !g_queue)
+  {
+    auto task = g_sharedcache.head.exchange(nullptr, memory_order_acquire);
+
+    while (task)
+    {
+      auto next = task->next;
+
+      task->next = g_taskcache.head;
+
+      g_taskcache.head = task;
+      g_taskcache.count += 1;
+
+      g_sharedcache.count -= 1;
+
+      task = next;
+    }
+  }
+
+  auto task = g_taskcache.head;
+
+  if (task)
+  {
+    g_taskcache.head = task->next;
+    g_taskcache.count -= 1;
+  }
+  else
+  {
+    task = new Task;
+  }
+
+  task->shared = !g_queue;
+
+  return task;
+}
+
+
+///////////////////////// WorkQueue::release ////////////////////////////////
+void Studio::WorkQueue::release(Task *task)
+{
+  task->reset();
+
+  if (task->shared)
+  {
+    if (g_sharedcache.count >= SharedCache::Capacity)
+    {
+      delete task;
+
+      return;
+    }
+
+    g_sharedcache.count += 1;
+
+    task->next = g_sharedcache.head.load(memory_order_relaxed);
+
+    while (!g_sharedcache.head.compare_exchange_weak(task->next, task, memory_order_release, memory_order_relaxed))
+      ;
+
+    return;
+  }
+
+  if (g_taskcache.count == TaskCache::Capacity)
+  {
+    delete task;
+
+    return;
+  }
+
+  task->next = g_taskcache.head;
+
+  g_taskcache.head = task;
+  g_taskcache.count += 1;
+}
+
+
+///////////////////////// WorkQueue::push ///////////////////////////////////
+void Studio::WorkQueue::push(Task *task, Priority priority)
+{
+  auto p = static_cast<int>(priority);
+
+  m_pending[p] += 1;
+
+  if (g_queue == this)
+  {
+    m_workers[g_index]->deques[p].push(task);
+  }
+  else
+  {
+    lock_guard<mutex> lock(m_mutex);
+
+    m_shared[p].push_back(task);
+  }
+
+  if (m_sleeping != 0)
+  {
+    lock_guard<mutex> lock(m_mutex);
+
+    // the first worker ignores background work, so wake everyone for it
+
+    if (priority == Priority::Interactive)
+      m_signal.notify_one();
+    else
+      m_signal.notify_all();
+  }
+}
+
+
+///////////////////////// WorkQueue::take ///////////////////////////////////
+Studio::Task *Studio::WorkQueue::take(size_t index)
+{
+  for(int p = 0; p < Priorities; ++p)
+  {
+    if (p == static_cast<int>(Priority::Background) && index == 0)
+      break;
+
+    auto task = m_workers[index]->deques[p].pop();
+
+    if (!task)
+    {
+      lock_guard<mutex> lock(m_mutex);
+
+      if (!m_shared[p].empty())
+      {
+        task = m_shared[p].front();
+
+        m_shared[p].pop_front();
+      }
+    }
+
+    for(size_t i = 1; i < m_workers.size() && !task; ++i)
+    {
+      task = m_workers[(index + i) % m_workers.size()]->deques[p].steal();
+    }
+
+    if (task)
+    {
+      m_pending[p] -= 1;
+
+      return task;
+    }
+  }
+
+  return nullptr;
+}
+
+
+///////////////////////// WorkQueue::run ////////////////////////////////////
+void Studio::WorkQueue::run(size_t index)
+{
+  g_queue = this;
+  g_index = index;
+
+  auto ready = [&]() {
+
+    if (index == 0)
+      return m_pending[0] > 0;
+
+    return m_pending[0] > 0 || m_pending[1] > 0;
+  };
+
+  while (true)
+  {
+    if (auto task = take(index))
+    {
+      (*task)();
+
+      release(task);
+
+      continue;
+    }
+
+    unique_lock<mutex> lock(m_mutex);
+
+    m_sleeping += 1;
+
+    m_signal.wait(lock, [&]() { return ready() || m_done; });
+
+    m_sleeping -= 1;
+
+    if (m_done && !ready())
+      break;
+  }
+}
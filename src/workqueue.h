@@ -0,0 +1,211 @@
+//
+// Datum Studio Work Queue
+//
+
+//
+// Copyright (C) 2016 Peter Niekamp
+//
+
+#pragma once
+
+#include "api.h"
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+#include <type_traits>
+#include <memory>
+#include <new>
+#include <cstddef>
+
+namespace Studio
+{
+  //-------------------------- Task -------------------------------------------
+  //---------------------------------------------------------------------------
+
+  // type erased callable, captures up to StorageSize bytes are held inline
+
+  class Task
+  {
+    public:
+
+      static constexpr size_t StorageSize = 48;
+
+      Task() = default;
+
+      Task(Task const &) = delete;
+      Task &operator=(Task const &) = delete;
+
+      ~Task()
+      {
+        reset();
+      }
+
+      template<typename Func>
+      void assign(Func &&func)
+      {
+        using F = typename std::decay<Func>::type;
+
+        reset();
+
+        assign<F>(std::forward<Func>(func), std::integral_constant<bool, sizeof(F) <= StorageSize && alignof(F) <= alignof(std::max_align_t)>());
+      }
+
+      void operator()()
+      {
+        m_invoke(&m_storage);
+      }
+
+      void reset()
+      {
+        if (m_destroy)
+          m_destroy(&m_storage);
+
+        m_invoke = nullptr;
+        m_destroy = nullptr;
+      }
+
+      Task *next = nullptr;
+
+      bool shared = false;
+
+    private:
+
+      template<typename F, typename Func>
+      void assign(Func &&func, std::true_type)
+      {
+        new(&m_storage) F(std::forward<Func>(func));
+
+        m_invoke = [](void *storage) { (*static_cast<F*>(storage))(); };
+        m_destroy = [](void *storage) { static_cast<F*>(storage)->~F(); };
+      }
+
+      template<typename F, typename Func>
+      void assign(Func &&func, std::false_type)
+      {
+        *reinterpret_cast<F**>(&m_storage) = new F(std::forward<Func>(func));
+
+        m_invoke = [](void *storage) { (**static_cast<F**>(storage))(); };
+        m_destroy = [](void *storage) { delete *static_cast<F**>(storage); };
+      }
+
+      void (*m_invoke)(void *storage) = nullptr;
+      void (*m_destroy)(void *storage) = nullptr;
+
+      typename std::aligned_storage<StorageSize, alignof(std::max_align_t)>::type m_storage;
+  };
+
+
+  //-------------------------- WorkQueue --------------------------------------
+  //---------------------------------------------------------------------------
+
+  // work stealing thread pool. each worker owns a lock free deque per
+  // priority (pushed and popped lifo by the owner, stolen fifo by the rest),
+  // work from outside the pool enters through a shared queue. interactive
+  // work is always taken ahead of background work, and the first worker
+  // only runs interactive work so long builds cannot starve viewer loads
+
+  class STUDIO_EXPORT WorkQueue
+  {
+    public:
+
+      enum class Priority
+      {
+        Interactive,
+        Background,
+      };
+
+      static WorkQueue *instance();
+
+    public:
+      WorkQueue(int threads = std::thread::hardware_concurrency());
+      ~WorkQueue();
+
+      WorkQueue(WorkQueue const &) = delete;
+      WorkQueue &operator=(WorkQueue const &) = delete;
+
+      int threads() const { return m_workers.size(); }
+
+      template<typename Func>
+      void push(Func &&func, Priority priority = Priority::Interactive)
+      {
+        auto task = acquire();
+
+        task->assign(std::forward<Func>(func));
+
+        push(task, priority);
+      }
+
+    private:
+
+      static constexpr int Priorities = 2;
+
+      class Deque
+      {
+        public:
+          Deque();
+          ~Deque();
+
+          void push(Task *task);
+
+          Task *pop();
+          Task *steal();
+
+        private:
+
+          struct Ring
+          {
+            Ring(int64_t capacity)
+              : capacity(capacity), slots(new std::atomic<Task*>[capacity])
+            {
+            }
+
+            int64_t capacity;
+            std::unique_ptr<std::atomic<Task*>[]> slots;
+
+            Task *get(int64_t i) const { return slots[i & (capacity - 1)].load(std::memory_order_relaxed); }
+            void put(int64_t i, Task *task) { slots[i & (capacity - 1)].store(task, std::memory_order_relaxed); }
+          };
+
+          std::atomic<int64_t> m_top;
+          std::atomic<int64_t> m_bottom;
+
+          std::atomic<Ring*> m_ring;
+
+          std::vector<std::unique_ptr<Ring>> m_rings;
+      };
+
+      struct Worker
+      {
+        Deque deques[Priorities];
+
+        std::thread thread;
+      };
+
+      static Task *acquire();
+      static void release(Task *task);
+
+      void push(Task *task, Priority priority);
+
+      Task *take(size_t index);
+
+      void run(size_t index);
+
+    private:
+
+      std::atomic<bool> m_done;
+
+      std::atomic<int> m_pending[Priorities];
+      std::atomic<int> m_sleeping;
+
+      std::mutex m_mutex;
+
+      std::condition_variable m_signal;
+
+      std::deque<Task*> m_shared[Priorities];
+
+      std::vector<std::unique_ptr<Worker>> m_workers;
+  };
+}